@@ -0,0 +1,283 @@
+#include "attitude.h"
+#include "fastmath.h"
+#include <math.h>
+
+#define RAD_TO_DEG 57.29577951f
+
+// Tiny bias keeps normalization branch-free when a vector is all zeros
+#define NORM_EPSILON 1e-12f
+
+static inline float inv_norm3(float x, float y, float z) {
+    return 1.0f / imu_sqrtf(x * x + y * y + z * z + NORM_EPSILON);
+}
+
+static inline float inv_norm4(float w, float x, float y, float z) {
+    return 1.0f / imu_sqrtf(w * w + x * x + y * y + z * z + NORM_EPSILON);
+}
+
+// ---------------------------
+// Set the quaternion directly from accel tilt and tilt-compensated mag heading
+// ---------------------------
+static void set_from_vectors(attitude_t *att,
+                             float ax, float ay, float az,
+                             float mx, float my, float mz) {
+    float roll = imu_atan2f(ay, az);
+    float pitch = imu_atan2f(-ax, imu_sqrtf(ay * ay + az * az));
+
+    float sr = sinf(roll), cr = cosf(roll);
+    float sp = sinf(pitch), cp = cosf(pitch);
+
+    // Project the magnetic field onto the horizontal plane
+    float mx_h = mx * cp + my * sr * sp + mz * cr * sp;
+    float my_h = my * cr - mz * sr;
+    float yaw = imu_atan2f(-my_h, mx_h);
+
+    float cr2 = cosf(roll * 0.5f), sr2 = sinf(roll * 0.5f);
+    float cp2 = cosf(pitch * 0.5f), sp2 = sinf(pitch * 0.5f);
+    float cy2 = cosf(yaw * 0.5f), sy2 = sinf(yaw * 0.5f);
+
+    att->q0 = cr2 * cp2 * cy2 + sr2 * sp2 * sy2;
+    att->q1 = sr2 * cp2 * cy2 - cr2 * sp2 * sy2;
+    att->q2 = cr2 * sp2 * cy2 + sr2 * cp2 * sy2;
+    att->q3 = cr2 * cp2 * sy2 - sr2 * sp2 * cy2;
+    att->initialized = 1;
+}
+
+// ---------------------------
+// Madgwick MARG update (gradient descent on gravity + magnetic field error)
+// ---------------------------
+static void madgwick_update(attitude_t *att,
+                            float gx, float gy, float gz,
+                            float ax, float ay, float az,
+                            float mx, float my, float mz,
+                            float dt) {
+    float q0 = att->q0, q1 = att->q1, q2 = att->q2, q3 = att->q3;
+    float recip_norm;
+
+    // Rate of change of quaternion from gyroscope
+    float qdot0 = 0.5f * (-q1 * gx - q2 * gy - q3 * gz);
+    float qdot1 = 0.5f * (q0 * gx + q2 * gz - q3 * gy);
+    float qdot2 = 0.5f * (q0 * gy - q1 * gz + q3 * gx);
+    float qdot3 = 0.5f * (q0 * gz + q1 * gy - q2 * gx);
+
+    recip_norm = inv_norm3(ax, ay, az);
+    ax *= recip_norm;
+    ay *= recip_norm;
+    az *= recip_norm;
+
+    recip_norm = inv_norm3(mx, my, mz);
+    mx *= recip_norm;
+    my *= recip_norm;
+    mz *= recip_norm;
+
+    // Auxiliary variables to avoid repeated arithmetic
+    float _2q0mx = 2.0f * q0 * mx;
+    float _2q0my = 2.0f * q0 * my;
+    float _2q0mz = 2.0f * q0 * mz;
+    float _2q1mx = 2.0f * q1 * mx;
+    float _2q0 = 2.0f * q0;
+    float _2q1 = 2.0f * q1;
+    float _2q2 = 2.0f * q2;
+    float _2q3 = 2.0f * q3;
+    float _2q0q2 = 2.0f * q0 * q2;
+    float _2q2q3 = 2.0f * q2 * q3;
+    float q0q0 = q0 * q0;
+    float q0q1 = q0 * q1;
+    float q0q2 = q0 * q2;
+    float q0q3 = q0 * q3;
+    float q1q1 = q1 * q1;
+    float q1q2 = q1 * q2;
+    float q1q3 = q1 * q3;
+    float q2q2 = q2 * q2;
+    float q2q3 = q2 * q3;
+    float q3q3 = q3 * q3;
+
+    // Reference direction of Earth's magnetic field
+    float hx = mx * q0q0 - _2q0my * q3 + _2q0mz * q2 + mx * q1q1 + _2q1 * my * q2
+             + _2q1 * mz * q3 - mx * q2q2 - mx * q3q3;
+    float hy = _2q0mx * q3 + my * q0q0 - _2q0mz * q1 + _2q1mx * q2 - my * q1q1
+             + my * q2q2 + _2q2 * mz * q3 - my * q3q3;
+    float _2bx = imu_sqrtf(hx * hx + hy * hy);
+    float _2bz = -_2q0mx * q2 + _2q0my * q1 + mz * q0q0 + _2q1mx * q3 - mz * q1q1
+               + _2q2 * my * q3 - mz * q2q2 + mz * q3q3;
+    float _4bx = 2.0f * _2bx;
+    float _4bz = 2.0f * _2bz;
+
+    // Objective function residuals shared by all gradient terms
+    float fgx = 2.0f * q1q3 - _2q0q2 - ax;
+    float fgy = 2.0f * q0q1 + _2q2q3 - ay;
+    float fgz = 1.0f - 2.0f * q1q1 - 2.0f * q2q2 - az;
+    float fbx = _2bx * (0.5f - q2q2 - q3q3) + _2bz * (q1q3 - q0q2) - mx;
+    float fby = _2bx * (q1q2 - q0q3) + _2bz * (q0q1 + q2q3) - my;
+    float fbz = _2bx * (q0q2 + q1q3) + _2bz * (0.5f - q1q1 - q2q2) - mz;
+
+    // Gradient descent corrective step
+    float s0 = -_2q2 * fgx + _2q1 * fgy - _2bz * q2 * fbx
+             + (-_2bx * q3 + _2bz * q1) * fby + _2bx * q2 * fbz;
+    float s1 = _2q3 * fgx + _2q0 * fgy - 4.0f * q1 * fgz + _2bz * q3 * fbx
+             + (_2bx * q2 + _2bz * q0) * fby + (_2bx * q3 - _4bz * q1) * fbz;
+    float s2 = -_2q0 * fgx + _2q3 * fgy - 4.0f * q2 * fgz + (-_4bx * q2 - _2bz * q0) * fbx
+             + (_2bx * q1 + _2bz * q3) * fby + (_2bx * q0 - _4bz * q2) * fbz;
+    float s3 = _2q1 * fgx + _2q2 * fgy + (-_4bx * q3 + _2bz * q1) * fbx
+             + (-_2bx * q0 + _2bz * q2) * fby + _2bx * q1 * fbz;
+
+    recip_norm = inv_norm4(s0, s1, s2, s3);
+    qdot0 -= att->beta * s0 * recip_norm;
+    qdot1 -= att->beta * s1 * recip_norm;
+    qdot2 -= att->beta * s2 * recip_norm;
+    qdot3 -= att->beta * s3 * recip_norm;
+
+    // Integrate and normalize
+    q0 += qdot0 * dt;
+    q1 += qdot1 * dt;
+    q2 += qdot2 * dt;
+    q3 += qdot3 * dt;
+
+    recip_norm = inv_norm4(q0, q1, q2, q3);
+    att->q0 = q0 * recip_norm;
+    att->q1 = q1 * recip_norm;
+    att->q2 = q2 * recip_norm;
+    att->q3 = q3 * recip_norm;
+}
+
+// ---------------------------
+// Explicit complementary filter update (proportional feedback on the
+// cross product between measured and estimated gravity / magnetic field)
+// ---------------------------
+static void complementary_update(attitude_t *att,
+                                 float gx, float gy, float gz,
+                                 float ax, float ay, float az,
+                                 float mx, float my, float mz,
+                                 float dt) {
+    float q0 = att->q0, q1 = att->q1, q2 = att->q2, q3 = att->q3;
+    float recip_norm;
+
+    recip_norm = inv_norm3(ax, ay, az);
+    ax *= recip_norm;
+    ay *= recip_norm;
+    az *= recip_norm;
+
+    recip_norm = inv_norm3(mx, my, mz);
+    mx *= recip_norm;
+    my *= recip_norm;
+    mz *= recip_norm;
+
+    float q0q0 = q0 * q0;
+    float q0q1 = q0 * q1;
+    float q0q2 = q0 * q2;
+    float q0q3 = q0 * q3;
+    float q1q1 = q1 * q1;
+    float q1q2 = q1 * q2;
+    float q1q3 = q1 * q3;
+    float q2q2 = q2 * q2;
+    float q2q3 = q2 * q3;
+    float q3q3 = q3 * q3;
+
+    // Reference direction of Earth's magnetic field
+    float hx = 2.0f * (mx * (0.5f - q2q2 - q3q3) + my * (q1q2 - q0q3) + mz * (q1q3 + q0q2));
+    float hy = 2.0f * (mx * (q1q2 + q0q3) + my * (0.5f - q1q1 - q3q3) + mz * (q2q3 - q0q1));
+    float bx = imu_sqrtf(hx * hx + hy * hy);
+    float bz = 2.0f * (mx * (q1q3 - q0q2) + my * (q2q3 + q0q1) + mz * (0.5f - q1q1 - q2q2));
+
+    // Estimated direction of gravity and magnetic field (halved)
+    float vx = q1q3 - q0q2;
+    float vy = q0q1 + q2q3;
+    float vz = q0q0 - 0.5f + q3q3;
+    float wx = bx * (0.5f - q2q2 - q3q3) + bz * (q1q3 - q0q2);
+    float wy = bx * (q1q2 - q0q3) + bz * (q0q1 + q2q3);
+    float wz = bx * (q0q2 + q1q3) + bz * (0.5f - q1q1 - q2q2);
+
+    // Error is the cross product between estimated and measured directions
+    float ex = (ay * vz - az * vy) + (my * wz - mz * wy);
+    float ey = (az * vx - ax * vz) + (mz * wx - mx * wz);
+    float ez = (ax * vy - ay * vx) + (mx * wy - my * wx);
+
+    gx += att->kp * ex;
+    gy += att->kp * ey;
+    gz += att->kp * ez;
+
+    // Integrate rate of change of quaternion
+    gx *= 0.5f * dt;
+    gy *= 0.5f * dt;
+    gz *= 0.5f * dt;
+    q0 += -q1 * gx - q2 * gy - q3 * gz;
+    q1 += att->q0 * gx + q2 * gz - q3 * gy;
+    q2 += att->q0 * gy - att->q1 * gz + q3 * gx;
+    q3 += att->q0 * gz + att->q1 * gy - att->q2 * gx;
+
+    recip_norm = inv_norm4(q0, q1, q2, q3);
+    att->q0 = q0 * recip_norm;
+    att->q1 = q1 * recip_norm;
+    att->q2 = q2 * recip_norm;
+    att->q3 = q3 * recip_norm;
+}
+
+// ---------------------------
+// Initialize filter state
+// ---------------------------
+void attitude_init(attitude_t *att, attitude_filter_t filter) {
+    att->filter = filter;
+    att->beta = ATTITUDE_DEFAULT_BETA;
+    att->kp = ATTITUDE_DEFAULT_KP;
+    attitude_reset(att);
+}
+
+// ---------------------------
+// Forget the current estimate; the next update re-seeds from accel/mag
+// ---------------------------
+void attitude_reset(attitude_t *att) {
+    att->q0 = 1.0f;
+    att->q1 = 0.0f;
+    att->q2 = 0.0f;
+    att->q3 = 0.0f;
+    att->initialized = 0;
+}
+
+// ---------------------------
+// Fuse one gyro/accel/mag sample
+// ---------------------------
+void attitude_update(attitude_t *att,
+                     float gx, float gy, float gz,
+                     float ax, float ay, float az,
+                     float mx, float my, float mz,
+                     float dt) {
+    // Seed from the absolute references so the filter does not have to
+    // converge from identity, and fall back to them in accel mode
+    if (!att->initialized || att->filter == ATTITUDE_FILTER_ACCEL) {
+        set_from_vectors(att, ax, ay, az, mx, my, mz);
+        return;
+    }
+
+    dt = fminf(fmaxf(dt, 0.0f), ATTITUDE_MAX_DT);
+
+    if (att->filter == ATTITUDE_FILTER_MADGWICK) {
+        madgwick_update(att, gx, gy, gz, ax, ay, az, mx, my, mz, dt);
+    } else {
+        complementary_update(att, gx, gy, gz, ax, ay, az, mx, my, mz, dt);
+    }
+}
+
+// ---------------------------
+// Convert quaternion to roll, pitch, yaw in degrees
+// ---------------------------
+void attitude_get_euler(const attitude_t *att, float *roll, float *pitch, float *yaw) {
+    float q0 = att->q0, q1 = att->q1, q2 = att->q2, q3 = att->q3;
+    float sinp = fminf(fmaxf(2.0f * (q0 * q2 - q3 * q1), -1.0f), 1.0f);
+
+    *roll = imu_atan2f(2.0f * (q0 * q1 + q2 * q3), 1.0f - 2.0f * (q1 * q1 + q2 * q2)) * RAD_TO_DEG;
+    *pitch = imu_asinf(sinp) * RAD_TO_DEG;
+    // Filter yaw is counter-clockwise about z up; report compass convention
+    *yaw = -imu_atan2f(2.0f * (q0 * q3 + q1 * q2), 1.0f - 2.0f * (q2 * q2 + q3 * q3)) * RAD_TO_DEG;
+}
+
+const char *attitude_filter_name(attitude_filter_t filter) {
+    switch (filter) {
+        case ATTITUDE_FILTER_ACCEL:
+            return "accel";
+        case ATTITUDE_FILTER_COMPLEMENTARY:
+            return "complementary";
+        case ATTITUDE_FILTER_MADGWICK:
+            return "madgwick";
+    }
+    return "unknown";
+}
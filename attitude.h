@@ -0,0 +1,40 @@
+#ifndef ATTITUDE_H
+#define ATTITUDE_H
+
+// Configuration
+#define ATTITUDE_DEFAULT_BETA   0.1f   // Madgwick gradient-descent gain
+#define ATTITUDE_DEFAULT_KP     1.0f   // Complementary filter correction gain
+#define ATTITUDE_MAX_DT         0.1f   // s, clamp after stalls or restarts
+
+typedef enum {
+    ATTITUDE_FILTER_ACCEL = 0,       // Accel tilt + tilt-compensated mag, no gyro
+    ATTITUDE_FILTER_COMPLEMENTARY,   // Mahony-style explicit complementary filter
+    ATTITUDE_FILTER_MADGWICK         // Madgwick gradient-descent MARG filter
+} attitude_filter_t;
+
+// Quaternion attitude estimate (sensor frame relative to earth frame, z up)
+typedef struct {
+    float q0, q1, q2, q3;
+    attitude_filter_t filter;
+    float beta;
+    float kp;
+    int initialized;
+} attitude_t;
+
+// Attitude Filter Functions (float-only, safe to call at the full ODR)
+void attitude_init(attitude_t *att, attitude_filter_t filter);
+void attitude_reset(attitude_t *att);
+
+// gyro in rad/s, accel and mag in any unit (normalized internally), dt in s
+void attitude_update(attitude_t *att,
+                     float gx, float gy, float gz,
+                     float ax, float ay, float az,
+                     float mx, float my, float mz,
+                     float dt);
+
+// Roll, pitch and yaw in degrees (yaw clockwise positive, like a compass)
+void attitude_get_euler(const attitude_t *att, float *roll, float *pitch, float *yaw);
+
+const char *attitude_filter_name(attitude_filter_t filter);
+
+#endif // ATTITUDE_H
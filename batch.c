@@ -0,0 +1,166 @@
+#include "batch.h"
+#include "pwm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+// Append 's' (at most 'len' bytes) as a JSON string
+static size_t append_string(char *out, size_t size, size_t pos, const char *s, size_t len) {
+    if (pos < size) out[pos] = '"';
+    pos++;
+    for (size_t i = 0; i < len && pos < size; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '"' || c == '\\') {
+            pos += snprintf(out + pos, size - pos, "\\%c", c);
+        } else if (c < 0x20) {
+            pos += snprintf(out + pos, size - pos, "\\u%04x", c);
+        } else {
+            out[pos++] = c;
+        }
+    }
+    if (pos < size) out[pos] = '"';
+    pos++;
+    if (pos < size) out[pos] = '\0';
+    return pos;
+}
+
+static char *trim(char *s) {
+    while (*s == ' ' || *s == '\t') s++;
+    char *end = s + strlen(s);
+    while (end > s && (end[-1] == ' ' || end[-1] == '\t')) end--;
+    *end = '\0';
+    return s;
+}
+
+// ---------------------------
+// Execute batch command
+// Commands:
+//   "<command>; <command>; ..." - Run each command, stopping at the first
+//        error; queued PWM changes are applied together if none failed
+//        and discarded otherwise
+// ---------------------------
+int execute_batch_command(char *cmd_str, char *response, size_t response_size) {
+    char *commands[BATCH_MAX_COMMANDS];
+    int count = 0;
+    char *save = NULL;
+
+    if (cmd_str == NULL || response == NULL) {
+        return -1;
+    }
+
+    for (char *part = strtok_r(cmd_str, ";", &save); part; part = strtok_r(NULL, ";", &save)) {
+        part = trim(part);
+        if (*part == '\0') continue;
+        if (count == BATCH_MAX_COMMANDS) {
+            snprintf(response, response_size, "ERROR: More than %d commands in BATCH\n",
+                     BATCH_MAX_COMMANDS);
+            return -1;
+        }
+        if (strncasecmp(part, "BATCH", 5) == 0 && (part[5] == '\0' || part[5] == ' ' || part[5] == '\t')) {
+            snprintf(response, response_size, "ERROR: BATCH cannot be nested\n");
+            return -1;
+        }
+        commands[count++] = part;
+    }
+    if (count == 0) {
+        snprintf(response, response_size, "ERROR: Empty BATCH command\n");
+        return -1;
+    }
+
+    char *sub = malloc(response_size);
+    if (sub == NULL) {
+        snprintf(response, response_size, "ERROR: Out of memory\n");
+        return -1;
+    }
+
+    size_t pos = snprintf(response, response_size, "{\"results\":[");
+    int failed = 0;
+
+    pwm_batch_begin();
+    for (int i = 0; i < count; i++) {
+        if (pos < response_size) {
+            pos += snprintf(response + pos, response_size - pos, "%s{\"command\":", i ? "," : "");
+        }
+        pos = append_string(response, response_size, pos, commands[i], strlen(commands[i]));
+
+        if (failed) {
+            if (pos < response_size) {
+                pos += snprintf(response + pos, response_size - pos, ",\"status\":\"skipped\"}");
+            }
+            continue;
+        }
+
+        size_t len = modules_dispatch(commands[i], sub, response_size);
+        while (len > 0 && (sub[len - 1] == '\n' || sub[len - 1] == '\r')) sub[--len] = '\0';
+        failed = strncmp(sub, "ERROR", 5) == 0;
+
+        if (pos < response_size) {
+            pos += snprintf(response + pos, response_size - pos, ",\"status\":\"%s\",\"response\":",
+                            failed ? "error" : "ok");
+        }
+        if (sub[0] == '{' || sub[0] == '[') {
+            // Already JSON
+            if (pos < response_size) {
+                pos += snprintf(response + pos, response_size - pos, "%s", sub);
+            }
+        } else {
+            pos = append_string(response, response_size, pos, sub, len);
+        }
+        if (pos < response_size) {
+            pos += snprintf(response + pos, response_size - pos, "}");
+        }
+    }
+    free(sub);
+
+    const char *pwm = "discarded";
+    if (failed) {
+        pwm_batch_discard();
+    } else if (pwm_batch_flush() < 0) {
+        pwm = "failed";
+    } else {
+        pwm = "applied";
+    }
+
+    if (pos < response_size) {
+        snprintf(response + pos, response_size - pos, "],\"ok\":%s,\"pwm\":\"%s\"}\n",
+                 failed ? "false" : "true", pwm);
+    }
+    return failed ? -1 : 0;
+}
+
+// Control only if every sub-command is: a telemetry read inside a BATCH
+// must still go through the rate limit and the telemetry worker
+int batch_is_control(const char *cmd_str) {
+    int count = 0;
+
+    while (*cmd_str) {
+        size_t len = strcspn(cmd_str, ";");
+        size_t skip = strspn(cmd_str, " \t");
+        if (skip < len) {
+            // Routing looks at the first word only
+            char word[32];
+            size_t n = strcspn(cmd_str + skip, " \t;");
+            if (n >= sizeof(word)) {
+                return 0;
+            }
+            memcpy(word, cmd_str + skip, n);
+            word[n] = '\0';
+            if (!modules_is_control(word)) {
+                return 0;
+            }
+            count++;
+        }
+        cmd_str += len;
+        if (*cmd_str == ';') cmd_str++;
+    }
+    return count > 0;
+}
+
+const module_t batch_module = {
+    .name = "batch",
+    .prefix = "BATCH",
+    .usage = "BATCH <command>; <command>; ... (PWM changes applied together)",
+    .command = execute_batch_command,
+    .is_control = batch_is_control,
+};
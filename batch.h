@@ -0,0 +1,22 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+#include "module.h"
+
+// Configuration
+#define BATCH_MAX_COMMANDS 16
+
+// "BATCH <command>; <command>; ..." runs the sub-commands in order through
+// the module registry and answers with one status per command. PWM
+// writes are held back and sent together at the end, and only if every
+// sub-command succeeded; other side effects are not rolled back.
+int execute_batch_command(char *cmd_str, char *response, size_t response_size);
+
+// module_t.is_control: 1 if every sub-command goes to a control module
+int batch_is_control(const char *cmd_str);
+
+// Registry descriptor (module.h), command-only
+extern const module_t batch_module;
+
+#endif // BATCH_H
@@ -0,0 +1,73 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+// Keep the compiler from optimizing away a benchmarked result
+#define BENCH_KEEP(x) __asm__ volatile("" : : "g"(x) : "memory")
+
+// Timed repetitions per bench_run(); the median is reported so one
+// preempted repetition (timer tick, CPU frequency step) does not move it
+#ifndef BENCH_REPEATS
+#define BENCH_REPEATS 5
+#endif
+
+// Tags every result so x86 and Pi numbers can share one results file
+#if defined(__aarch64__)
+#define BENCH_ARCH "aarch64"
+#elif defined(__arm__)
+#define BENCH_ARCH "arm"
+#elif defined(__x86_64__)
+#define BENCH_ARCH "x86_64"
+#else
+#define BENCH_ARCH "unknown"
+#endif
+
+// Results go to stdout unless a bench points this elsewhere, e.g. to keep
+// driver messages printed on stdout out of the JSON lines
+static FILE *bench_out;
+#define BENCH_OUT (bench_out ? bench_out : stdout)
+
+static inline uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// One JSON object per line so results can be collected by scripts
+static inline void bench_report(const char *name, unsigned long iterations, uint64_t elapsed_ns) {
+    fprintf(BENCH_OUT, "{\"bench\":\"%s\",\"arch\":\"%s\",\"iterations\":%lu,\"ns_per_op\":%.2f}\n",
+            name, BENCH_ARCH, iterations, (double)elapsed_ns / iterations);
+}
+
+// Body of a measurement: perform the operation 'iterations' times
+typedef void (*bench_fn_t)(void *arg, unsigned long iterations);
+
+// Warm up once, time BENCH_REPEATS runs and report the median with the
+// spread, same fields as bench_report() plus min/max. Returns the median.
+static inline double bench_run(const char *name, bench_fn_t fn, void *arg, unsigned long iterations) {
+    uint64_t runs[BENCH_REPEATS];
+
+    fn(arg, iterations / 10 + 1);
+    for (int r = 0; r < BENCH_REPEATS; r++) {
+        uint64_t start = bench_now_ns();
+        fn(arg, iterations);
+        uint64_t elapsed = bench_now_ns() - start;
+
+        int i = r;
+        for (; i > 0 && runs[i - 1] > elapsed; i--) runs[i] = runs[i - 1];
+        runs[i] = elapsed;
+    }
+
+    fprintf(BENCH_OUT, "{\"bench\":\"%s\",\"arch\":\"%s\",\"iterations\":%lu,\"ns_per_op\":%.2f,"
+            "\"min_ns_per_op\":%.2f,\"max_ns_per_op\":%.2f}\n",
+            name, BENCH_ARCH, iterations,
+            (double)runs[BENCH_REPEATS / 2] / iterations,
+            (double)runs[0] / iterations,
+            (double)runs[BENCH_REPEATS - 1] / iterations);
+    return (double)runs[BENCH_REPEATS / 2] / iterations;
+}
+
+#endif // BENCH_H
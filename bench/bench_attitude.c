@@ -0,0 +1,79 @@
+#include "bench.h"
+#include "../attitude.h"
+#include <math.h>
+
+#define SAMPLES     1024
+#define ITERATIONS  500000UL
+#define ODR_HZ      952.0f
+
+typedef struct {
+    float gx, gy, gz;
+    float ax, ay, az;
+    float mx, my, mz;
+} sample_t;
+
+static sample_t samples[SAMPLES];
+
+// Slow yaw rotation with a little tilt and sensor noise
+static void generate_samples(void) {
+    unsigned int seed = 12345;
+    for (int i = 0; i < SAMPLES; i++) {
+        float t = i / ODR_HZ;
+        float yaw = 0.5f * t;
+        float noise[9];
+        for (int k = 0; k < 9; k++) {
+            seed = seed * 1103515245u + 12345u;
+            noise[k] = ((seed >> 16) & 0x7FFF) / 32768.0f - 0.5f;
+        }
+        samples[i].gx = 0.01f * noise[0];
+        samples[i].gy = 0.01f * noise[1];
+        samples[i].gz = 0.5f + 0.01f * noise[2];
+        samples[i].ax = 0.3f + 0.05f * noise[3];
+        samples[i].ay = 0.2f + 0.05f * noise[4];
+        samples[i].az = 9.8f + 0.05f * noise[5];
+        samples[i].mx = 25.0f * cosf(yaw) + 0.5f * noise[6];
+        samples[i].my = -25.0f * sinf(yaw) + 0.5f * noise[7];
+        samples[i].mz = -40.0f + 0.5f * noise[8];
+    }
+}
+
+typedef struct {
+    attitude_t att;
+    int euler;   // Also read back roll/pitch/yaw, as calculate_orientation() does
+} filter_state_t;
+
+static void update_loop(void *arg, unsigned long iterations) {
+    filter_state_t *st = arg;
+    const float dt = 1.0f / ODR_HZ;
+    float roll, pitch, yaw;
+
+    for (unsigned long i = 0; i < iterations; i++) {
+        const sample_t *s = &samples[i & (SAMPLES - 1)];
+        attitude_update(&st->att, s->gx, s->gy, s->gz, s->ax, s->ay, s->az,
+                        s->mx, s->my, s->mz, dt);
+        if (st->euler) {
+            attitude_get_euler(&st->att, &roll, &pitch, &yaw);
+            BENCH_KEEP(yaw);
+        }
+    }
+    BENCH_KEEP(st->att.q0);
+}
+
+static void run(const char *name, attitude_filter_t filter, int euler) {
+    filter_state_t st = { .euler = euler };
+    attitude_init(&st.att, filter);
+
+    double ns = bench_run(name, update_loop, &st, ITERATIONS);
+    printf("# %s uses %.3f%% of the %.0f us per-sample budget at %.0f Hz\n",
+           name, 100.0 * ns / (1e9 / ODR_HZ), 1e6 / ODR_HZ, ODR_HZ);
+}
+
+int main(void) {
+    generate_samples();
+    run("attitude_accel", ATTITUDE_FILTER_ACCEL, 0);
+    run("attitude_complementary", ATTITUDE_FILTER_COMPLEMENTARY, 0);
+    run("attitude_madgwick", ATTITUDE_FILTER_MADGWICK, 0);
+    // Full calculate_orientation() step with the default filter
+    run("calculate_orientation", ATTITUDE_FILTER_MADGWICK, 1);
+    return 0;
+}
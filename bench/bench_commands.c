@@ -0,0 +1,191 @@
+#include "bench.h"
+#include "../hal.h"
+#include "../imu.h"
+#include "../sonar.h"
+#include "../pwm.h"
+#include "../snapshot.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#define ITERATIONS      200000UL
+#define PWM_ITERATIONS  2000UL
+#define THREADS         4
+
+// Handlers run against the emulated chips with no bus time, so the numbers
+// are the command path itself rather than the I2C clock
+static const hal_emu_config_t bench_emu = { 4000000000u, 0, 450, 100.0f };
+
+// ---------------------------
+// Driver chatter (init banners, "Setting Ch0=...") goes to stdout; send it
+// to /dev/null and keep the real stdout for results
+// ---------------------------
+static int redirect_stdout(void) {
+    int null_fd = open("/dev/null", O_WRONLY);
+    int results_fd = dup(STDOUT_FILENO);
+    if (null_fd < 0 || results_fd < 0) return -1;
+
+    bench_out = fdopen(results_fd, "w");
+    if (bench_out == NULL) return -1;
+    setvbuf(bench_out, NULL, _IOLBF, 0);
+    fflush(stdout);
+    dup2(null_fd, STDOUT_FILENO);
+    close(null_fd);
+    return 0;
+}
+
+// ---------------------------
+// Command handlers: parse the line and format the response
+// ---------------------------
+typedef struct {
+    int (*handler)(char *cmd_str, char *response, size_t response_size);
+    const char *line;
+    long failures;
+} command_case_t;
+
+static void command_loop(void *arg, unsigned long iterations) {
+    command_case_t *c = arg;
+    char line[64], response[512];
+
+    for (unsigned long i = 0; i < iterations; i++) {
+        // A fresh copy each round, like the line the server passes in; the
+        // cmd_parse handlers only read it
+        strcpy(line, c->line);
+        if (c->handler(line, response, sizeof(response)) < 0) c->failures++;
+        BENCH_KEEP(response[0]);
+    }
+}
+
+static int pwm_dev = -1;
+
+static int pwm_handler(char *cmd_str, char *response, size_t response_size) {
+    return execute_pwm_command(pwm_dev, cmd_str, response, response_size);
+}
+
+// Same line with the register writes queued as in a BATCH and dropped:
+// parsing and formatting without the I2C bus thread
+static int pwm_queued_handler(char *cmd_str, char *response, size_t response_size) {
+    pwm_batch_begin();
+    int ret = execute_pwm_command(pwm_dev, cmd_str, response, response_size);
+    pwm_batch_discard();
+    return ret;
+}
+
+static long run_command(const char *name, int (*handler)(char *, char *, size_t),
+                        const char *line, unsigned long iterations) {
+    command_case_t c = { handler, line, 0 };
+
+    // Only time lines the handler accepts
+    command_loop(&c, 1);
+    if (c.failures == 0) {
+        bench_run(name, command_loop, &c, iterations);
+    }
+    if (c.failures) fprintf(BENCH_OUT, "# %s: '%s' failed\n", name, line);
+    return c.failures;
+}
+
+// ---------------------------
+// Snapshot get under contention: readers copy the IMU sample while the
+// read thread keeps publishing new ones
+// ---------------------------
+static void snapshot_loop(void *arg, unsigned long iterations) {
+    imu_data_t data;
+    (void)arg;
+    for (unsigned long i = 0; i < iterations; i++) {
+        get_imu_data(&data);
+        BENCH_KEEP(data.accel_z);
+    }
+}
+
+// Same under the SNAPSHOT sequence lock: IMU, sonar and PWM together
+static void combined_loop(void *arg, unsigned long iterations) {
+    snapshot_t s;
+    (void)arg;
+    for (unsigned long i = 0; i < iterations; i++) {
+        snapshot_get(&s);
+        BENCH_KEEP(s.imu.accel_z);
+    }
+}
+
+// Extra readers spin until the timed one is done
+static volatile int contending;
+
+static void *snapshot_thread(void *arg) {
+    bench_fn_t loop = (bench_fn_t)arg;
+    while (contending) {
+        loop(NULL, 1000);
+    }
+    return NULL;
+}
+
+static void run_snapshot(const char *base, bench_fn_t loop, int readers) {
+    pthread_t threads[THREADS];
+    char name[48];
+
+    contending = 1;
+    for (int t = 0; t < readers - 1; t++) {
+        pthread_create(&threads[t], NULL, snapshot_thread, (void *)loop);
+    }
+    if (readers > 1) {
+        snprintf(name, sizeof(name), "%s_%dreaders", base, readers);
+    } else {
+        snprintf(name, sizeof(name), "%s", base);
+    }
+    bench_run(name, loop, NULL, ITERATIONS * 10);
+    contending = 0;
+    for (int t = 0; t < readers - 1; t++) {
+        pthread_join(threads[t], NULL);
+    }
+}
+
+int main(void) {
+    long failed = 0;
+
+    if (redirect_stdout() < 0) {
+        perror("redirect stdout");
+        return 1;
+    }
+
+    hal_use_emulated(&bench_emu);
+    pwm_dev = init_pwm_controller();
+    int imu_ok = init_imu_controller() == 0 && start_imu_thread() == 0;
+    int sonar_ok = init_sonar_controller() == 0 && start_sonar_thread() == 0;
+    if (pwm_dev < 0 || !imu_ok || !sonar_ok) {
+        fprintf(BENCH_OUT, "# emulated device bring-up failed\n");
+        return 1;
+    }
+
+    // Let the IMU publish real samples and the sonar settle
+    usleep(SONAR_STABILIZE_US + 200000);
+
+    failed += run_command("imu_cmd_read", execute_imu_command, "read", ITERATIONS);
+    failed += run_command("imu_cmd_orientation", execute_imu_command, "orientation", ITERATIONS);
+    failed += run_command("sonar_cmd_read", execute_sonar_command, "read", ITERATIONS);
+    failed += run_command("sonar_cmd_distance", execute_sonar_command, "distance", ITERATIONS);
+    // PWM lines end in I2C writes through the bus thread: far fewer rounds
+    failed += run_command("pwm_cmd_dual", pwm_handler, "42.5 57.5", PWM_ITERATIONS);
+    failed += run_command("pwm_cmd_channel", pwm_handler, "-c 3 75", PWM_ITERATIONS);
+    failed += run_command("pwm_cmd_dual_queued", pwm_queued_handler, "42.5 57.5", ITERATIONS);
+    failed += run_command("pwm_cmd_channel_queued", pwm_queued_handler, "-c 3 75", ITERATIONS);
+    fprintf(BENCH_OUT, "# pwm_cmd_*: include the round trip through the I2C bus thread, shared "
+            "with the IMU read thread (emulated bus time is zero); *_queued: the command alone\n");
+
+    failed += run_command("snapshot_cmd", execute_snapshot_command, "", ITERATIONS);
+
+    run_snapshot("imu_snapshot_get", snapshot_loop, 1);
+    run_snapshot("imu_snapshot_get", snapshot_loop, THREADS);
+    run_snapshot("snapshot_get", combined_loop, 1);
+    run_snapshot("snapshot_get", combined_loop, THREADS);
+    fprintf(BENCH_OUT, "# snapshot publisher: IMU read thread on the emulated LSM9DS1\n");
+    fprintf(BENCH_OUT, "# contended runs cover the snapshot reads only, not command handlers\n");
+
+    stop_sonar_thread();
+    stop_imu_thread();
+    close_sonar_controller();
+    close_imu_controller();
+    close_pwm_controller(pwm_dev);
+
+    return failed ? 1 : 0;
+}
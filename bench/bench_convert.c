@@ -0,0 +1,148 @@
+#include "bench.h"
+#include "../lsm9ds1.h"
+#include <string.h>
+#include <stdlib.h>
+
+#define N           LSM9DS1_BLOCK_SIZE
+#define ITERATIONS  50000UL
+
+static const float accel_mg_lsb[] = { 0.061f, 0.122f, 0.244f, 0.732f };
+
+// Former per-axis expression from lsm9ds1_read()
+static void convert_legacy(const int16_t *in, float *out, size_t n, float mg_lsb) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = (in[i] * mg_lsb / 1000.0f) * SENSORS_GRAVITY_STANDARD;
+    }
+}
+
+// Every int16 value through both kernels must give identical bits
+static int check_exact(float scale) {
+    static int16_t in[65536];
+    static float ref[65536], out[65536];
+    for (int i = 0; i < 65536; i++) in[i] = (int16_t)(i - 32768);
+
+    lsm9ds1_convert_i16_scalar(in, ref, 65536, scale);
+    lsm9ds1_convert_i16(in, out, 65536, scale);
+
+    int mismatches = 0;
+    for (int i = 0; i < 65536; i++) {
+        if (memcmp(&ref[i], &out[i], sizeof(float)) != 0) mismatches++;
+    }
+    // Odd lengths and offsets exercise the scalar tail
+    lsm9ds1_convert_i16(in + 3, out, 61, scale);
+    if (memcmp(ref + 3, out, 61 * sizeof(float)) != 0) mismatches++;
+    return mismatches;
+}
+
+static int16_t raw[LSM9DS1_NUM_AXES][N];
+static float out[LSM9DS1_NUM_AXES][N];
+static lsm9ds1_block_t block;
+
+// The block API against the scalar kernel, axis by axis with each group's
+// scale; samples past 'count' must be left alone
+static int check_block(size_t count, float accel, float gyro, float mag) {
+    static const float sentinel = -12345.0f;
+    float ref[N];
+    int mismatches = 0;
+
+    memcpy(block.raw, raw, sizeof(raw));
+    for (int a = 0; a < LSM9DS1_NUM_AXES; a++) {
+        for (int i = 0; i < N; i++) block.si[a][i] = sentinel;
+    }
+    block.count = count;
+    block.accel_scale = accel;
+    block.gyro_scale = gyro;
+    block.mag_scale = mag;
+    lsm9ds1_block_convert(&block);
+
+    for (int a = 0; a < LSM9DS1_NUM_AXES; a++) {
+        float scale = a < LSM9DS1_AXIS_GX ? accel : a < LSM9DS1_AXIS_MX ? gyro : mag;
+        lsm9ds1_convert_i16_scalar(raw[a], ref, count, scale);
+        if (memcmp(ref, block.si[a], count * sizeof(float)) != 0) mismatches++;
+        for (size_t i = count; i < N; i++) {
+            if (block.si[a][i] != sentinel) mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+static void block_legacy(void *arg, unsigned long iterations) {
+    float mg_lsb = *(const float *)arg;
+    for (unsigned long it = 0; it < iterations; it++) {
+        for (int a = 0; a < LSM9DS1_NUM_AXES; a++) convert_legacy(raw[a], out[a], N, mg_lsb);
+        BENCH_KEEP(out[0][0]);
+    }
+}
+
+static void block_scalar(void *arg, unsigned long iterations) {
+    float scale = *(const float *)arg;
+    for (unsigned long it = 0; it < iterations; it++) {
+        for (int a = 0; a < LSM9DS1_NUM_AXES; a++) lsm9ds1_convert_i16_scalar(raw[a], out[a], N, scale);
+        BENCH_KEEP(out[0][0]);
+    }
+}
+
+static void block_simd(void *arg, unsigned long iterations) {
+    float scale = *(const float *)arg;
+    for (unsigned long it = 0; it < iterations; it++) {
+        for (int a = 0; a < LSM9DS1_NUM_AXES; a++) lsm9ds1_convert_i16(raw[a], out[a], N, scale);
+        BENCH_KEEP(out[0][0]);
+    }
+}
+
+static void block_api(void *arg, unsigned long iterations) {
+    (void)arg;
+    for (unsigned long it = 0; it < iterations; it++) {
+        lsm9ds1_block_convert(&block);
+        BENCH_KEEP(block.si[0][0]);
+    }
+}
+
+int main(void) {
+    unsigned int seed = 42;
+    for (int a = 0; a < LSM9DS1_NUM_AXES; a++) {
+        for (int i = 0; i < N; i++) {
+            seed = seed * 1103515245u + 12345u;
+            raw[a][i] = (int16_t)(seed >> 16);
+        }
+    }
+
+    float mg_lsb = accel_mg_lsb[1];
+    float scale = mg_lsb / 1000.0f * SENSORS_GRAVITY_STANDARD;
+
+    bench_run("convert_block_legacy", block_legacy, &mg_lsb, ITERATIONS);
+    bench_run("convert_block_scalar", block_scalar, &scale, ITERATIONS);
+    bench_run("convert_block_simd", block_simd, &scale, ITERATIONS);
+
+    // lsm9ds1_block_convert() as the IMU history pages use it
+    memcpy(block.raw, raw, sizeof(raw));
+    block.count = N;
+    block.accel_scale = scale;
+    block.gyro_scale = 0.00875f * SENSORS_DPS_TO_RADS;
+    block.mag_scale = 1.0f / 6842.0f * 100.0f;
+    bench_run("convert_block_api", block_api, NULL, ITERATIONS);
+    printf("# block of %d samples x %d axes, kernel: %s\n", N, LSM9DS1_NUM_AXES, lsm9ds1_convert_impl());
+
+    // Bit-exactness against the scalar path for every range's scale
+    int failures = 0;
+    for (size_t r = 0; r < sizeof(accel_mg_lsb) / sizeof(accel_mg_lsb[0]); r++) {
+        failures += check_exact(accel_mg_lsb[r] / 1000.0f * SENSORS_GRAVITY_STANDARD);
+    }
+    failures += check_exact(0.00875f * SENSORS_DPS_TO_RADS);
+    failures += check_exact(0.07f * SENSORS_DPS_TO_RADS);
+    failures += check_exact(1.0f / 6842.0f * 100.0f);
+    failures += check_exact(1.0f / 1711.0f * 100.0f);
+    printf("# bit-exact vs scalar: %s (%d mismatches)\n", failures ? "FAIL" : "ok", failures);
+
+    // Full, partial and empty blocks with distinct scales per group
+    int block_failures = 0;
+    static const size_t counts[] = { N, N - 1, 37, 1, 0 };
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        block_failures += check_block(counts[c], scale, 0.07f * SENSORS_DPS_TO_RADS,
+                                      1.0f / 1711.0f * 100.0f);
+    }
+    printf("# block API vs scalar: %s (%d mismatches)\n", block_failures ? "FAIL" : "ok", block_failures);
+    failures += block_failures;
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
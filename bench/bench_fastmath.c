@@ -0,0 +1,105 @@
+#include "bench.h"
+#include "../fastmath.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define ITERATIONS   10000000UL
+#define SWEEP_POINTS 2000000
+#define RAD_TO_DEG   57.29577951
+
+// Budget of the attitude output; each kernel is also held to the bound
+// fastmath.h documents for it
+#define MAX_ERROR_DEG 0.05
+
+static float inputs[1024][2];
+
+// ---------------------------
+// Accuracy sweep against libm (double) over the full input range
+// ---------------------------
+static double sweep_atan2(void) {
+    double max_err = 0.0;
+    static const float radii[] = { 1e-6f, 1e-3f, 1.0f, 9.81f, 50.0f, 1e4f };
+    for (size_t r = 0; r < sizeof(radii) / sizeof(radii[0]); r++) {
+        for (int i = 0; i < SWEEP_POINTS / 6; i++) {
+            double angle = -M_PI + 2.0 * M_PI * i / (SWEEP_POINTS / 6);
+            float y = radii[r] * (float)sin(angle);
+            float x = radii[r] * (float)cos(angle);
+            double err = fabs(fast_atan2f(y, x) - atan2((double)y, (double)x));
+            if (err > M_PI) err = 2.0 * M_PI - err;  // -pi and pi are the same angle
+            if (err > max_err) max_err = err;
+        }
+    }
+    return max_err * RAD_TO_DEG;
+}
+
+static double sweep_asin(void) {
+    double max_err = 0.0;
+    for (int i = 0; i <= SWEEP_POINTS; i++) {
+        float x = -1.0f + 2.0f * i / SWEEP_POINTS;
+        double err = fabs(fast_asinf(x) - asin((double)x));
+        if (err > max_err) max_err = err;
+    }
+    return max_err * RAD_TO_DEG;
+}
+
+static double sweep_sqrt(void) {
+    double max_rel = 0.0;
+    for (int i = 1; i <= SWEEP_POINTS; i++) {
+        float x = (float)i * 1e-3f;
+        double exact = sqrt((double)x);
+        double rel = fabs(fast_sqrtf(x) - exact) / exact;
+        if (rel > max_rel) max_rel = rel;
+    }
+    return max_rel;
+}
+
+// ---------------------------
+// Throughput
+// ---------------------------
+#define RUN(name, expr)                                              \
+    do {                                                             \
+        float acc = 0.0f;                                            \
+        uint64_t start = bench_now_ns();                             \
+        for (unsigned long i = 0; i < ITERATIONS; i++) {             \
+            float a = inputs[i & 1023][0], b = inputs[i & 1023][1];  \
+            (void)b;                                                 \
+            acc += (expr);                                           \
+        }                                                            \
+        BENCH_KEEP(acc);                                             \
+        bench_report(name, ITERATIONS, bench_now_ns() - start);      \
+    } while (0)
+
+int main(void) {
+    unsigned int seed = 7;
+    for (int i = 0; i < 1024; i++) {
+        seed = seed * 1103515245u + 12345u;
+        inputs[i][0] = ((seed >> 8) & 0xFFFF) / 32768.0f - 1.0f;
+        seed = seed * 1103515245u + 12345u;
+        inputs[i][1] = ((seed >> 8) & 0xFFFF) / 32768.0f - 1.0f;
+    }
+
+    RUN("atan2_libm_double", (float)atan2((double)a, (double)b));
+    RUN("atan2_libm_float", atan2f(a, b));
+    RUN("atan2_fast", fast_atan2f(a, b));
+    RUN("asin_libm_double", (float)asin((double)a));
+    RUN("asin_libm_float", asinf(a));
+    RUN("asin_fast", fast_asinf(a));
+    RUN("sqrt_libm_double", (float)sqrt((double)fabsf(a)));
+    RUN("sqrt_fast", fast_sqrtf(fabsf(a)));
+
+    double atan2_err = sweep_atan2();
+    double asin_err = sweep_asin();
+    double sqrt_rel = sweep_sqrt();
+    printf("# max error atan2: %.6f deg, asin: %.6f deg, sqrt: %.2e relative\n",
+           atan2_err, asin_err, sqrt_rel);
+
+    int ok = atan2_err < MAX_ERROR_DEG && asin_err < MAX_ERROR_DEG && sqrt_rel < 1e-6;
+    printf("# accuracy within %.2f deg: %s\n", MAX_ERROR_DEG, ok ? "ok" : "FAIL");
+
+    int documented = atan2_err / RAD_TO_DEG < FASTMATH_ATAN2_MAX_ERROR &&
+                     asin_err / RAD_TO_DEG < FASTMATH_ASIN_MAX_ERROR;
+    printf("# within fastmath.h bounds (atan2 %.1e, asin %.1e rad): %s\n",
+           FASTMATH_ATAN2_MAX_ERROR, FASTMATH_ASIN_MAX_ERROR, documented ? "ok" : "FAIL");
+    ok = ok && documented;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,145 @@
+#include "bench.h"
+#include "../net_server.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#define CLIENTS              4
+#define REQUESTS_PER_CLIENT  500
+#define RESPONSE_SIZE        65536
+
+static const char request[] = "IMU read\n";
+static const char reply[] = "{\"accel\":{\"x\":0.01,\"y\":-0.02,\"z\":9.81}}\n";
+
+static volatile int server_running;
+static int server_fd;
+static int use_uring;
+static unsigned short port;
+
+static size_t handle(char *line, char *response, size_t response_size, void *ctx) {
+    (void)line;
+    (void)ctx;
+    snprintf(response, response_size, "%s", reply);
+    return strlen(response);
+}
+
+static void *server_thread(void *arg) {
+    (void)arg;
+    if (use_uring &&
+        net_serve_uring(server_fd, &server_running, handle, NULL, RESPONSE_SIZE) == 0) {
+        return NULL;
+    }
+    if (use_uring) {
+        printf("# io_uring unavailable, measuring the fallback\n");
+    }
+    net_serve_blocking(server_fd, &server_running, handle, NULL, RESPONSE_SIZE);
+    return NULL;
+}
+
+// One connection per request, like the vehicle's command clients
+static void *client_thread(void *arg) {
+    long *failures = arg;
+    struct sockaddr_in addr;
+    char buffer[256];
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+
+    for (int i = 0; i < REQUESTS_PER_CLIENT; i++) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        size_t total = 0;
+        ssize_t n;
+
+        if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+            write(fd, request, sizeof(request) - 1) < 0) {
+            (*failures)++;
+            close(fd);
+            continue;
+        }
+        while ((n = read(fd, buffer + total, sizeof(buffer) - 1 - total)) > 0) {
+            total += n;
+        }
+        buffer[total] = '\0';
+        if (strcmp(buffer, reply) != 0) (*failures)++;
+        close(fd);
+    }
+    return NULL;
+}
+
+static int open_server(void) {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    int opt = 1;
+
+    server_fd = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    if (bind(server_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(server_fd, 64) < 0) {
+        return -1;
+    }
+    getsockname(server_fd, (struct sockaddr *)&addr, &len);
+    port = ntohs(addr.sin_port);
+
+    // Same accept timeout as main.c so the blocking loop sees shutdown
+    struct timeval tv = { 1, 0 };
+    setsockopt(server_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return 0;
+}
+
+static long run(const char *name) {
+    pthread_t server, clients[CLIENTS];
+    long failures[CLIENTS] = {0};
+    net_server_stats_t before, after;
+
+    if (open_server() < 0) {
+        return 1;
+    }
+    server_running = 1;
+    net_server_get_stats(&before);
+    pthread_create(&server, NULL, server_thread, NULL);
+
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < CLIENTS; i++) {
+        pthread_create(&clients[i], NULL, client_thread, &failures[i]);
+    }
+    long failed = 0;
+    for (int i = 0; i < CLIENTS; i++) {
+        pthread_join(clients[i], NULL);
+        failed += failures[i];
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    net_server_get_stats(&after);
+
+    server_running = 0;
+    pthread_join(server, NULL);
+    close(server_fd);
+
+    unsigned long requests = after.requests - before.requests;
+    printf("{\"bench\":\"%s\",\"requests\":%lu,\"requests_per_s\":%.0f,"
+           "\"server_syscalls_per_request\":%.2f}\n",
+           name, requests, requests / (elapsed / 1e9),
+           requests ? (double)(after.syscalls - before.syscalls) / requests : 0.0);
+    return failed;
+}
+
+int main(void) {
+    long failed = 0;
+
+    printf("# %d clients x %d requests over loopback\n", CLIENTS, REQUESTS_PER_CLIENT);
+    failed += run("net_blocking");
+    use_uring = 1;
+    failed += run("net_uring");
+
+    if (failed) {
+        printf("# %ld requests failed\n", failed);
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,147 @@
+#include "bench.h"
+#include "../cmd_parse.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define ITERATIONS  1000000
+#define THREADS     4
+
+typedef struct {
+    long duration, channel;
+    float pwm[2];
+    int values;
+} pwm_args_t;
+
+// Representative PWM command lines, as sent by the controller
+static const char *const lines[] = {
+    "50",
+    "42.5 57.5",
+    "-c 3 75",
+    "-t 2 -c 1 12.5",
+    "-t 10 60 40",
+};
+#define NUM_LINES (int)(sizeof(lines) / sizeof(lines[0]))
+
+// ---------------------------
+// Previous PWM parsing: strtok on a copy, atoi/atof without checks
+// ---------------------------
+static int parse_strtok(const char *line, pwm_args_t *out) {
+    char copy[256];
+    char *tokens[10];
+    int count = 0;
+
+    strncpy(copy, line, sizeof(copy) - 1);
+    copy[sizeof(copy) - 1] = '\0';
+    for (char *t = strtok(copy, " \t\n"); t != NULL && count < 10; t = strtok(NULL, " \t\n")) {
+        tokens[count++] = t;
+    }
+
+    memset(out, 0, sizeof(*out));
+    for (int i = 0; i < count; i++) {
+        if (strcmp(tokens[i], "-t") == 0 && i + 1 < count) {
+            out->duration = atoi(tokens[++i]);
+        } else if (strcmp(tokens[i], "-c") == 0 && i + 1 < count) {
+            out->channel = atoi(tokens[++i]);
+        } else if (out->values < 2) {
+            out->pwm[out->values++] = atof(tokens[i]);
+        }
+    }
+    return out->values > 0 ? 0 : -1;
+}
+
+// ---------------------------
+// Same grammar on cmd_parse.h, as in execute_pwm_command()
+// ---------------------------
+static int parse_cmd(const char *line, pwm_args_t *out) {
+    cmd_parser_t p;
+    cmd_view_t tok;
+
+    memset(out, 0, sizeof(*out));
+    cmd_init(&p, line);
+    while (cmd_peek(&p, &tok)) {
+        int err;
+        if (cmd_match(&p, "-t")) {
+            err = cmd_long(&p, "duration", 0, 3600, &out->duration);
+        } else if (cmd_match(&p, "-c")) {
+            err = cmd_long(&p, "channel", 0, 15, &out->channel);
+        } else if (out->values < 2) {
+            err = cmd_float(&p, "duty cycle", 0.0f, 100.0f, &out->pwm[out->values++]);
+        } else {
+            err = cmd_end(&p);
+        }
+        if (err < 0) return -1;
+    }
+    return out->values > 0 ? 0 : -1;
+}
+
+static int same(const pwm_args_t *a, const pwm_args_t *b) {
+    return a->duration == b->duration && a->channel == b->channel && a->values == b->values &&
+           a->pwm[0] == b->pwm[0] && a->pwm[1] == b->pwm[1];
+}
+
+static void run(const char *name, int (*parse)(const char *, pwm_args_t *)) {
+    pwm_args_t args;
+    uint64_t start = bench_now_ns();
+
+    for (int i = 0; i < ITERATIONS; i++) {
+        parse(lines[i % NUM_LINES], &args);
+        BENCH_KEEP(args.pwm[0]);
+    }
+    bench_report(name, ITERATIONS, bench_now_ns() - start);
+}
+
+// Each thread checks its results against the single-threaded reference
+static pwm_args_t expected[NUM_LINES];
+
+static void *thread_main(void *arg) {
+    long *mismatches = arg;
+    pwm_args_t args;
+
+    for (int i = 0; i < ITERATIONS; i++) {
+        parse_cmd(lines[i % NUM_LINES], &args);
+        if (!same(&args, &expected[i % NUM_LINES])) (*mismatches)++;
+    }
+    return NULL;
+}
+
+int main(void) {
+    long mismatches[THREADS] = {0};
+    pthread_t threads[THREADS];
+    long failed = 0;
+    pwm_args_t legacy;
+
+    for (int i = 0; i < NUM_LINES; i++) {
+        if (parse_cmd(lines[i], &expected[i]) < 0 ||
+            parse_strtok(lines[i], &legacy) < 0 || !same(&expected[i], &legacy)) {
+            printf("# parsers disagree on '%s'\n", lines[i]);
+            failed++;
+        }
+    }
+
+    // Errors must be caught, not read as 0
+    pwm_args_t args;
+    if (parse_cmd("-c x 50", &args) == 0 || parse_cmd("-c 16 50", &args) == 0 ||
+        parse_cmd("50 60 70", &args) == 0 || parse_cmd("5O", &args) == 0) {
+        printf("# invalid line accepted\n");
+        failed++;
+    }
+
+    run("parse_strtok", parse_strtok);
+    run("parse_cmd", parse_cmd);
+
+    uint64_t start = bench_now_ns();
+    for (int t = 0; t < THREADS; t++) {
+        pthread_create(&threads[t], NULL, thread_main, &mismatches[t]);
+    }
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+        failed += mismatches[t];
+    }
+    bench_report("parse_cmd_4threads", (unsigned long)ITERATIONS * THREADS, bench_now_ns() - start);
+
+    if (failed) {
+        printf("# %ld parse failures\n", failed);
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,154 @@
+#include "bench.h"
+#include "../scheduler.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/resource.h>
+
+// Loop rates of the vehicle: IMU poll, a 100 Hz consumer, sonar
+#define NUM_LOOPS       3
+#define RUN_SECONDS     2
+
+static const uint32_t loop_hz[NUM_LOOPS] = { 1000, 100, 10 };
+
+typedef struct {
+    uint32_t period_us;
+    volatile unsigned long runs;
+    uint64_t latency_sum_ns;
+    uint64_t latency_max_ns;
+} loop_t;
+
+static loop_t loops[NUM_LOOPS];
+static volatile int loops_running;
+
+static long context_switches(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);  // Summed over all threads of the process
+    return ru.ru_nvcsw + ru.ru_nivcsw;
+}
+
+static void loop_work(loop_t *loop) {
+    loop->runs++;
+}
+
+// ---------------------------
+// Former design: one thread per loop sleeping to absolute deadlines
+// ---------------------------
+static void *loop_thread(void *arg) {
+    loop_t *loop = arg;
+    uint64_t deadline = bench_now_ns();
+
+    while (loops_running) {
+        deadline += (uint64_t)loop->period_us * 1000;
+        struct timespec ts = { deadline / 1000000000ULL, deadline % 1000000000ULL };
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+
+        uint64_t late = bench_now_ns() - deadline;
+        loop->latency_sum_ns += late;
+        if (late > loop->latency_max_ns) loop->latency_max_ns = late;
+        loop_work(loop);
+    }
+    return NULL;
+}
+
+static void sched_task(void *arg) {
+    loop_work(arg);
+}
+
+static void report(const char *name, long switches, double avg_us, double max_us) {
+    printf("{\"bench\":\"%s\",\"seconds\":%d,\"ctx_switches_per_s\":%.1f,"
+           "\"wakeup_latency_avg_us\":%.1f,\"wakeup_latency_max_us\":%.1f}\n",
+           name, RUN_SECONDS, (double)switches / RUN_SECONDS, avg_us, max_us);
+}
+
+// Every loop must have run close to its nominal rate
+static int check_runs(const char *name, const unsigned long *runs) {
+    int failures = 0;
+    for (int i = 0; i < NUM_LOOPS; i++) {
+        unsigned long expected = loop_hz[i] * RUN_SECONDS;
+        if (runs[i] < expected / 2 || runs[i] > expected + 2) {
+            printf("# %s: %u Hz loop ran %lu times, expected %lu\n",
+                   name, loop_hz[i], runs[i], expected);
+            failures++;
+        }
+    }
+    return failures;
+}
+
+static void reset_loops(void) {
+    for (int i = 0; i < NUM_LOOPS; i++) {
+        loops[i].period_us = 1000000 / loop_hz[i];
+        loops[i].runs = 0;
+        loops[i].latency_sum_ns = 0;
+        loops[i].latency_max_ns = 0;
+    }
+}
+
+int main(void) {
+    pthread_t threads[NUM_LOOPS];
+    unsigned long runs[NUM_LOOPS];
+    int failures = 0;
+
+    printf("# %d loops at 1000/100/10 Hz for %d s each\n", NUM_LOOPS, RUN_SECONDS);
+
+    // Per-thread design
+    reset_loops();
+    loops_running = 1;
+    long before = context_switches();
+    for (int i = 0; i < NUM_LOOPS; i++) {
+        pthread_create(&threads[i], NULL, loop_thread, &loops[i]);
+    }
+    sleep(RUN_SECONDS);
+    loops_running = 0;
+    for (int i = 0; i < NUM_LOOPS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    long switches = context_switches() - before;
+
+    uint64_t sum_ns = 0, max_ns = 0;
+    unsigned long total = 0;
+    for (int i = 0; i < NUM_LOOPS; i++) {
+        runs[i] = loops[i].runs;
+        total += runs[i];
+        sum_ns += loops[i].latency_sum_ns;
+        if (loops[i].latency_max_ns > max_ns) max_ns = loops[i].latency_max_ns;
+    }
+    report("sched_per_thread", switches, total ? sum_ns / 1000.0 / total : 0.0, max_ns / 1000.0);
+    failures += check_runs("per_thread", runs);
+
+    // Single scheduler thread
+    reset_loops();
+    if (sched_init() < 0) {
+        return 1;
+    }
+    before = context_switches();
+    for (int i = 0; i < NUM_LOOPS; i++) {
+        if (sched_add_periodic("loop", loops[i].period_us, SCHED_PRIO_NORMAL + i,
+                               sched_task, &loops[i]) < 0) {
+            return 1;
+        }
+    }
+    sched_start();
+    sleep(RUN_SECONDS);
+
+    sched_task_stats_t stats[NUM_LOOPS];
+    int count = sched_get_stats(stats, NUM_LOOPS);
+    sched_stop();
+    switches = context_switches() - before;
+
+    double sum_us = 0.0, max_us = 0.0;
+    unsigned long misses = 0;
+    total = 0;
+    for (int i = 0; i < count; i++) {
+        runs[i] = loops[i].runs;
+        total += stats[i].runs;
+        sum_us += stats[i].latency_avg_us * stats[i].runs;
+        if (stats[i].latency_max_us > max_us) max_us = stats[i].latency_max_us;
+        misses += stats[i].deadline_misses;
+    }
+    report("sched_single_thread", switches, total ? sum_us / total : 0.0, max_us);
+    printf("# scheduler deadline misses: %lu\n", misses);
+    failures += count != NUM_LOOPS || check_runs("scheduler", runs);
+
+    return failures ? 1 : 0;
+}
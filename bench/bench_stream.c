@@ -0,0 +1,157 @@
+#include "bench.h"
+#include "../imu_stream.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define SAMPLES     9520        // 10 s at the LSM9DS1's top rate
+#define ITERATIONS  200000UL
+
+// Scales of the default configuration: 2 g, 245 dps, 4 gauss
+static const float scale[3] = { 0.061f * 9.80665f / 1000.0f, 8.75f * 0.0174533f / 1000.0f, 0.014f };
+
+static imu_stream_sample_t samples[SAMPLES];
+static uint8_t stream[SAMPLES * sizeof(imu_stream_sample_t)];
+static size_t stream_len;
+
+static unsigned int seed = 42;
+
+static int noise(int amplitude) {
+    seed = seed * 1103515245u + 12345u;
+    return (int)((seed >> 16) % (2 * amplitude + 1)) - amplitude;
+}
+
+// ---------------------------
+// Synthetic drive: level car with motor vibration, a few turns and
+// sensor noise, sampled at ~952 Hz with scheduling jitter
+// ---------------------------
+static void make_samples(int vibration) {
+    uint64_t t = 1000000;
+    for (int i = 0; i < SAMPLES; i++) {
+        imu_stream_sample_t *s = &samples[i];
+        double time_s = i / 952.0;
+        double turn = sin(2 * M_PI * 0.2 * time_s);
+        double shake = vibration * sin(2 * M_PI * 37.0 * time_s);
+
+        t += 1050 + noise(15);
+        s->t_us = t;
+        memcpy(s->scale, scale, sizeof(scale));
+        s->raw[0] = (int16_t)(shake + 400 * turn + noise(12));
+        s->raw[1] = (int16_t)(0.7 * shake + noise(12));
+        s->raw[2] = (int16_t)(16393 + 0.5 * shake + noise(12));
+        s->raw[3] = (int16_t)(0.3 * shake + noise(8));
+        s->raw[4] = (int16_t)(0.3 * shake + noise(8));
+        s->raw[5] = (int16_t)(2000 * turn + noise(8));
+        s->raw[6] = (int16_t)(1400 * cos(turn) + noise(3));
+        s->raw[7] = (int16_t)(1400 * sin(turn) + noise(3));
+        s->raw[8] = (int16_t)(-3000 + noise(3));
+        s->raw[9] = (int16_t)(340 + noise(1));
+    }
+}
+
+static size_t encode_all(void) {
+    imu_stream_encoder_t enc;
+    imu_stream_encoder_init(&enc, stream, sizeof(stream), IMU_STREAM_KEYFRAME_INTERVAL);
+    for (int i = 0; i < SAMPLES; i++) {
+        imu_stream_encode(&enc, &samples[i]);
+    }
+    return imu_stream_finish(&enc);
+}
+
+// Same text as "IMU history" pages
+static size_t json_size(void) {
+    char line[256];
+    size_t total = 0;
+    for (int i = 0; i < SAMPLES; i++) {
+        const imu_stream_sample_t *s = &samples[i];
+        total += snprintf(line, sizeof(line), ",[%llu,%.3f,%.3f,%.3f,%.4f,%.4f,%.4f,%.2f,%.2f,%.2f]",
+                          (unsigned long long)s->t_us,
+                          s->raw[0] * scale[0], s->raw[1] * scale[0], s->raw[2] * scale[0],
+                          s->raw[3] * scale[1], s->raw[4] * scale[1], s->raw[5] * scale[1],
+                          s->raw[6] * scale[2], s->raw[7] * scale[2], s->raw[8] * scale[2]);
+    }
+    return total;
+}
+
+// One sample per iteration
+static void encode_loop(void *arg, unsigned long iterations) {
+    imu_stream_encoder_t enc;
+    (void)arg;
+    for (unsigned long i = 0; i < iterations; i++) {
+        if (i % SAMPLES == 0) {
+            imu_stream_encoder_init(&enc, stream, sizeof(stream), IMU_STREAM_KEYFRAME_INTERVAL);
+        }
+        imu_stream_encode(&enc, &samples[i % SAMPLES]);
+    }
+    BENCH_KEEP(imu_stream_finish(&enc));
+}
+
+static int count_sample(const imu_stream_sample_t *s, void *ctx) {
+    (void)s;
+    (*(unsigned long *)ctx)++;
+    return 0;
+}
+
+static void decode_loop(void *arg, unsigned long iterations) {
+    unsigned long visited = 0;
+    (void)arg;
+    for (unsigned long i = 0; i < iterations; i += SAMPLES) {
+        imu_stream_decode(stream, stream_len, count_sample, &visited, NULL);
+    }
+    BENCH_KEEP(visited);
+}
+
+static int check_sample(const imu_stream_sample_t *s, void *ctx) {
+    int *next = ctx;
+    while (*next < SAMPLES && samples[*next].t_us < s->t_us) (*next)++;
+    if (*next >= SAMPLES || memcmp(&samples[*next], s, sizeof(*s)) != 0) {
+        return 1;
+    }
+    (*next)++;
+    return 0;
+}
+
+int main(void) {
+    static const struct { const char *name; int vibration; } sets[] = {
+        { "parked", 0 }, { "driving", 300 },
+    };
+    int failed = 0;
+
+    for (size_t d = 0; d < sizeof(sets) / sizeof(sets[0]); d++) {
+        char name[64];
+        make_samples(sets[d].vibration);
+        stream_len = encode_all();
+
+        // Round trip must give back every sample bit for bit
+        int next = 0;
+        long decoded = imu_stream_decode(stream, stream_len, check_sample, &next, NULL);
+        if (decoded != SAMPLES) {
+            fprintf(BENCH_OUT, "# %s: round trip failed after %ld samples\n", sets[d].name, decoded);
+            failed = 1;
+        }
+
+        // A damaged byte costs one block, the decoder resyncs on the next
+        imu_stream_decode_stats_t stats;
+        stream[stream_len / 2] ^= 0x5A;
+        next = 0;
+        decoded = imu_stream_decode(stream, stream_len, check_sample, &next, &stats);
+        stream[stream_len / 2] ^= 0x5A;
+        if (decoded < SAMPLES - IMU_STREAM_KEYFRAME_INTERVAL || stats.bad_blocks == 0) {
+            fprintf(BENCH_OUT, "# %s: resync failed, %ld samples decoded\n", sets[d].name, decoded);
+            failed = 1;
+        }
+
+        snprintf(name, sizeof(name), "stream_encode_%s", sets[d].name);
+        bench_run(name, encode_loop, NULL, ITERATIONS);
+        snprintf(name, sizeof(name), "stream_decode_%s", sets[d].name);
+        bench_run(name, decode_loop, NULL, ITERATIONS / SAMPLES * SAMPLES);
+
+        size_t raw = SAMPLES * 28;      // imu_history_sample_t
+        size_t json = json_size();
+        fprintf(BENCH_OUT, "# %s: %.2f bytes/sample, ratio %.2f vs 28-byte samples, %.1f vs JSON "
+                "(%.1f with base64)\n", sets[d].name, (double)stream_len / SAMPLES,
+                (double)raw / stream_len, (double)json / stream_len,
+                (double)json / (stream_len * 4.0 / 3.0));
+    }
+    return failed;
+}
@@ -0,0 +1,69 @@
+#include "bench.h"
+#include "../trace.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define ITERATIONS  2000000
+#define THREADS     4
+
+// ---------------------------
+// One span per iteration, as around set_pwm() or i2c_read_block()
+// ---------------------------
+static void span_loop(void *arg, unsigned long iterations) {
+    (void)arg;
+    for (unsigned long i = 0; i < iterations; i++) {
+        uint64_t t0 = trace_begin();
+        BENCH_KEEP(t0);
+        trace_end("bench", t0);
+    }
+}
+
+// Other threads record into their own rings meanwhile
+static volatile int contending;
+
+static void *span_thread(void *arg) {
+    while (contending) {
+        span_loop(arg, 1000);
+    }
+    return NULL;
+}
+
+int main(void) {
+    pthread_t threads[THREADS];
+    int failed = 0;
+
+    bench_run("trace_span", span_loop, NULL, ITERATIONS);
+
+    contending = 1;
+    for (int t = 0; t < THREADS - 1; t++) {
+        pthread_create(&threads[t], NULL, span_thread, NULL);
+    }
+    bench_run("trace_span_4threads", span_loop, NULL, ITERATIONS);
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < THREADS) {
+        // The threads take turns on the CPUs, so the run measures
+        // time-slicing rather than rings sharing cache lines
+        fprintf(BENCH_OUT, "# %ld CPU(s) online: trace_span_4threads needs %d cores to show "
+                "cache contention\n", cpus, THREADS);
+    }
+
+    // Dumping while the rings are being written must still give whole spans
+    uint64_t start = bench_now_ns();
+    int spans = trace_dump("/dev/null");
+    bench_report("trace_dump_4threads", 1, bench_now_ns() - start);
+    if (spans < TRACE_RING_EVENTS) {
+        fprintf(BENCH_OUT, "# dump returned %d spans\n", spans);
+        failed = 1;
+    }
+
+    contending = 0;
+    for (int t = 0; t < THREADS - 1; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    trace_set_enabled(0);
+    bench_run("trace_span_disabled", span_loop, NULL, ITERATIONS);
+    return failed;
+}
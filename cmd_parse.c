@@ -0,0 +1,249 @@
+#include "cmd_parse.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <math.h>
+
+static int is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static const char *skip_space(const char *s) {
+    while (is_space(*s)) s++;
+    return s;
+}
+
+static int column(const cmd_parser_t *p, cmd_view_t tok) {
+    return (int)(tok.ptr - p->line) + 1;
+}
+
+void cmd_init(cmd_parser_t *p, const char *line) {
+    p->line = line;
+    p->pos = line;
+    p->ahead.ptr = NULL;
+    p->error[0] = '\0';
+}
+
+// Option checks peek the same token several times; scan it once
+int cmd_peek(cmd_parser_t *p, cmd_view_t *tok) {
+    if (p->ahead.ptr == NULL) {
+        const char *start = skip_space(p->pos);
+        const char *end = start;
+
+        while (*end != '\0' && !is_space(*end)) end++;
+        p->ahead.ptr = start;
+        p->ahead.len = (size_t)(end - start);
+    }
+    *tok = p->ahead;
+    return tok->len > 0;
+}
+
+int cmd_next(cmd_parser_t *p, cmd_view_t *tok) {
+    int found = cmd_peek(p, tok);
+    p->pos = tok->ptr + tok->len;
+    p->ahead.ptr = NULL;
+    return found;
+}
+
+int cmd_done(cmd_parser_t *p) {
+    return *skip_space(p->pos) == '\0';
+}
+
+const char *cmd_rest(cmd_parser_t *p) {
+    return skip_space(p->pos);
+}
+
+int cmd_view_eq(cmd_view_t tok, const char *word) {
+    return strncmp(tok.ptr, word, tok.len) == 0 && word[tok.len] == '\0';
+}
+
+int cmd_match(cmd_parser_t *p, const char *word) {
+    cmd_view_t tok;
+
+    if (!cmd_peek(p, &tok) || !cmd_view_eq(tok, word)) {
+        return 0;
+    }
+    p->pos = tok.ptr + tok.len;
+    p->ahead.ptr = NULL;
+    return 1;
+}
+
+int cmd_fail(cmd_parser_t *p, const char *fmt, ...) {
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(p->error, sizeof(p->error), fmt, ap);
+    va_end(ap);
+    return -1;
+}
+
+// ---------------------------
+// Typed arguments. strtol/strtof stop at the whitespace or NUL that ends
+// the token, so numbers are read in place without a copy.
+// ---------------------------
+static int next_arg(cmd_parser_t *p, const char *name, cmd_view_t *tok) {
+    if (!cmd_next(p, tok)) {
+        return cmd_fail(p, "Missing %s at column %d", name, column(p, *tok));
+    }
+    return 0;
+}
+
+static int invalid(cmd_parser_t *p, const char *name, cmd_view_t tok) {
+    return cmd_fail(p, "Invalid %s '%.*s' at column %d",
+                    name, (int)tok.len, tok.ptr, column(p, tok));
+}
+
+int cmd_long(cmd_parser_t *p, const char *name, long min, long max, long *out) {
+    return cmd_long_unit(p, name, "", min, max, out);
+}
+
+int cmd_long_unit(cmd_parser_t *p, const char *name, const char *unit,
+                  long min, long max, long *out) {
+    cmd_view_t tok;
+    char *end;
+
+    if (next_arg(p, name, &tok) < 0) {
+        return -1;
+    }
+
+    errno = 0;
+    long value = strtol(tok.ptr, &end, 10);
+    size_t unit_len = strlen(unit);
+    if (unit_len > 0 && (size_t)(tok.ptr + tok.len - end) == unit_len &&
+        strncmp(end, unit, unit_len) == 0 && end != tok.ptr) {
+        end += unit_len;
+    }
+    if (end != tok.ptr + tok.len || errno == ERANGE) {
+        return invalid(p, name, tok);
+    }
+    if (value < min || value > max) {
+        return cmd_fail(p, "%s must be between %ld and %ld at column %d",
+                        name, min, max, column(p, tok));
+    }
+    *out = value;
+    return 0;
+}
+
+int cmd_u64(cmd_parser_t *p, const char *name, uint64_t *out) {
+    cmd_view_t tok;
+    char *end;
+
+    if (next_arg(p, name, &tok) < 0) {
+        return -1;
+    }
+    if (tok.ptr[0] == '-') {
+        return invalid(p, name, tok);
+    }
+
+    errno = 0;
+    unsigned long long value = strtoull(tok.ptr, &end, 10);
+    if (end != tok.ptr + tok.len || errno == ERANGE) {
+        return invalid(p, name, tok);
+    }
+    *out = value;
+    return 0;
+}
+
+int cmd_filename(cmd_parser_t *p, const char *name, char *out, size_t size) {
+    cmd_view_t tok;
+
+    if (next_arg(p, name, &tok) < 0) {
+        return -1;
+    }
+    if (tok.len >= size) {
+        return cmd_fail(p, "%s too long at column %d", name, column(p, tok));
+    }
+    if (tok.ptr[0] == '.' || memchr(tok.ptr, '/', tok.len) != NULL) {
+        return invalid(p, name, tok);
+    }
+    for (size_t i = 0; i + 1 < tok.len; i++) {
+        if (tok.ptr[i] == '.' && tok.ptr[i + 1] == '.') {
+            return invalid(p, name, tok);
+        }
+    }
+    memcpy(out, tok.ptr, tok.len);
+    out[tok.len] = '\0';
+    return 0;
+}
+
+// Plain "[-]ddd.ddd" with at most 15 digits: the digits are exact in a
+// double, so one division rounds like strtod. Anything else (exponents,
+// hex, inf) goes through strtof.
+static int parse_decimal(cmd_view_t tok, float *out) {
+    const char *s = tok.ptr;
+    const char *end = tok.ptr + tok.len;
+    int negative = 0, digits = 0;
+    double mantissa = 0.0, scale = 1.0;
+
+    if (s < end && (*s == '-' || *s == '+')) negative = *s++ == '-';
+    for (; s < end && *s >= '0' && *s <= '9'; s++, digits++) {
+        mantissa = mantissa * 10.0 + (*s - '0');
+    }
+    if (s < end && *s == '.') {
+        for (s++; s < end && *s >= '0' && *s <= '9'; s++, digits++) {
+            mantissa = mantissa * 10.0 + (*s - '0');
+            scale *= 10.0;
+        }
+    }
+    if (s != end || digits == 0 || digits > 15) {
+        return -1;
+    }
+    *out = (float)((negative ? -mantissa : mantissa) / scale);
+    return 0;
+}
+
+int cmd_float(cmd_parser_t *p, const char *name, float min, float max, float *out) {
+    cmd_view_t tok;
+    char *end;
+    float value;
+
+    if (next_arg(p, name, &tok) < 0) {
+        return -1;
+    }
+
+    if (parse_decimal(tok, &value) < 0) {
+        errno = 0;
+        value = strtof(tok.ptr, &end);
+        if (end != tok.ptr + tok.len || errno == ERANGE || !isfinite(value)) {
+            return invalid(p, name, tok);
+        }
+    }
+    if (value < min || value > max) {
+        return cmd_fail(p, "%s must be between %g and %g at column %d",
+                        name, min, max, column(p, tok));
+    }
+    *out = value;
+    return 0;
+}
+
+int cmd_keyword(cmd_parser_t *p, const char *name, const char *const *words, int count) {
+    cmd_view_t tok;
+
+    if (next_arg(p, name, &tok) < 0) {
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        if (cmd_view_eq(tok, words[i])) {
+            return i;
+        }
+    }
+    return cmd_fail(p, "Unknown %s '%.*s' at column %d",
+                    name, (int)tok.len, tok.ptr, column(p, tok));
+}
+
+int cmd_end(cmd_parser_t *p) {
+    cmd_view_t tok;
+
+    if (cmd_peek(p, &tok)) {
+        return cmd_fail(p, "Unexpected '%.*s' at column %d",
+                        (int)tok.len, tok.ptr, column(p, tok));
+    }
+    return 0;
+}
+
+int cmd_error(const cmd_parser_t *p, char *response, size_t response_size) {
+    snprintf(response, response_size, "ERROR: %s\n", p->error[0] ? p->error : "Invalid command");
+    return -1;
+}
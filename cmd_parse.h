@@ -0,0 +1,69 @@
+#ifndef CMD_PARSE_H
+#define CMD_PARSE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Configuration
+#define CMD_ERROR_SIZE 96
+
+// A token inside the command line (not NUL-terminated)
+typedef struct {
+    const char *ptr;
+    size_t len;
+} cmd_view_t;
+
+// Parser over one command line. The line is never modified or copied, so
+// several threads can each parse their own line with a stack parser.
+typedef struct {
+    const char *line;
+    const char *pos;
+    cmd_view_t ahead;             // Token at pos once peeked (ptr NULL: not yet)
+    char error[CMD_ERROR_SIZE];   // Set by the last failing call
+} cmd_parser_t;
+
+void cmd_init(cmd_parser_t *p, const char *line);
+
+// Next whitespace-separated token; 0 at end of line
+int cmd_next(cmd_parser_t *p, cmd_view_t *tok);
+int cmd_peek(cmd_parser_t *p, cmd_view_t *tok);
+
+// 1 if only whitespace remains
+int cmd_done(cmd_parser_t *p);
+
+// Remainder of the line after leading whitespace
+const char *cmd_rest(cmd_parser_t *p);
+
+// Consume the next token if it equals 'word'
+int cmd_match(cmd_parser_t *p, const char *word);
+int cmd_view_eq(cmd_view_t tok, const char *word);
+
+// Typed arguments: 0 on success, -1 with p->error set
+// ('name' is used in the error, e.g. "Invalid channel 'x' at column 4";
+// columns count from the start of the string given to cmd_init)
+int cmd_long(cmd_parser_t *p, const char *name, long min, long max, long *out);
+// Same as cmd_long with an optional 'unit' suffix, e.g. "8" or "8g"
+int cmd_long_unit(cmd_parser_t *p, const char *name, const char *unit,
+                  long min, long max, long *out);
+int cmd_u64(cmd_parser_t *p, const char *name, uint64_t *out);
+int cmd_float(cmd_parser_t *p, const char *name, float min, float max, float *out);
+
+// A bare file name copied into 'out' (NUL-terminated): no '/', no "..",
+// no leading '.', so a network client cannot reach outside the directory
+// the caller puts it in
+int cmd_filename(cmd_parser_t *p, const char *name, char *out, size_t size);
+
+// Index of the next token in 'words', or -1 with p->error set
+int cmd_keyword(cmd_parser_t *p, const char *name, const char *const *words, int count);
+
+// -1 with p->error set if anything but whitespace remains
+int cmd_end(cmd_parser_t *p);
+
+// Set p->error (printf-style) and return -1
+int cmd_fail(cmd_parser_t *p, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+// Write "ERROR: <p->error>\n" to the response; returns -1
+int cmd_error(const cmd_parser_t *p, char *response, size_t response_size);
+
+#endif // CMD_PARSE_H
@@ -0,0 +1,71 @@
+#ifndef FASTMATH_H
+#define FASTMATH_H
+
+#include <math.h>
+
+// Float approximations for the orientation math. Maximum absolute error
+// over the full input range, as measured (bench/bench_fastmath fails if a
+// kernel exceeds its bound):
+//   fast_atan2f  < 1.2e-5 rad  (0.0007 deg; 1.17e-5 measured)
+//   fast_asinf   < 7e-5 rad    (0.004 deg; 6.8e-5 measured)
+//   fast_sqrtf   hardware square root, correctly rounded
+// All of them stay well below the 0.05 deg budget of the attitude output.
+#define FASTMATH_ATAN2_MAX_ERROR  1.2e-5   // rad
+#define FASTMATH_ASIN_MAX_ERROR   7e-5     // rad
+
+#define FASTMATH_PI      3.14159265f
+#define FASTMATH_PI_2    1.57079633f
+
+// ---------------------------
+// atan(x) for x in [0, 1] (Abramowitz & Stegun 4.4.49)
+// ---------------------------
+static inline float fast_atan_unit(float x) {
+    float x2 = x * x;
+    return x * (0.9998660f + x2 * (-0.3302995f + x2 * (0.1801410f +
+               x2 * (-0.0851330f + x2 * 0.0208351f))));
+}
+
+// ---------------------------
+// atan2 by octant reduction; the conditionals compile to selects
+// ---------------------------
+static inline float fast_atan2f(float y, float x) {
+    float ax = fabsf(x);
+    float ay = fabsf(y);
+    float mx = fmaxf(ax, ay);
+    float mn = fminf(ax, ay);
+    float r = fast_atan_unit(mn / (mx + 1e-30f));
+
+    r = (ay > ax) ? FASTMATH_PI_2 - r : r;
+    r = (x < 0.0f) ? FASTMATH_PI - r : r;
+    return (y < 0.0f) ? -r : r;
+}
+
+// ---------------------------
+// Square root: single hardware instruction in float, no double promotion
+// ---------------------------
+static inline float fast_sqrtf(float x) {
+    return __builtin_sqrtf(x);
+}
+
+// ---------------------------
+// asin(x) for x in [-1, 1] (Abramowitz & Stegun 4.4.45)
+// ---------------------------
+static inline float fast_asinf(float x) {
+    float ax = fminf(fabsf(x), 1.0f);
+    float r = FASTMATH_PI_2 - fast_sqrtf(1.0f - ax) *
+              (1.5707288f + ax * (-0.2121144f + ax * (0.0742610f + ax * -0.0187293f)));
+    return (x < 0.0f) ? -r : r;
+}
+
+// Build-time selection (make FAST_MATH=0 for libm)
+#ifdef IMU_FAST_MATH
+#define imu_atan2f  fast_atan2f
+#define imu_asinf   fast_asinf
+#define imu_sqrtf   fast_sqrtf
+#else
+#define imu_atan2f  atan2f
+#define imu_asinf   asinf
+#define imu_sqrtf   sqrtf
+#endif
+
+#endif // FASTMATH_H
@@ -0,0 +1,143 @@
+#include "hal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/i2c-dev.h>
+
+// BCM2835 GPIO registers (Pi Zero 2W uses the Pi 2/3 base)
+#define BCM2835_PERI_BASE      0x3F000000
+#define GPIO_BASE_OFFSET       0x200000
+#define BLOCK_SIZE             (4*1024)
+
+#define GPFSEL0    0
+#define GPSET0     7
+#define GPCLR0     10
+#define GPLEV0     13
+
+// Static variables
+static const hal_backend_t *backend = &hal_hw_backend;
+static volatile unsigned int *gpio_map = NULL;
+
+// ---------------------------
+// Hardware backend: I2C through the i2c-dev driver
+// ---------------------------
+static int hw_i2c_open(const char *bus) {
+    return open(bus, O_RDWR | O_CLOEXEC);
+}
+
+static int hw_i2c_transfer(int fd, struct i2c_msg *msgs, int count) {
+    struct i2c_rdwr_ioctl_data data = { msgs, (uint32_t)count };
+    return ioctl(fd, I2C_RDWR, &data) < 0 ? -1 : 0;
+}
+
+static void hw_i2c_close(int fd) {
+    close(fd);
+}
+
+// ---------------------------
+// Hardware backend: GPIO registers mapped from /dev/mem
+// ---------------------------
+static int hw_gpio_open(void) {
+    int mem_fd = open("/dev/mem", O_RDWR | O_SYNC);
+    if (mem_fd < 0) {
+        fprintf(stderr, "[HAL] Error: Cannot open /dev/mem (need root)\n");
+        return -1;
+    }
+
+    void *gpio_mem = mmap(NULL, BLOCK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
+                          mem_fd, BCM2835_PERI_BASE + GPIO_BASE_OFFSET);
+    close(mem_fd);
+
+    if (gpio_mem == MAP_FAILED) {
+        fprintf(stderr, "[HAL] Error: mmap failed\n");
+        return -1;
+    }
+    gpio_map = (volatile unsigned int *)gpio_mem;
+    return 0;
+}
+
+static void hw_gpio_close(void) {
+    if (gpio_map) {
+        munmap((void *)gpio_map, BLOCK_SIZE);
+        gpio_map = NULL;
+    }
+}
+
+static void hw_gpio_set_output(int pin, int output) {
+    int reg = GPFSEL0 + pin / 10;
+    int shift = (pin % 10) * 3;
+    *(gpio_map + reg) &= ~(7 << shift);
+    if (output) {
+        *(gpio_map + reg) |= (1 << shift);
+    }
+}
+
+static void hw_gpio_write(int pin, int level) {
+    *(gpio_map + (level ? GPSET0 : GPCLR0)) = (1 << pin);
+}
+
+static int hw_gpio_read(int pin) {
+    return (*(gpio_map + GPLEV0) & (1 << pin)) ? 1 : 0;
+}
+
+const hal_backend_t hal_hw_backend = {
+    .name = "hardware",
+    .i2c_open = hw_i2c_open,
+    .i2c_transfer = hw_i2c_transfer,
+    .i2c_close = hw_i2c_close,
+    .gpio_open = hw_gpio_open,
+    .gpio_close = hw_gpio_close,
+    .gpio_set_output = hw_gpio_set_output,
+    .gpio_write = hw_gpio_write,
+    .gpio_read = hw_gpio_read,
+};
+
+// ---------------------------
+// Backend selection and dispatch
+// ---------------------------
+int hal_is_emulated(void) {
+    return backend == &hal_emu_backend;
+}
+
+const char *hal_backend_name(void) {
+    return backend->name;
+}
+
+void hal_select_backend(const hal_backend_t *selected) {
+    backend = selected;
+}
+
+int hal_i2c_open(const char *bus) {
+    return backend->i2c_open(bus);
+}
+
+int hal_i2c_transfer(int fd, struct i2c_msg *msgs, int count) {
+    return backend->i2c_transfer(fd, msgs, count);
+}
+
+void hal_i2c_close(int fd) {
+    backend->i2c_close(fd);
+}
+
+int hal_gpio_open(void) {
+    return backend->gpio_open();
+}
+
+void hal_gpio_close(void) {
+    backend->gpio_close();
+}
+
+void hal_gpio_set_output(int pin, int output) {
+    backend->gpio_set_output(pin, output);
+}
+
+void hal_gpio_write(int pin, int level) {
+    backend->gpio_write(pin, level);
+}
+
+int hal_gpio_read(int pin) {
+    return backend->gpio_read(pin);
+}
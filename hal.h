@@ -0,0 +1,61 @@
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdint.h>
+#include <linux/i2c.h>
+
+// Hardware access used by the drivers: the I2C adapter (i2c_bus.c) and the
+// GPIO bank (sonar.c). The default backend talks to /dev/i2c-* and
+// /dev/mem; the emulated one models the vehicle's chips in memory so the
+// server runs unmodified on a dev box.
+
+typedef struct {
+    const char *name;
+    int (*i2c_open)(const char *bus);
+    int (*i2c_transfer)(int fd, struct i2c_msg *msgs, int count);   // Like I2C_RDWR
+    void (*i2c_close)(int fd);
+    int (*gpio_open)(void);
+    void (*gpio_close)(void);
+    void (*gpio_set_output)(int pin, int output);
+    void (*gpio_write)(int pin, int level);
+    int (*gpio_read)(int pin);
+} hal_backend_t;
+
+// Emulated backend settings
+typedef struct {
+    uint32_t i2c_bus_hz;          // Bit rate used for the per-byte time
+    uint32_t i2c_txn_latency_us;  // Fixed cost per transfer (driver, start/stop)
+    uint32_t echo_delay_us;       // Sonar trigger to echo rising edge
+    float distance_cm;            // Obstacle distance seen by the sonar
+} hal_emu_config_t;
+
+// 100 kHz is the Pi's default I2C clock; the HC-SR05 sends its burst
+// for about 450 us before raising ECHO
+#define HAL_EMU_DEFAULTS { 100000, 50, 450, 100.0f }
+
+extern const hal_backend_t hal_hw_backend;
+extern const hal_backend_t hal_emu_backend;
+void hal_select_backend(const hal_backend_t *backend);
+
+// Select the emulated backend (before any device is opened); NULL config
+// uses HAL_EMU_DEFAULTS
+void hal_use_emulated(const hal_emu_config_t *config);
+int hal_is_emulated(void);
+const char *hal_backend_name(void);
+
+// Change the emulated obstacle distance at run time
+void hal_emu_set_distance(float distance_cm);
+
+// I2C adapter: 0 / -1 with errno set
+int hal_i2c_open(const char *bus);
+int hal_i2c_transfer(int fd, struct i2c_msg *msgs, int count);
+void hal_i2c_close(int fd);
+
+// GPIO bank (BCM numbering)
+int hal_gpio_open(void);
+void hal_gpio_close(void);
+void hal_gpio_set_output(int pin, int output);
+void hal_gpio_write(int pin, int level);
+int hal_gpio_read(int pin);
+
+#endif // HAL_H
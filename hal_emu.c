@@ -0,0 +1,461 @@
+#include "hal.h"
+#include "pwm.h"
+#include "lsm9ds1.h"
+#include "sonar.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+// ---------------------------
+// Register-level models of the vehicle's I2C chips and GPIO wiring.
+// Sensor outputs are a function of time (sample index at the configured
+// ODR) so repeated reads within one period return the same data, like
+// the real parts. Each transfer takes as long as it would on the bus.
+// ---------------------------
+
+#define EMU_I2C_FD       1000   // Fake adapter descriptor
+#define EMU_NUM_CHIPS    3
+#define EMU_FIFO_DEPTH   32
+
+// LSM9DS1 accel/gyro registers beyond those used by the driver
+#define XG_STATUS_REG_G    0x17
+#define XG_CTRL_REG9       0x23
+#define XG_STATUS_REG      0x27
+#define XG_FIFO_CTRL       0x2E
+#define XG_FIFO_SRC        0x2F
+#define XG_OUT_Z_H_XL      0x2D
+#define XG_SW_RESET        0x01
+#define XG_IF_ADD_INC      0x04
+#define XG_FIFO_EN         0x02
+
+// LIS3MDL
+#define MAG_STATUS_REG     0x27
+#define MAG_TEMP_OUT_L     0x2E
+#define MAG_SOFT_RST       0x04
+#define MAG_AUTO_INC       0x80   // MSB of the sub-address
+
+// PCA9685
+#define PCA_MODE1          0x00
+#define PCA_LED0_ON_L      0x06
+#define PCA_ALL_LED_ON_L   0xFA
+#define PCA_PRESCALE       0xFE
+#define PCA_MODE1_AI       0x20
+#define PCA_MODE1_SLEEP    0x10
+
+typedef enum { CHIP_PCA9685, CHIP_LSM9DS1_XG, CHIP_LIS3MDL } chip_type_t;
+
+typedef struct {
+    chip_type_t type;
+    uint8_t addr;
+    uint8_t regs[256];
+    uint8_t ptr;            // Register pointer set by the last write
+    int auto_inc;           // Pointer advances after each byte
+
+    // Sensor state
+    uint64_t sample;        // Index of the sample in the output registers
+    uint64_t read_sample;   // Last sample the host has read (data-ready bits)
+    uint64_t fifo_base_us;  // FIFO level is counted from here
+    int fifo_level;
+} emu_chip_t;
+
+// Static variables
+static pthread_mutex_t emu_mutex = PTHREAD_MUTEX_INITIALIZER;   // Chip and GPIO state
+static pthread_mutex_t bus_mutex = PTHREAD_MUTEX_INITIALIZER;   // One I2C transfer at a time, taken first
+static hal_emu_config_t emu_config = HAL_EMU_DEFAULTS;
+static emu_chip_t chips[EMU_NUM_CHIPS];
+static int i2c_open_count = 0;
+static uint64_t epoch_us = 0;
+
+static uint64_t gpio_levels = 0;
+static uint64_t gpio_outputs = 0;
+static uint64_t trigger_fall_us = 0;   // 0: no measurement pending
+
+static uint64_t get_time_microseconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+// Deterministic noise in [-amplitude, amplitude] for a sample and axis
+static float noise(uint64_t sample, int axis, float amplitude) {
+    uint64_t x = sample * 0x9E3779B97F4A7C15ULL + (uint64_t)axis * 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 31;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 29;
+    return ((float)(x & 0xFFFF) / 32768.0f - 1.0f) * amplitude;
+}
+
+static void put_s16(uint8_t *regs, uint8_t reg, float value) {
+    if (value > 32767.0f) value = 32767.0f;
+    if (value < -32768.0f) value = -32768.0f;
+    int16_t raw = (int16_t)value;
+    regs[reg] = (uint8_t)(raw & 0xFF);
+    regs[reg + 1] = (uint8_t)((raw >> 8) & 0xFF);
+}
+
+// ---------------------------
+// Power-on register values
+// ---------------------------
+static void reset_chip(emu_chip_t *chip) {
+    memset(chip->regs, 0, sizeof(chip->regs));
+    chip->ptr = 0;
+    chip->auto_inc = 0;
+    chip->sample = 0;
+    chip->read_sample = 0;
+    chip->fifo_base_us = get_time_microseconds();
+    chip->fifo_level = 0;
+
+    switch (chip->type) {
+    case CHIP_PCA9685:
+        chip->regs[PCA_MODE1] = 0x11;   // SLEEP | ALLCALL
+        chip->regs[0x01] = 0x04;        // MODE2: OUTDRV
+        chip->regs[0x05] = 0xE0;        // ALLCALLADR
+        for (int ch = 0; ch < 16; ch++) {
+            chip->regs[PCA_LED0_ON_L + 4 * ch + 3] = 0x10;  // Full off
+        }
+        chip->regs[PCA_PRESCALE] = 0x1E;
+        break;
+    case CHIP_LSM9DS1_XG:
+        chip->regs[LSM9DS1_REGISTER_WHO_AM_I_XG] = LSM9DS1_XG_ID;
+        chip->regs[LSM9DS1_REGISTER_CTRL_REG5_XL] = 0x38;
+        chip->regs[LSM9DS1_REGISTER_CTRL_REG8] = XG_IF_ADD_INC;
+        break;
+    case CHIP_LIS3MDL:
+        chip->regs[LIS3MDL_REGISTER_WHO_AM_I] = LIS3MDL_ID;
+        chip->regs[LIS3MDL_REGISTER_CTRL_REG1] = 0x10;
+        chip->regs[LIS3MDL_REGISTER_CTRL_REG3] = 0x03;   // Power-down
+        break;
+    }
+}
+
+// ---------------------------
+// LSM9DS1 accel/gyro: stationary and level, with sensor noise
+// ---------------------------
+static float xg_odr_hz(const emu_chip_t *chip) {
+    static const float odr[8] = { 0.0f, 14.9f, 59.5f, 119.0f, 238.0f, 476.0f, 952.0f, 0.0f };
+    return odr[chip->regs[LSM9DS1_REGISTER_CTRL_REG1_G] >> 5];
+}
+
+static void xg_update(emu_chip_t *chip, uint64_t now_us) {
+    static const float accel_g_lsb[4] = { 0.000061f, 0.000732f, 0.000122f, 0.000244f };
+    static const float gyro_dps_lsb[4] = { 0.00875f, 0.0175f, 0.0f, 0.07f };
+    uint8_t *r = chip->regs;
+    float odr = xg_odr_hz(chip);
+
+    if (odr <= 0.0f) {
+        return;  // Power-down: outputs hold their last value
+    }
+
+    uint64_t sample = (uint64_t)((now_us - epoch_us) * (double)odr / 1e6) + 1;
+    if (sample != chip->sample) {
+        float a_lsb = accel_g_lsb[(r[LSM9DS1_REGISTER_CTRL_REG6_XL] >> 3) & 3];
+        float g_lsb = gyro_dps_lsb[(r[LSM9DS1_REGISTER_CTRL_REG1_G] >> 3) & 3];
+        if (g_lsb == 0.0f) g_lsb = gyro_dps_lsb[0];
+
+        put_s16(r, LSM9DS1_REGISTER_OUT_X_L_XL, noise(sample, 0, 0.004f) / a_lsb);
+        put_s16(r, LSM9DS1_REGISTER_OUT_X_L_XL + 2, noise(sample, 1, 0.004f) / a_lsb);
+        put_s16(r, LSM9DS1_REGISTER_OUT_X_L_XL + 4, (1.0f + noise(sample, 2, 0.004f)) / a_lsb);
+        put_s16(r, LSM9DS1_REGISTER_OUT_X_L_G, noise(sample, 3, 0.2f) / g_lsb);
+        put_s16(r, LSM9DS1_REGISTER_OUT_X_L_G + 2, noise(sample, 4, 0.2f) / g_lsb);
+        put_s16(r, LSM9DS1_REGISTER_OUT_X_L_G + 4, noise(sample, 5, 0.2f) / g_lsb);
+        put_s16(r, LSM9DS1_REGISTER_TEMP_OUT_L, noise(sample, 6, 0.5f) * 16.0f);  // 25 C
+        chip->sample = sample;
+    }
+
+    // Data-ready bits (XLDA | GDA | TDA) until the host reads the sample
+    uint8_t status = chip->sample != chip->read_sample ? 0x07 : 0x00;
+
+    // FIFO fills at the ODR while enabled, up to its depth
+    if ((r[XG_CTRL_REG9] & XG_FIFO_EN) && (r[XG_FIFO_CTRL] >> 5) != 0) {
+        int produced = (int)((now_us - chip->fifo_base_us) * (double)odr / 1e6);
+        if (produced > 0) {
+            chip->fifo_level += produced;
+            chip->fifo_base_us += (uint64_t)(produced * 1e6 / odr);
+        }
+        int overrun = chip->fifo_level > EMU_FIFO_DEPTH;
+        if (overrun) chip->fifo_level = EMU_FIFO_DEPTH;
+        int threshold = r[XG_FIFO_CTRL] & 0x1F;
+        r[XG_FIFO_SRC] = (uint8_t)(chip->fifo_level |
+                                   (overrun ? 0x40 : 0) |
+                                   (chip->fifo_level >= threshold ? 0x80 : 0));
+    } else {
+        chip->fifo_level = 0;
+        chip->fifo_base_us = now_us;
+        r[XG_FIFO_SRC] = 0;
+    }
+
+    r[XG_STATUS_REG_G] = status;
+    r[XG_STATUS_REG] = status;
+}
+
+// ---------------------------
+// LIS3MDL: a fixed Earth field, continuous or single conversion
+// ---------------------------
+static void mag_update(emu_chip_t *chip, uint64_t now_us) {
+    static const float odr_hz[8] = { 0.625f, 1.25f, 2.5f, 5.0f, 10.0f, 20.0f, 40.0f, 80.0f };
+    static const float lsb_gauss[4] = { 6842.0f, 3421.0f, 2281.0f, 1711.0f };
+    uint8_t *r = chip->regs;
+    int mode = r[LIS3MDL_REGISTER_CTRL_REG3] & 0x03;
+
+    if (mode >= 2) {
+        return;  // Power-down
+    }
+
+    float odr = odr_hz[(r[LIS3MDL_REGISTER_CTRL_REG1] >> 2) & 7];
+    uint64_t sample = (uint64_t)((now_us - epoch_us) * (double)odr / 1e6) + 1;
+    if (sample != chip->sample) {
+        float lsb = lsb_gauss[(r[LIS3MDL_REGISTER_CTRL_REG2] >> 5) & 3];
+        put_s16(r, LIS3MDL_REGISTER_OUT_X_L, (0.20f + noise(sample, 0, 0.002f)) * lsb);
+        put_s16(r, LIS3MDL_REGISTER_OUT_X_L + 2, (0.02f + noise(sample, 1, 0.002f)) * lsb);
+        put_s16(r, LIS3MDL_REGISTER_OUT_X_L + 4, (-0.42f + noise(sample, 2, 0.002f)) * lsb);
+        put_s16(r, MAG_TEMP_OUT_L, noise(sample, 3, 0.5f) * 8.0f);
+        chip->sample = sample;
+        if (mode == 1) {
+            r[LIS3MDL_REGISTER_CTRL_REG3] |= 0x03;  // Single conversion done
+        }
+    }
+    r[MAG_STATUS_REG] = chip->sample != chip->read_sample ? 0x0F : 0x00;
+}
+
+// ---------------------------
+// Register access
+// ---------------------------
+static void select_register(emu_chip_t *chip, uint8_t sub) {
+    switch (chip->type) {
+    case CHIP_PCA9685:
+        chip->ptr = sub;
+        chip->auto_inc = (chip->regs[PCA_MODE1] & PCA_MODE1_AI) != 0;
+        break;
+    case CHIP_LSM9DS1_XG:
+        chip->ptr = sub & 0x7F;
+        chip->auto_inc = (chip->regs[LSM9DS1_REGISTER_CTRL_REG8] & XG_IF_ADD_INC) != 0;
+        break;
+    case CHIP_LIS3MDL:
+        chip->ptr = sub & 0x3F;
+        chip->auto_inc = (sub & MAG_AUTO_INC) != 0;
+        break;
+    }
+}
+
+static void write_register_value(emu_chip_t *chip, uint8_t reg, uint8_t value) {
+    switch (chip->type) {
+    case CHIP_PCA9685:
+        if (reg == PCA_PRESCALE && !(chip->regs[PCA_MODE1] & PCA_MODE1_SLEEP)) {
+            return;  // Only writable in sleep mode
+        }
+        if (reg >= PCA_ALL_LED_ON_L && reg < PCA_PRESCALE) {
+            for (int ch = 0; ch < 16; ch++) {
+                chip->regs[PCA_LED0_ON_L + 4 * ch + (reg - PCA_ALL_LED_ON_L)] = value;
+            }
+            return;
+        }
+        chip->regs[reg] = value;
+        break;
+    case CHIP_LSM9DS1_XG:
+        if (reg == LSM9DS1_REGISTER_WHO_AM_I_XG) return;
+        if (reg == LSM9DS1_REGISTER_CTRL_REG8 && (value & XG_SW_RESET)) {
+            reset_chip(chip);
+            chip->regs[reg] = value & ~XG_SW_RESET;
+            return;
+        }
+        chip->regs[reg] = value;
+        break;
+    case CHIP_LIS3MDL:
+        if (reg == LIS3MDL_REGISTER_WHO_AM_I) return;
+        if (reg == LIS3MDL_REGISTER_CTRL_REG2 && (value & MAG_SOFT_RST)) {
+            reset_chip(chip);
+            return;
+        }
+        chip->regs[reg] = value;
+        break;
+    }
+}
+
+static void read_registers(emu_chip_t *chip, uint8_t *buf, int len, uint64_t now_us) {
+    if (chip->type == CHIP_LSM9DS1_XG) xg_update(chip, now_us);
+    if (chip->type == CHIP_LIS3MDL) mag_update(chip, now_us);
+
+    for (int i = 0; i < len; i++) {
+        uint8_t reg = chip->ptr;
+        buf[i] = chip->regs[reg];
+
+        // Reading the last output byte consumes the sample (and a FIFO slot)
+        if (chip->type == CHIP_LSM9DS1_XG && reg == XG_OUT_Z_H_XL) {
+            chip->read_sample = chip->sample;
+            if (chip->fifo_level > 0) chip->fifo_level--;
+        }
+        if (chip->type == CHIP_LIS3MDL && reg == LIS3MDL_REGISTER_OUT_X_L + 5) {
+            chip->read_sample = chip->sample;
+        }
+        if (chip->auto_inc) chip->ptr++;
+    }
+}
+
+static emu_chip_t *find_chip(uint16_t addr) {
+    for (int i = 0; i < EMU_NUM_CHIPS; i++) {
+        if (chips[i].addr == addr) return &chips[i];
+    }
+    return NULL;
+}
+
+// ---------------------------
+// I2C adapter
+// ---------------------------
+static int emu_i2c_open(const char *bus) {
+    (void)bus;
+    pthread_mutex_lock(&emu_mutex);
+    if (i2c_open_count++ == 0) {
+        static const struct { chip_type_t type; uint8_t addr; } wiring[EMU_NUM_CHIPS] = {
+            { CHIP_PCA9685, PCA9685_ADDR },
+            { CHIP_LSM9DS1_XG, LSM9DS1_ADDRESS_ACCELGYRO },
+            { CHIP_LIS3MDL, LSM9DS1_ADDRESS_MAG },
+        };
+        epoch_us = get_time_microseconds();
+        for (int i = 0; i < EMU_NUM_CHIPS; i++) {
+            chips[i].type = wiring[i].type;
+            chips[i].addr = wiring[i].addr;
+            reset_chip(&chips[i]);
+        }
+    }
+    pthread_mutex_unlock(&emu_mutex);
+    return EMU_I2C_FD;
+}
+
+static int emu_i2c_transfer(int fd, struct i2c_msg *msgs, int count) {
+    if (fd != EMU_I2C_FD) {
+        errno = EBADF;
+        return -1;
+    }
+
+    // Like i2c-bcm2835: a read is only accepted as the last message
+    for (int i = 0; i < count - 1; i++) {
+        if (msgs[i].flags & I2C_M_RD) {
+            errno = EOPNOTSUPP;
+            return -1;
+        }
+    }
+
+    // The bus is busy for the whole transfer: fixed cost plus 9 bits per
+    // byte (address byte and data, each with its ACK). Only the bus lock is
+    // held while waiting it out, so GPIO (the sonar) does not queue behind it.
+    pthread_mutex_lock(&bus_mutex);
+    pthread_mutex_lock(&emu_mutex);
+    uint64_t start = get_time_microseconds();
+    uint64_t bits = 0;
+    int result = 0;
+
+    for (int i = 0; i < count; i++) {
+        emu_chip_t *chip = find_chip(msgs[i].addr);
+        bits += 9 * (1 + (uint64_t)msgs[i].len) + 1;
+        if (chip == NULL) {
+            errno = ENXIO;  // No ACK from the address
+            result = -1;
+            break;
+        }
+
+        if (msgs[i].flags & I2C_M_RD) {
+            read_registers(chip, msgs[i].buf, msgs[i].len, start);
+        } else if (msgs[i].len > 0) {
+            select_register(chip, msgs[i].buf[0]);
+            for (int b = 1; b < msgs[i].len; b++) {
+                write_register_value(chip, chip->ptr, msgs[i].buf[b]);
+                if (chip->auto_inc) chip->ptr++;
+            }
+        }
+    }
+
+    uint64_t done = start + emu_config.i2c_txn_latency_us +
+                    bits * 1000000ULL / (emu_config.i2c_bus_hz ? emu_config.i2c_bus_hz : 100000);
+    pthread_mutex_unlock(&emu_mutex);
+
+    struct timespec until = { (time_t)(done / 1000000), (long)(done % 1000000) * 1000 };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) == EINTR);
+
+    pthread_mutex_unlock(&bus_mutex);
+    return result;
+}
+
+static void emu_i2c_close(int fd) {
+    (void)fd;
+    pthread_mutex_lock(&emu_mutex);
+    if (i2c_open_count > 0) i2c_open_count--;
+    pthread_mutex_unlock(&emu_mutex);
+}
+
+// ---------------------------
+// GPIO bank: LEDs hold their level; the sonar echo follows the trigger
+// ---------------------------
+static int emu_gpio_open(void) {
+    pthread_mutex_lock(&emu_mutex);
+    gpio_levels = 0;
+    gpio_outputs = 0;
+    trigger_fall_us = 0;
+    pthread_mutex_unlock(&emu_mutex);
+    return 0;
+}
+
+static void emu_gpio_close(void) {
+}
+
+static void emu_gpio_set_output(int pin, int output) {
+    pthread_mutex_lock(&emu_mutex);
+    if (output) gpio_outputs |= 1ULL << pin;
+    else gpio_outputs &= ~(1ULL << pin);
+    pthread_mutex_unlock(&emu_mutex);
+}
+
+static void emu_gpio_write(int pin, int level) {
+    pthread_mutex_lock(&emu_mutex);
+    uint64_t bit = 1ULL << pin;
+    if (pin == SONAR_TRIG_PIN && (gpio_levels & bit) && !level) {
+        trigger_fall_us = get_time_microseconds();
+    }
+    if (level) gpio_levels |= bit;
+    else gpio_levels &= ~bit;
+    pthread_mutex_unlock(&emu_mutex);
+}
+
+static int emu_gpio_read(int pin) {
+    pthread_mutex_lock(&emu_mutex);
+    int level = (gpio_levels >> pin) & 1;
+
+    // ECHO is high for the round trip at 343 m/s (58.3 us per cm)
+    if (pin == SONAR_ECHO_PIN && trigger_fall_us != 0) {
+        uint64_t now = get_time_microseconds();
+        uint64_t rise = trigger_fall_us + emu_config.echo_delay_us;
+        uint64_t fall = rise + (uint64_t)(emu_config.distance_cm * 58.3f);
+        level = now >= rise && now < fall;
+    }
+    pthread_mutex_unlock(&emu_mutex);
+    return level;
+}
+
+const hal_backend_t hal_emu_backend = {
+    .name = "emulated",
+    .i2c_open = emu_i2c_open,
+    .i2c_transfer = emu_i2c_transfer,
+    .i2c_close = emu_i2c_close,
+    .gpio_open = emu_gpio_open,
+    .gpio_close = emu_gpio_close,
+    .gpio_set_output = emu_gpio_set_output,
+    .gpio_write = emu_gpio_write,
+    .gpio_read = emu_gpio_read,
+};
+
+void hal_use_emulated(const hal_emu_config_t *config) {
+    pthread_mutex_lock(&emu_mutex);
+    if (config) {
+        emu_config = *config;
+    }
+    pthread_mutex_unlock(&emu_mutex);
+    hal_select_backend(&hal_emu_backend);
+}
+
+void hal_emu_set_distance(float distance_cm) {
+    pthread_mutex_lock(&emu_mutex);
+    emu_config.distance_cm = distance_cm;
+    pthread_mutex_unlock(&emu_mutex);
+}
@@ -0,0 +1,369 @@
+#include "heading.h"
+#include "pwm.h"
+#include "cmd_parse.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <pthread.h>
+
+// Static variables
+static pthread_mutex_t heading_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int pwm_dev = -1;
+static int enabled = 0;
+
+static int channel = HEADING_DEFAULT_CHANNEL;
+static float center = HEADING_DEFAULT_CENTER;
+static float out_min = HEADING_DEFAULT_MIN;
+static float out_max = HEADING_DEFAULT_MAX;
+static float setpoint = 0.0f;
+static float kp = HEADING_DEFAULT_KP;
+static float ki = HEADING_DEFAULT_KI;
+static float kd = HEADING_DEFAULT_KD;
+
+// PID state
+static float integral = 0.0f;
+static float prev_yaw = 0.0f;
+static float last_error = 0.0f;
+static float last_output = HEADING_DEFAULT_CENTER;
+static long long last_update_us = 0;
+
+// Timing statistics
+static heading_stats_t stats;
+static double period_sum_us = 0.0;
+static double compute_sum_us = 0.0;
+static double write_sum_us = 0.0;
+
+static long long get_time_microseconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+// ---------------------------
+// Wrap an angle difference to [-180, 180) degrees
+// ---------------------------
+static float wrap_degrees(float angle) {
+    angle = fmodf(angle + 180.0f, 360.0f);
+    if (angle < 0.0f) angle += 360.0f;
+    return angle - 180.0f;
+}
+
+static void reset_pid(void) {
+    integral = 0.0f;
+    last_error = 0.0f;
+    last_output = center;
+    last_update_us = 0;
+}
+
+static void reset_stats(void) {
+    memset(&stats, 0, sizeof(stats));
+    period_sum_us = 0.0;
+    compute_sum_us = 0.0;
+    write_sum_us = 0.0;
+}
+
+static void record_sample(float value, float *min, float *max, float *avg,
+                          double *sum, unsigned long count) {
+    if (count == 1 || value < *min) *min = value;
+    if (count == 1 || value > *max) *max = value;
+    *sum += value;
+    *avg = (float)(*sum / count);
+}
+
+static void write_output(float duty) {
+    uint16_t off = (uint16_t)((duty / 100.0f) * 4095);
+    set_pwm(pwm_dev, channel, 0, off);
+}
+
+// ---------------------------
+// Initialize heading controller (disabled until "enable")
+// ---------------------------
+int init_heading_controller(int dev) {
+    if (dev < 0) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&heading_mutex);
+    pwm_dev = dev;
+    enabled = 0;
+    reset_pid();
+    reset_stats();
+    pthread_mutex_unlock(&heading_mutex);
+
+    set_imu_sample_callback(heading_controller_update);
+
+    printf("[HEADING] Controller ready on channel %d\n", channel);
+    return 0;
+}
+
+// ---------------------------
+// Close heading controller
+// ---------------------------
+void close_heading_controller(void) {
+    set_imu_sample_callback(NULL);
+
+    pthread_mutex_lock(&heading_mutex);
+    if (enabled && pwm_dev >= 0) {
+        write_output(center);
+    }
+    enabled = 0;
+    pwm_dev = -1;
+    pthread_mutex_unlock(&heading_mutex);
+
+    printf("[HEADING] Controller closed\n");
+}
+
+// ---------------------------
+// One PID iteration, run in the IMU read thread for each sample
+// ---------------------------
+void heading_controller_update(const imu_data_t *data) {
+    long long start = get_time_microseconds();
+
+    pthread_mutex_lock(&heading_mutex);
+
+    if (!enabled || pwm_dev < 0) {
+        pthread_mutex_unlock(&heading_mutex);
+        return;
+    }
+
+    float yaw = data->yaw;
+    float error = wrap_degrees(setpoint - yaw);
+
+    if (last_update_us == 0) {
+        // First sample after enable: no dt yet, only seed the state
+        prev_yaw = yaw;
+        last_update_us = start;
+        pthread_mutex_unlock(&heading_mutex);
+        return;
+    }
+
+    float dt = (start - last_update_us) / 1000000.0f;
+    if (dt <= 0.0f) {
+        pthread_mutex_unlock(&heading_mutex);
+        return;
+    }
+    last_update_us = start;
+
+    // Derivative on measurement avoids a kick when the setpoint changes
+    float derivative = -wrap_degrees(yaw - prev_yaw) / dt;
+    prev_yaw = yaw;
+
+    float output = center + kp * error + ki * (integral + error * dt) + kd * derivative;
+
+    // Anti-windup: only integrate while the output is not saturated
+    if (output > out_max) {
+        output = out_max;
+    } else if (output < out_min) {
+        output = out_min;
+    } else {
+        integral += error * dt;
+    }
+
+    last_error = error;
+    last_output = output;
+
+    long long computed = get_time_microseconds();
+    write_output(output);
+    long long written = get_time_microseconds();
+
+    unsigned long n = ++stats.iterations;
+    record_sample(dt * 1000000.0f, &stats.period_min_us, &stats.period_max_us,
+                  &stats.period_avg_us, &period_sum_us, n);
+    record_sample((float)(computed - start), &stats.compute_min_us, &stats.compute_max_us,
+                  &stats.compute_avg_us, &compute_sum_us, n);
+    record_sample((float)(written - computed), &stats.write_min_us, &stats.write_max_us,
+                  &stats.write_avg_us, &write_sum_us, n);
+
+    pthread_mutex_unlock(&heading_mutex);
+}
+
+// ---------------------------
+// Get loop statistics (thread-safe)
+// ---------------------------
+void get_heading_stats(heading_stats_t *out) {
+    pthread_mutex_lock(&heading_mutex);
+    memcpy(out, &stats, sizeof(heading_stats_t));
+    pthread_mutex_unlock(&heading_mutex);
+}
+
+// ---------------------------
+// Execute heading command and format response
+// Commands:
+//   "enable" / "disable"        - Start or stop the loop (disable recenters)
+//   "set <deg>"                 - Heading setpoint in degrees
+//   "gains <kp> <ki> <kd>"      - PID gains (% duty per degree)
+//   "limits <min%> <max%>"      - Output clamp in % duty
+//   "channel <ch> [center%]"    - Output channel and neutral duty
+//   "status"                    - Current state in JSON format
+//   "stats" / "stats reset"     - Loop period and compute time
+// ---------------------------
+int execute_heading_command(char *cmd_str, char *response, size_t response_size) {
+    static const char *const commands[] = {
+        "enable", "disable", "set", "gains", "limits", "channel", "status", "stats"
+    };
+    enum { CMD_ENABLE, CMD_DISABLE, CMD_SET, CMD_GAINS, CMD_LIMITS, CMD_CHANNEL,
+           CMD_STATUS, CMD_STATS };
+    cmd_parser_t p;
+    float a, b, c;
+    long ch;
+    int ret = 0;
+
+    if (cmd_str == NULL || response == NULL) {
+        return -1;
+    }
+
+    cmd_init(&p, cmd_str);
+    int cmd = cmd_done(&p) ? CMD_STATUS
+                           : cmd_keyword(&p, "HEADING command", commands,
+                                                     (int)(sizeof(commands) / sizeof(commands[0])));
+
+    pthread_mutex_lock(&heading_mutex);
+
+    switch (cmd) {
+    case CMD_ENABLE:
+        if (cmd_end(&p) < 0) {
+            ret = -1;
+        } else if (pwm_dev < 0) {
+            ret = cmd_fail(&p, "Heading controller not initialized");
+        } else {
+            reset_pid();
+            enabled = 1;
+            snprintf(response, response_size, "OK\n");
+        }
+        break;
+
+    case CMD_DISABLE:
+        if (cmd_end(&p) < 0) {
+            ret = -1;
+            break;
+        }
+        if (enabled) {
+            write_output(center);
+        }
+        enabled = 0;
+        reset_pid();
+        snprintf(response, response_size, "OK\n");
+        break;
+
+    case CMD_SET:
+        if (cmd_float(&p, "heading", -1e6f, 1e6f, &a) < 0 || cmd_end(&p) < 0) {
+            ret = -1;
+        } else {
+            setpoint = wrap_degrees(a);
+            snprintf(response, response_size, "OK\n");
+        }
+        break;
+
+    case CMD_GAINS:
+        if (cmd_float(&p, "kp", -1e6f, 1e6f, &a) < 0 ||
+            cmd_float(&p, "ki", -1e6f, 1e6f, &b) < 0 ||
+            cmd_float(&p, "kd", -1e6f, 1e6f, &c) < 0 || cmd_end(&p) < 0) {
+            ret = -1;
+        } else {
+            kp = a;
+            ki = b;
+            kd = c;
+            integral = 0.0f;
+            snprintf(response, response_size, "OK\n");
+        }
+        break;
+
+    case CMD_LIMITS:
+        if (cmd_float(&p, "min", 0.0f, 100.0f, &a) < 0 ||
+            cmd_float(&p, "max", 0.0f, 100.0f, &b) < 0 || cmd_end(&p) < 0) {
+            ret = -1;
+        } else if (a >= b) {
+            ret = cmd_fail(&p, "Limits must satisfy 0 <= min < max <= 100");
+        } else {
+            out_min = a;
+            out_max = b;
+            snprintf(response, response_size, "OK\n");
+        }
+        break;
+
+    case CMD_CHANNEL:
+        a = center;
+        if (cmd_long(&p, "channel", 0, 15, &ch) < 0 ||
+            (!cmd_done(&p) && cmd_float(&p, "center", 0.0f, 100.0f, &a) < 0) ||
+            cmd_end(&p) < 0) {
+            ret = -1;
+        } else if (enabled) {
+            ret = cmd_fail(&p, "Disable controller before changing channel");
+        } else {
+            channel = (int)ch;
+            center = a;
+            snprintf(response, response_size, "OK\n");
+        }
+        break;
+
+    case CMD_STATUS:
+        if (cmd_end(&p) < 0) {
+            ret = -1;
+            break;
+        }
+        snprintf(response, response_size,
+            "{\"enabled\":%s,\"channel\":%d,\"setpoint\":%.1f,"
+            "\"gains\":[%.4f,%.4f,%.4f],\"limits\":[%.2f,%.2f],\"center\":%.2f,"
+            "\"error\":%.2f,\"output\":%.2f}\n",
+            enabled ? "true" : "false", channel, setpoint,
+            kp, ki, kd, out_min, out_max, center,
+            last_error, last_output);
+        break;
+
+    case CMD_STATS:
+        if (cmd_match(&p, "reset")) {
+            if (cmd_end(&p) < 0) {
+                ret = -1;
+            } else {
+                reset_stats();
+                snprintf(response, response_size, "OK\n");
+            }
+            break;
+        }
+        if (cmd_end(&p) < 0) {
+            ret = -1;
+            break;
+        }
+        snprintf(response, response_size,
+            "{\"iterations\":%lu,"
+            "\"period_us\":{\"min\":%.1f,\"max\":%.1f,\"avg\":%.1f},"
+            "\"compute_us\":{\"min\":%.1f,\"max\":%.1f,\"avg\":%.1f},"
+            "\"write_us\":{\"min\":%.1f,\"max\":%.1f,\"avg\":%.1f}}\n",
+            stats.iterations,
+            stats.period_min_us, stats.period_max_us, stats.period_avg_us,
+            stats.compute_min_us, stats.compute_max_us, stats.compute_avg_us,
+            stats.write_min_us, stats.write_max_us, stats.write_avg_us);
+        break;
+
+    default:
+        ret = -1;
+        break;
+    }
+
+    pthread_mutex_unlock(&heading_mutex);
+
+    if (ret < 0) {
+        return cmd_error(&p, response, response_size);
+    }
+    return 0;
+}
+
+// ---------------------------
+// Registry hooks (started once PWM is ready)
+// ---------------------------
+static int heading_module_init(void) {
+    return init_heading_controller(pwm_module_dev());
+}
+
+const module_t heading_module = {
+    .name = "heading",
+    .prefix = "HEADING",
+    .usage = "HEADING enable | disable | set <deg> | gains <kp> <ki> <kd> | limits <min%> <max%> | status | stats",
+    .depends = "pwm",
+    .control = 1,
+    .init = heading_module_init,
+    .stop = close_heading_controller,
+    .command = execute_heading_command,
+};
@@ -0,0 +1,40 @@
+#ifndef HEADING_H
+#define HEADING_H
+
+#include <stddef.h>
+#include "imu.h"
+#include "module.h"
+
+// Configuration
+#define HEADING_DEFAULT_CHANNEL  1      // Steering servo
+#define HEADING_DEFAULT_CENTER   7.5f   // % duty, 1.5 ms at 50 Hz
+#define HEADING_DEFAULT_MIN      5.0f   // % duty, 1.0 ms at 50 Hz
+#define HEADING_DEFAULT_MAX      10.0f  // % duty, 2.0 ms at 50 Hz
+#define HEADING_DEFAULT_KP       0.05f  // % duty per degree
+#define HEADING_DEFAULT_KI       0.0f
+#define HEADING_DEFAULT_KD       0.0f
+
+// Loop timing statistics (microseconds)
+typedef struct {
+    unsigned long iterations;
+    float period_min_us, period_max_us, period_avg_us;
+    float compute_min_us, compute_max_us, compute_avg_us;
+    float write_min_us, write_max_us, write_avg_us;
+} heading_stats_t;
+
+// Heading Controller Functions
+int init_heading_controller(int pwm_dev);
+void close_heading_controller(void);
+
+// Called by the IMU read thread for every new sample
+void heading_controller_update(const imu_data_t *data);
+
+void get_heading_stats(heading_stats_t *stats);
+
+// Command execution
+int execute_heading_command(char *cmd_str, char *response, size_t response_size);
+
+// Registry descriptor (module.h)
+extern const module_t heading_module;
+
+#endif // HEADING_H
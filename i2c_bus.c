@@ -0,0 +1,447 @@
+#include "i2c_bus.h"
+#include "cmd_parse.h"
+#include "hal.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#define MAX_MSGS I2C_RDWR_IOCTL_MAX_MSGS
+
+typedef struct {
+    int active;
+    char name[I2C_BUS_NAME_LEN];
+    uint8_t addr;
+    int priority;
+
+    unsigned long transactions;
+    unsigned long long bytes;
+    unsigned long errors;
+    double queue_sum_us;
+    float queue_max_us;
+    double bus_us;
+} device_t;
+
+// A caller's transfer, queued on its own stack until done
+typedef struct request {
+    i2c_txn_t *txns;
+    int count;
+    int msgs;
+    int read;           // Ends with a read (only the last transaction may read)
+    int priority;
+    uint64_t submit_us;
+    int done;
+    int result;
+    struct request *next;
+} request_t;
+
+// Static variables
+static device_t devices[I2C_BUS_MAX_DEVICES];
+static pthread_mutex_t bus_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t bus_cond = PTHREAD_COND_INITIALIZER;
+static int bus_fd = -1;
+static char bus_path[64];
+static int attached = 0;
+static request_t *queue_head = NULL;   // Sorted by priority, FIFO within a class
+static int bus_busy = 0;               // A caller is executing the queue
+
+static uint64_t stats_since_us = 0;
+static double busy_us = 0.0;
+static unsigned long ioctls = 0;
+static unsigned long batched = 0;
+
+static uint64_t get_time_microseconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+// ---------------------------
+// Attach a device, opening the adapter on first use
+// ---------------------------
+int i2c_bus_attach(const char *bus, const char *name, uint8_t addr, int priority) {
+    pthread_mutex_lock(&bus_mutex);
+
+    if (bus_fd < 0) {
+        bus_fd = hal_i2c_open(bus);
+        if (bus_fd < 0) {
+            pthread_mutex_unlock(&bus_mutex);
+            perror("[I2C] Failed to open I2C device");
+            return -1;
+        }
+        snprintf(bus_path, sizeof(bus_path), "%s", bus);
+        stats_since_us = get_time_microseconds();
+    } else if (strcmp(bus, bus_path) != 0) {
+        pthread_mutex_unlock(&bus_mutex);
+        fprintf(stderr, "[I2C] Only one adapter supported (%s already open)\n", bus_path);
+        return -1;
+    }
+
+    int dev;
+    for (dev = 0; dev < I2C_BUS_MAX_DEVICES && devices[dev].active; dev++);
+    if (dev == I2C_BUS_MAX_DEVICES) {
+        pthread_mutex_unlock(&bus_mutex);
+        fprintf(stderr, "[I2C] No free device slot for '%s'\n", name);
+        return -1;
+    }
+
+    memset(&devices[dev], 0, sizeof(device_t));
+    snprintf(devices[dev].name, sizeof(devices[dev].name), "%s", name);
+    devices[dev].addr = addr;
+    devices[dev].priority = priority;
+    devices[dev].active = 1;
+    attached++;
+
+    pthread_mutex_unlock(&bus_mutex);
+    return dev;
+}
+
+// ---------------------------
+// Detach a device (caller must have no transfer in flight)
+// ---------------------------
+void i2c_bus_detach(int dev) {
+    if (dev < 0 || dev >= I2C_BUS_MAX_DEVICES) {
+        return;
+    }
+
+    pthread_mutex_lock(&bus_mutex);
+    if (devices[dev].active) {
+        devices[dev].active = 0;
+        if (--attached == 0 && bus_fd >= 0) {
+            hal_i2c_close(bus_fd);
+            bus_fd = -1;
+        }
+    }
+    pthread_mutex_unlock(&bus_mutex);
+}
+
+// ---------------------------
+// Insert a request behind every pending one of equal or higher priority
+// ---------------------------
+static void enqueue(request_t *req) {
+    request_t **p = &queue_head;
+    while (*p && (*p)->priority >= req->priority) {
+        p = &(*p)->next;
+    }
+    req->next = *p;
+    *p = req;
+}
+
+// ---------------------------
+// Take the head request plus following requests of the same class that
+// fit in one I2C_RDWR call. i2c-bcm2835 only accepts a read as the last
+// message, so the batch ends at the first request that reads.
+// ---------------------------
+static int pop_batch(request_t **batch) {
+    int n = 0;
+    int msgs = 0;
+    int priority = queue_head->priority;
+
+    while (queue_head && queue_head->priority == priority &&
+           msgs + queue_head->msgs <= MAX_MSGS) {
+        request_t *req = queue_head;
+        msgs += req->msgs;
+        batch[n++] = req;
+        queue_head = req->next;
+        if (req->read) {
+            break;
+        }
+    }
+    return n;
+}
+
+// ---------------------------
+// Run requests as one combined message list (called without the lock)
+// ---------------------------
+static int run_ioctl(request_t **batch, int n) {
+    struct i2c_msg msgs[MAX_MSGS];
+    uint8_t writes[MAX_MSGS][1 + I2C_BUS_MAX_WRITE];
+    int count = 0;
+
+    for (int r = 0; r < n; r++) {
+        for (int i = 0; i < batch[r]->count; i++) {
+            i2c_txn_t *t = &batch[r]->txns[i];
+            uint16_t addr = devices[t->dev].addr;
+
+            if (t->read) {
+                msgs[count].addr = addr;
+                msgs[count].flags = 0;
+                msgs[count].len = 1;
+                msgs[count].buf = &t->reg;
+                count++;
+                msgs[count].addr = addr;
+                msgs[count].flags = I2C_M_RD;
+                msgs[count].len = t->len;
+                msgs[count].buf = t->data;
+                count++;
+            } else {
+                writes[count][0] = t->reg;
+                memcpy(&writes[count][1], t->data, t->len);
+                msgs[count].addr = addr;
+                msgs[count].flags = 0;
+                msgs[count].len = t->len + 1;
+                msgs[count].buf = writes[count];
+                count++;
+            }
+        }
+    }
+
+    return hal_i2c_transfer(bus_fd, msgs, count);
+}
+
+// ---------------------------
+// Execute a batch; on failure retry each request alone so the error is
+// charged to the device that caused it. Returns 1 if several requests
+// went out in one ioctl.
+// ---------------------------
+static int execute_batch(request_t **batch, int n, unsigned long *ioctl_count) {
+    int result = run_ioctl(batch, n);
+    (*ioctl_count)++;
+
+    if (result == 0 || n == 1) {
+        if (result < 0) {
+            perror("[I2C] Transfer failed");
+        }
+        for (int r = 0; r < n; r++) {
+            batch[r]->result = result;
+        }
+        return n > 1;
+    }
+
+    for (int r = 0; r < n; r++) {
+        batch[r]->result = run_ioctl(&batch[r], 1);
+        (*ioctl_count)++;
+        if (batch[r]->result < 0) {
+            perror("[I2C] Transfer failed");
+        }
+    }
+    return 0;
+}
+
+// ---------------------------
+// Account one executed batch (called with the lock held)
+// ---------------------------
+static void record_batch(request_t **batch, int n, int merged, uint64_t start, uint64_t end) {
+    double elapsed = (double)(end - start);
+    double weight = 0.0;
+
+    for (int r = 0; r < n; r++) {
+        for (int i = 0; i < batch[r]->count; i++) {
+            weight += batch[r]->txns[i].len + 2;  // Address + register bytes
+        }
+    }
+
+    for (int r = 0; r < n; r++) {
+        float queued = start > batch[r]->submit_us ? (float)(start - batch[r]->submit_us) : 0.0f;
+
+        for (int i = 0; i < batch[r]->count; i++) {
+            const i2c_txn_t *t = &batch[r]->txns[i];
+            device_t *d = &devices[t->dev];
+
+            d->transactions++;
+            d->bytes += t->len;
+            if (batch[r]->result < 0) d->errors++;
+            d->queue_sum_us += queued;
+            if (queued > d->queue_max_us) d->queue_max_us = queued;
+            d->bus_us += elapsed * (t->len + 2) / weight;
+        }
+    }
+
+    busy_us += elapsed;
+    if (merged) {
+        for (int r = 0; r < n; r++) batched += batch[r]->count;
+    }
+}
+
+// ---------------------------
+// Submit transactions and wait for them. Whichever caller finds the bus
+// idle runs the queue, highest class first, until its own request is done,
+// then hands the bus to the next waiter.
+// ---------------------------
+int i2c_bus_transfer(i2c_txn_t *txns, int count) {
+    request_t req;
+    memset(&req, 0, sizeof(req));
+    req.txns = txns;
+    req.count = count;
+
+    pthread_mutex_lock(&bus_mutex);
+
+    for (int i = 0; i < count; i++) {
+        const i2c_txn_t *t = &txns[i];
+        if (t->dev < 0 || t->dev >= I2C_BUS_MAX_DEVICES || !devices[t->dev].active ||
+            t->len == 0 || (!t->read && t->len > I2C_BUS_MAX_WRITE) ||
+            (t->read && i != count - 1)) {
+            pthread_mutex_unlock(&bus_mutex);
+            return -1;
+        }
+        req.msgs += t->read ? 2 : 1;
+        req.read = t->read;
+        if (i == 0 || devices[t->dev].priority > req.priority) {
+            req.priority = devices[t->dev].priority;
+        }
+    }
+    if (count <= 0 || req.msgs > MAX_MSGS) {
+        pthread_mutex_unlock(&bus_mutex);
+        return -1;
+    }
+
+    req.submit_us = get_time_microseconds();
+    enqueue(&req);
+
+    while (!req.done) {
+        if (bus_busy) {
+            pthread_cond_wait(&bus_cond, &bus_mutex);
+            continue;
+        }
+
+        bus_busy = 1;
+        while (!req.done && queue_head) {
+            request_t *batch[MAX_MSGS];
+            unsigned long ioctl_count = 0;
+            int n = pop_batch(batch);
+
+            pthread_mutex_unlock(&bus_mutex);
+            uint64_t t0 = trace_begin();
+            uint64_t start = get_time_microseconds();
+            int merged = execute_batch(batch, n, &ioctl_count);
+            uint64_t end = get_time_microseconds();
+            trace_end("i2c_batch", t0);
+            pthread_mutex_lock(&bus_mutex);
+
+            record_batch(batch, n, merged, start, end);
+            ioctls += ioctl_count;
+            for (int r = 0; r < n; r++) {
+                batch[r]->done = 1;
+            }
+        }
+        bus_busy = 0;
+        pthread_cond_broadcast(&bus_cond);
+    }
+
+    pthread_mutex_unlock(&bus_mutex);
+    return req.result;
+}
+
+int i2c_bus_write_reg(int dev, uint8_t reg, uint8_t value) {
+    i2c_txn_t t = { dev, reg, 0, 1, &value };
+    return i2c_bus_transfer(&t, 1);
+}
+
+int i2c_bus_read_reg(int dev, uint8_t reg, uint8_t *value) {
+    i2c_txn_t t = { dev, reg, 1, 1, value };
+    return i2c_bus_transfer(&t, 1);
+}
+
+int i2c_bus_read_block(int dev, uint8_t reg, uint8_t *buffer, size_t len) {
+    i2c_txn_t t = { dev, reg, 1, (uint16_t)len, buffer };
+    return i2c_bus_transfer(&t, 1);
+}
+
+// ---------------------------
+// Copy bus and per-device statistics; returns the number of devices
+// ---------------------------
+int i2c_bus_get_stats(i2c_bus_stats_t *bus, i2c_device_stats_t *stats, int max_devices) {
+    int count = 0;
+
+    pthread_mutex_lock(&bus_mutex);
+    if (bus) {
+        bus->elapsed_us = bus_fd >= 0 ? (double)(get_time_microseconds() - stats_since_us) : 0.0;
+        bus->busy_us = busy_us;
+        bus->ioctls = ioctls;
+        bus->batched = batched;
+    }
+    for (int i = 0; i < I2C_BUS_MAX_DEVICES && count < max_devices; i++) {
+        const device_t *d = &devices[i];
+        if (!d->active) continue;
+
+        i2c_device_stats_t *s = &stats[count++];
+        memcpy(s->name, d->name, I2C_BUS_NAME_LEN);
+        s->addr = d->addr;
+        s->priority = d->priority;
+        s->transactions = d->transactions;
+        s->bytes = d->bytes;
+        s->errors = d->errors;
+        s->queue_avg_us = d->transactions ? (float)(d->queue_sum_us / d->transactions) : 0.0f;
+        s->queue_max_us = d->queue_max_us;
+        s->bus_us = d->bus_us;
+    }
+    pthread_mutex_unlock(&bus_mutex);
+
+    return count;
+}
+
+void i2c_bus_reset_stats(void) {
+    pthread_mutex_lock(&bus_mutex);
+    for (int i = 0; i < I2C_BUS_MAX_DEVICES; i++) {
+        device_t *d = &devices[i];
+        d->transactions = 0;
+        d->bytes = 0;
+        d->errors = 0;
+        d->queue_sum_us = 0.0;
+        d->queue_max_us = 0.0f;
+        d->bus_us = 0.0;
+    }
+    stats_since_us = get_time_microseconds();
+    busy_us = 0.0;
+    ioctls = 0;
+    batched = 0;
+    pthread_mutex_unlock(&bus_mutex);
+}
+
+// ---------------------------
+// Execute bus command
+// Commands:
+//   "stats" (or empty) - Bus occupancy and per-device counters
+//   "stats reset"      - Clear all counters
+// ---------------------------
+int execute_i2c_command(char *cmd_str, char *response, size_t response_size) {
+    i2c_bus_stats_t bus;
+    i2c_device_stats_t stats[I2C_BUS_MAX_DEVICES];
+    cmd_parser_t p;
+
+    if (cmd_str == NULL || response == NULL) {
+        return -1;
+    }
+
+    cmd_init(&p, cmd_str);
+    int reset = cmd_match(&p, "stats") && cmd_match(&p, "reset");
+    if (cmd_end(&p) < 0) {
+        return cmd_error(&p, response, response_size);
+    }
+    if (reset) {
+        i2c_bus_reset_stats();
+        snprintf(response, response_size, "OK\n");
+        return 0;
+    }
+
+    int count = i2c_bus_get_stats(&bus, stats, I2C_BUS_MAX_DEVICES);
+    size_t pos = snprintf(response, response_size,
+        "{\"occupancy\":%.4f,\"ioctls\":%lu,\"batched\":%lu,\"devices\":[",
+        bus.elapsed_us > 0.0 ? bus.busy_us / bus.elapsed_us : 0.0, bus.ioctls, bus.batched);
+
+    for (int i = 0; i < count && pos < response_size; i++) {
+        const i2c_device_stats_t *s = &stats[i];
+        pos += snprintf(response + pos, response_size - pos,
+            "%s{\"name\":\"%s\",\"addr\":\"0x%02X\",\"priority\":%d,\"transactions\":%lu,"
+            "\"bytes\":%llu,\"errors\":%lu,\"queue_us\":{\"avg\":%.1f,\"max\":%.1f},"
+            "\"occupancy\":%.4f}",
+            i ? "," : "", s->name, s->addr, s->priority, s->transactions,
+            s->bytes, s->errors, s->queue_avg_us, s->queue_max_us,
+            bus.elapsed_us > 0.0 ? s->bus_us / bus.elapsed_us : 0.0);
+    }
+    if (pos < response_size) {
+        snprintf(response + pos, response_size - pos, "]}\n");
+    }
+    return 0;
+}
+
+const module_t i2c_module = {
+    .name = "i2c",
+    .prefix = "I2C",
+    .usage = "I2C stats [reset]",
+    .command = execute_i2c_command,
+};
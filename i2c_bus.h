@@ -0,0 +1,68 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "module.h"
+
+// Configuration
+#define I2C_BUS_MAX_DEVICES   8
+#define I2C_BUS_NAME_LEN      16
+#define I2C_BUS_MAX_WRITE     32    // Data bytes per write transaction
+
+// Device priorities: pending transactions of a higher class go first
+#define I2C_PRIO_TELEMETRY    0     // Sensor reads
+#define I2C_PRIO_ACTUATOR     10    // Motor/servo writes
+
+// One register transaction. Reads use a repeated start after the register.
+typedef struct {
+    int dev;
+    uint8_t reg;
+    uint8_t read;       // 1 = read 'len' bytes, 0 = write 'len' bytes
+    uint16_t len;
+    uint8_t *data;
+} i2c_txn_t;
+
+// Per-device statistics (microseconds)
+typedef struct {
+    char name[I2C_BUS_NAME_LEN];
+    uint8_t addr;
+    int priority;
+    unsigned long transactions;
+    unsigned long long bytes;
+    unsigned long errors;
+    float queue_avg_us, queue_max_us;   // Submit to start on the bus
+    double bus_us;                       // Share of bus time used
+} i2c_device_stats_t;
+
+typedef struct {
+    double elapsed_us;      // Since open or last reset
+    double busy_us;         // Time spent in I2C_RDWR
+    unsigned long ioctls;
+    unsigned long batched;  // Transactions that shared an ioctl with another request
+} i2c_bus_stats_t;
+
+// Attach a device; the adapter is opened by the first attach and closed
+// with the last detach. Returns a device handle >= 0, or -1 on error.
+int i2c_bus_attach(const char *bus, const char *name, uint8_t addr, int priority);
+void i2c_bus_detach(int dev);
+
+// Run transactions back to back (all on the same bus); -1 if any failed.
+// Only the last one may be a read: i2c-bcm2835 rejects an I2C_RDWR list
+// with a read anywhere else, so requests are merged on that rule too.
+int i2c_bus_transfer(i2c_txn_t *txns, int count);
+
+int i2c_bus_write_reg(int dev, uint8_t reg, uint8_t value);
+int i2c_bus_read_reg(int dev, uint8_t reg, uint8_t *value);
+int i2c_bus_read_block(int dev, uint8_t reg, uint8_t *buffer, size_t len);
+
+int i2c_bus_get_stats(i2c_bus_stats_t *bus, i2c_device_stats_t *devices, int max_devices);
+void i2c_bus_reset_stats(void);
+
+// Command execution
+int execute_i2c_command(char *cmd_str, char *response, size_t response_size);
+
+// Registry descriptor (module.h), command-only
+extern const module_t i2c_module;
+
+#endif // I2C_BUS_H
@@ -1,40 +1,211 @@
 #include "imu.h"
 #include "lsm9ds1.h"
+#include "attitude.h"
+#include "imu_history.h"
+#include "scheduler.h"
+#include "cmd_parse.h"
+#include "recorder.h"
+#include "rt.h"
+#include "snapshot.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <math.h>
+#include <time.h>
 #include <pthread.h>
+#include <sys/prctl.h>
 
 // Static variables
 static lsm9ds1_t sensor;
 static pthread_mutex_t sensor_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t device_mutex = PTHREAD_MUTEX_INITIALIZER;  // I2C access + config
 static pthread_t sensor_thread;
 static volatile int thread_running = 0;
+static int sched_task_id = -1;  // Set when polled by the shared scheduler
 static imu_data_t current_data = {0};
+static volatile imu_sample_callback_t sample_callback = NULL;
+static attitude_t attitude;
+static int history_scale_id = -1;
+static volatile int replaying = 0;    // Samples come from replay.c
+static unsigned long samples = 0;     // Protected by sensor_mutex
+static volatile unsigned long overruns = 0;
+
+// Live configuration (protected by device_mutex)
+static lsm9ds1_config_t config = {
+    .odr = LSM9DS1_ACCELDATARATE_119HZ,
+    .accel_range = LSM9DS1_ACCELRANGE_2G,
+    .gyro_scale = LSM9DS1_GYROSCALE_245DPS,
+    .mag_gain = LSM9DS1_MAGGAIN_4GAUSS,
+    .mag_odr = LSM9DS1_MAGDATARATE_10HZ,
+};
+static int poll_rate_hz = IMU_UPDATE_RATE_HZ;
+static uint64_t settle_until_us = 0;  // Samples before this may predate a config change
+
+static uint64_t get_time_microseconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+// ---------------------------
+// Fuse the new sample into the attitude filter and update roll, pitch, yaw
+// ---------------------------
+static void calculate_orientation(imu_data_t *data, float dt) {
+    attitude_update(&attitude,
+                    data->gyro_x, data->gyro_y, data->gyro_z,
+                    data->accel_x, data->accel_y, data->accel_z,
+                    data->mag_x, data->mag_y, data->mag_z,
+                    dt);
+    attitude_get_euler(&attitude, &data->roll, &data->pitch, &data->yaw);
+}
 
 // ---------------------------
-// Calculate roll, pitch, yaw from sensor data
+// Publish a new measurement: attitude update, snapshot for readers,
+// on-board consumers and the recorder. 'in' holds the sensor fields and
+// the sample time; roll/pitch/yaw are computed here. A live sample that
+// lost the race with imu_replay_begin() is dropped: returns -1.
 // ---------------------------
-static void calculate_orientation(imu_data_t *data) {
-    // Roll (rotation around X axis)
-    data->roll = atan2(data->accel_y, 
-                       sqrt(data->accel_x * data->accel_x + 
-                            data->accel_z * data->accel_z));
+static int publish_sample(const imu_data_t *in, int live) {
+    imu_data_t sample;
+
+    pthread_mutex_lock(&sensor_mutex);
+    if (live && replaying) {
+        pthread_mutex_unlock(&sensor_mutex);
+        return -1;
+    }
+    
+    float dt = current_data.timestamp_us ?
+               (in->timestamp_us - current_data.timestamp_us) / 1000000.0f : 0.0f;
+    current_data.timestamp_us = in->timestamp_us;
+    
+    current_data.accel_x = in->accel_x;
+    current_data.accel_y = in->accel_y;
+    current_data.accel_z = in->accel_z;
+    
+    current_data.gyro_x = in->gyro_x;
+    current_data.gyro_y = in->gyro_y;
+    current_data.gyro_z = in->gyro_z;
+    
+    current_data.mag_x = in->mag_x;
+    current_data.mag_y = in->mag_y;
+    current_data.mag_z = in->mag_z;
+    
+    current_data.temp = in->temp;
+    
+    calculate_orientation(&current_data, dt);
+    sample = current_data;
+    samples++;
+    
+    pthread_mutex_unlock(&sensor_mutex);
+    
+    snapshot_publish_imu(&sample);
     
-    // Pitch (rotation around Y axis)
-    data->pitch = atan2(-data->accel_x,
-                        sqrt(data->accel_y * data->accel_y + 
-                             data->accel_z * data->accel_z));
+    // Run on-board consumers (e.g. heading controller) at the IMU rate
+    imu_sample_callback_t callback = sample_callback;
+    if (callback) {
+        callback(&sample);
+    }
+
+    if (recorder_is_active()) {
+        recorder_imu_t rec = {
+            .accel = { sample.accel_x, sample.accel_y, sample.accel_z },
+            .gyro = { sample.gyro_x, sample.gyro_y, sample.gyro_z },
+            .mag = { sample.mag_x, sample.mag_y, sample.mag_z },
+            .temp = sample.temp,
+            .roll = sample.roll, .pitch = sample.pitch, .yaw = sample.yaw,
+        };
+        // Replayed samples carry old timestamps; record them as of now
+        recorder_log(&rec.rec, REC_IMU, sizeof(rec), live ? sample.timestamp_us : 0);
+    }
+    return 0;
+}
+
+// ---------------------------
+// Read the due sensor groups once and publish a new sample.
+// Returns the current poll period in nanoseconds.
+// ---------------------------
+static long imu_poll_once(void) {
+    pthread_mutex_lock(&device_mutex);
+    uint64_t now = get_time_microseconds();
+    // Only the groups that are due are read; publish on new accel/gyro data.
+    // The device keeps being polled while a replay supplies the samples.
+    int ok = now >= settle_until_us &&
+             lsm9ds1_poll(&sensor, now) > 0 &&
+             sensor.groups[LSM9DS1_GROUP_XG].last_read_us == now &&
+             !replaying;
+    int scale_id = history_scale_id;
+    long period_ns = 1000000000L / poll_rate_hz;
+    pthread_mutex_unlock(&device_mutex);
     
-    // Yaw from magnetometer (simplified, without tilt compensation)
-    data->yaw = atan2(data->mag_y, data->mag_x);
+    if (ok) {
+        imu_data_t in = {
+            .accel_x = sensor.acceleration.x,
+            .accel_y = sensor.acceleration.y,
+            .accel_z = sensor.acceleration.z,
+            .gyro_x = sensor.gyro.x,
+            .gyro_y = sensor.gyro.y,
+            .gyro_z = sensor.gyro.z,
+            .mag_x = sensor.magnetic.x,
+            .mag_y = sensor.magnetic.y,
+            .mag_z = sensor.magnetic.z,
+            .temp = sensor.temperature,
+            .timestamp_us = now,
+        };
+        if (publish_sample(&in, 1) == 0) {
+            imu_history_push(now, scale_id, sensor.accel_raw, sensor.gyro_raw,
+                             sensor.mag_raw, sensor.temp_raw);
+        }
+    }
     
-    // Convert to degrees
-    data->roll *= 180.0 / M_PI;
-    data->pitch *= 180.0 / M_PI;
-    data->yaw *= 180.0 / M_PI;
+    return period_ns;
+}
+
+// ---------------------------
+// Replay source (replay.c): recorded samples replace the device's while
+// active, with their original timestamps
+// ---------------------------
+void imu_replay_begin(void) {
+    pthread_mutex_lock(&sensor_mutex);
+    replaying = 1;
+    // Same starting state on every run so results are repeatable
+    attitude_reset(&attitude);
+    current_data.timestamp_us = 0;
+    pthread_mutex_unlock(&sensor_mutex);
+    // History follows the replayed timeline from here
+    imu_history_restart();
+}
+
+// SI value back to the raw count at the current scale, as history keeps it
+static int16_t to_raw(float value, float scale) {
+    float raw = scale > 0.0f ? roundf(value / scale) : 0.0f;
+    return (int16_t)fmaxf(-32768.0f, fminf(32767.0f, raw));
+}
+
+void imu_replay_sample(const imu_data_t *sample) {
+    publish_sample(sample, 0);
+
+    pthread_mutex_lock(&device_mutex);
+    int scale_id = history_scale_id;
+    float k[3] = { sensor.accel_scale, sensor.gyro_scale, sensor.mag_scale };
+    pthread_mutex_unlock(&device_mutex);
+
+    int16_t accel[3] = { to_raw(sample->accel_x, k[0]), to_raw(sample->accel_y, k[0]),
+                         to_raw(sample->accel_z, k[0]) };
+    int16_t gyro[3] = { to_raw(sample->gyro_x, k[1]), to_raw(sample->gyro_y, k[1]),
+                        to_raw(sample->gyro_z, k[1]) };
+    int16_t mag[3] = { to_raw(sample->mag_x, k[2]), to_raw(sample->mag_y, k[2]),
+                       to_raw(sample->mag_z, k[2]) };
+    int16_t temp = to_raw(sample->temp - LSM9DS1_TEMP_OFFSET_C, 1.0f / LSM9DS1_TEMP_LSB_PER_C);
+    imu_history_push(sample->timestamp_us, scale_id, accel, gyro, mag, temp);
+}
+
+void imu_replay_end(void) {
+    pthread_mutex_lock(&sensor_mutex);
+    replaying = 0;
+    attitude_reset(&attitude);
+    current_data.timestamp_us = 0;
+    pthread_mutex_unlock(&sensor_mutex);
 }
 
 // ---------------------------
@@ -43,53 +214,63 @@ static void calculate_orientation(imu_data_t *data) {
 static void* imu_read_thread(void* arg) {
     (void)arg; // Unused
     
+    prctl(PR_SET_NAME, "imu");
+    rt_thread_setup(RT_ROLE_IMU);
     printf("[IMU] Read thread started\n");
     
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    
     while (thread_running) {
-        if (lsm9ds1_read(&sensor)) {
-            pthread_mutex_lock(&sensor_mutex);
-            
-            current_data.accel_x = sensor.acceleration.x;
-            current_data.accel_y = sensor.acceleration.y;
-            current_data.accel_z = sensor.acceleration.z;
-            
-            current_data.gyro_x = sensor.gyro.x;
-            current_data.gyro_y = sensor.gyro.y;
-            current_data.gyro_z = sensor.gyro.z;
-            
-            current_data.mag_x = sensor.magnetic.x;
-            current_data.mag_y = sensor.magnetic.y;
-            current_data.mag_z = sensor.magnetic.z;
-            
-            current_data.temp = sensor.temperature;
-            
-            calculate_orientation(&current_data);
-            
-            pthread_mutex_unlock(&sensor_mutex);
-        }
+        long period_ns = imu_poll_once();
         
-        usleep(1000000 / IMU_UPDATE_RATE_HZ);
+        // Absolute deadlines keep the rate exact regardless of read time
+        deadline.tv_nsec += period_ns;
+        while (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_nsec -= 1000000000L;
+            deadline.tv_sec++;
+        }
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        if (ts.tv_sec > deadline.tv_sec ||
+            (ts.tv_sec == deadline.tv_sec && ts.tv_nsec > deadline.tv_nsec)) {
+            deadline = ts;  // Overrun: restart the schedule from now
+            overruns++;
+        } else {
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+        }
     }
     
     printf("[IMU] Read thread stopped\n");
     return NULL;
 }
 
+// ---------------------------
+// Scheduler task: one poll per timer release
+// ---------------------------
+static void imu_sched_task(void *arg) {
+    (void)arg;
+    imu_poll_once();
+}
+
 // ---------------------------
 // Initialize IMU sensor
 // ---------------------------
 int init_imu_controller(void) {
     printf("[IMU] Initializing LSM9DS1...\n");
     
-    if (!lsm9ds1_init(&sensor, IMU_I2C_DEVICE)) {
+    if (!lsm9ds1_init(&sensor, IMU_I2C_DEVICE, &config)) {
         fprintf(stderr, "[IMU] Failed to initialize LSM9DS1\n");
         return -1;
     }
     
-    // Configure sensor
-    lsm9ds1_setup_accel(&sensor, LSM9DS1_ACCELRANGE_2G, LSM9DS1_ACCELDATARATE_119HZ);
-    lsm9ds1_setup_gyro(&sensor, LSM9DS1_GYROSCALE_245DPS);
-    lsm9ds1_setup_mag(&sensor, LSM9DS1_MAGGAIN_4GAUSS);
+    attitude_init(&attitude, ATTITUDE_FILTER_MADGWICK);
+    
+    // Keep a ring of raw samples for history and windowed statistics
+    if (imu_history_init() == 0) {
+        history_scale_id = imu_history_register_scale(
+            sensor.accel_scale, sensor.gyro_scale, sensor.mag_scale);
+    }
     
     printf("[IMU] LSM9DS1 initialized successfully\n");
     return 0;
@@ -101,6 +282,7 @@ int init_imu_controller(void) {
 void close_imu_controller(void) {
     stop_imu_thread();
     lsm9ds1_close(&sensor);
+    imu_history_close();
     printf("[IMU] Controller closed\n");
 }
 
@@ -108,7 +290,7 @@ void close_imu_controller(void) {
 // Start continuous reading thread
 // ---------------------------
 int start_imu_thread(void) {
-    if (thread_running) {
+    if (thread_running || sched_task_id >= 0) {
         fprintf(stderr, "[IMU] Thread already running\n");
         return -1;
     }
@@ -124,13 +306,34 @@ int start_imu_thread(void) {
 }
 
 // ---------------------------
-// Stop reading thread
+// Register with the shared scheduler instead of running a thread
+// ---------------------------
+int start_imu_task(void) {
+    if (thread_running || sched_task_id >= 0) {
+        fprintf(stderr, "[IMU] Already running\n");
+        return -1;
+    }
+    
+    pthread_mutex_lock(&device_mutex);
+    sched_task_id = sched_add_periodic("imu", 1000000 / poll_rate_hz, SCHED_PRIO_HIGH,
+                                       imu_sched_task, NULL);
+    pthread_mutex_unlock(&device_mutex);
+    
+    return sched_task_id >= 0 ? 0 : -1;
+}
+
+// ---------------------------
+// Stop reading thread (or scheduler task)
 // ---------------------------
 void stop_imu_thread(void) {
     if (thread_running) {
         thread_running = 0;
         pthread_join(sensor_thread, NULL);
     }
+    if (sched_task_id >= 0) {
+        sched_cancel(sched_task_id);
+        sched_task_id = -1;
+    }
 }
 
 // ---------------------------
@@ -142,29 +345,321 @@ void get_imu_data(imu_data_t *data) {
     pthread_mutex_unlock(&sensor_mutex);
 }
 
+void imu_get_counters(imu_counters_t *counters) {
+    pthread_mutex_lock(&sensor_mutex);
+    counters->samples = samples;
+    pthread_mutex_unlock(&sensor_mutex);
+    counters->overruns = overruns;
+
+    pthread_mutex_lock(&device_mutex);
+    counters->poll_rate_hz = poll_rate_hz;
+    pthread_mutex_unlock(&device_mutex);
+}
+
+// ---------------------------
+// Register per-sample callback
+// ---------------------------
+void set_imu_sample_callback(imu_sample_callback_t callback) {
+    sample_callback = callback;
+}
+
+// ---------------------------
+// Parse "config" values; each returns 0 on success
+// ---------------------------
+static int parse_odr(long hz, lsm9ds1_accel_datarate_t *odr) {
+    if (hz == 0) *odr = LSM9DS1_ACCELDATARATE_POWERDOWN;
+    else if (hz == 10 || hz == 15) *odr = LSM9DS1_ACCELDATARATE_10HZ;
+    else if (hz == 50 || hz == 60) *odr = LSM9DS1_ACCELDATARATE_50HZ;
+    else if (hz == 119) *odr = LSM9DS1_ACCELDATARATE_119HZ;
+    else if (hz == 238) *odr = LSM9DS1_ACCELDATARATE_238HZ;
+    else if (hz == 476) *odr = LSM9DS1_ACCELDATARATE_476HZ;
+    else if (hz == 952) *odr = LSM9DS1_ACCELDATARATE_952HZ;
+    else return -1;
+    return 0;
+}
+
+static int parse_range(long g, lsm9ds1_accel_range_t *range) {
+    if (g == 2) *range = LSM9DS1_ACCELRANGE_2G;
+    else if (g == 4) *range = LSM9DS1_ACCELRANGE_4G;
+    else if (g == 8) *range = LSM9DS1_ACCELRANGE_8G;
+    else if (g == 16) *range = LSM9DS1_ACCELRANGE_16G;
+    else return -1;
+    return 0;
+}
+
+static int parse_gyro(long dps, lsm9ds1_gyro_scale_t *scale) {
+    if (dps == 245) *scale = LSM9DS1_GYROSCALE_245DPS;
+    else if (dps == 500) *scale = LSM9DS1_GYROSCALE_500DPS;
+    else if (dps == 2000) *scale = LSM9DS1_GYROSCALE_2000DPS;
+    else return -1;
+    return 0;
+}
+
+static int parse_mag_odr(float hz, lsm9ds1_mag_datarate_t *odr) {
+    for (int code = 0; code < 8; code++) {
+        lsm9ds1_mag_datarate_t candidate = (lsm9ds1_mag_datarate_t)(code << 2);
+        if (fabsf(lsm9ds1_mag_odr_hz(candidate) - hz) < 0.01f) {
+            *odr = candidate;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int parse_mag(long gauss, lsm9ds1_mag_gain_t *gain) {
+    if (gauss == 4) *gain = LSM9DS1_MAGGAIN_4GAUSS;
+    else if (gauss == 8) *gain = LSM9DS1_MAGGAIN_8GAUSS;
+    else if (gauss == 12) *gain = LSM9DS1_MAGGAIN_12GAUSS;
+    else if (gauss == 16) *gain = LSM9DS1_MAGGAIN_16GAUSS;
+    else return -1;
+    return 0;
+}
+
+static void format_config(const lsm9ds1_config_t *cfg, int poll, uint32_t temp_period_us,
+                          int verified, char *response, size_t response_size) {
+    static const int range_g[4] = { 2, 16, 4, 8 };           // FS_XL bits 4:3
+    static const int gyro_dps[4] = { 245, 500, 0, 2000 };    // FS_G bits 4:3
+    static const int mag_gauss[4] = { 4, 8, 12, 16 };
+
+    snprintf(response, response_size,
+        "{\"odr_hz\":%.1f,\"range_g\":%d,\"gyro_dps\":%d,\"mag_gauss\":%d,"
+        "\"mag_odr_hz\":%.3f,\"temp_hz\":%.2f,\"poll_hz\":%d,\"verified\":%s}\n",
+        lsm9ds1_odr_hz(cfg->odr), range_g[(cfg->accel_range >> 3) & 3],
+        gyro_dps[(cfg->gyro_scale >> 3) & 3], mag_gauss[cfg->mag_gain & 3],
+        lsm9ds1_mag_odr_hz(cfg->mag_odr), 1000000.0f / temp_period_us,
+        poll, verified ? "true" : "false");
+}
+
+// ---------------------------
+// Live reconfiguration: "[odr <hz>] [range <2|4|8|16>g] [gyro <245|500|2000>]
+//                        [mag <4|8|12|16>] [magodr <0.625-80>] [temp <hz>] [poll <hz>]"
+// ---------------------------
+static int execute_config_command(const char *args, char *response, size_t response_size) {
+    static const char *const keys[] = { "odr", "range", "gyro", "mag", "magodr", "temp", "poll" };
+    enum { KEY_ODR, KEY_RANGE, KEY_GYRO, KEY_MAG, KEY_MAGODR, KEY_TEMP, KEY_POLL };
+    cmd_parser_t p;
+    int changed = 0;
+
+    pthread_mutex_lock(&device_mutex);
+    lsm9ds1_config_t requested = config;
+    int poll = poll_rate_hz;
+    uint32_t temp_period_us = sensor.groups[LSM9DS1_GROUP_TEMP].period_us;
+    pthread_mutex_unlock(&device_mutex);
+
+    cmd_init(&p, args);
+    while (!cmd_done(&p)) {
+        cmd_view_t value;
+        long n = 0;
+        float hz = 0.0f;
+        int err;
+
+        int key = cmd_keyword(&p, "IMU config key", keys, (int)(sizeof(keys) / sizeof(keys[0])));
+        if (key < 0) {
+            return cmd_error(&p, response, response_size);
+        }
+        cmd_peek(&p, &value);
+
+        switch (key) {
+        case KEY_ODR:
+            err = cmd_long(&p, keys[key], 0, 952, &n) < 0 ? -1 : parse_odr(n, &requested.odr);
+            break;
+        case KEY_RANGE:
+            err = cmd_long_unit(&p, keys[key], "g", 2, 16, &n) < 0 ? -1 : parse_range(n, &requested.accel_range);
+            break;
+        case KEY_GYRO:
+            err = cmd_long(&p, keys[key], 245, 2000, &n) < 0 ? -1 : parse_gyro(n, &requested.gyro_scale);
+            break;
+        case KEY_MAG:
+            err = cmd_long(&p, keys[key], 4, 16, &n) < 0 ? -1 : parse_mag(n, &requested.mag_gain);
+            break;
+        case KEY_MAGODR:
+            err = cmd_float(&p, keys[key], 0.0f, 80.0f, &hz) < 0 ? -1 : parse_mag_odr(hz, &requested.mag_odr);
+            break;
+        case KEY_TEMP:
+            err = cmd_float(&p, keys[key], 0.01f, 100.0f, &hz);
+            if (!err) temp_period_us = (uint32_t)(1000000.0f / hz);
+            break;
+        default:
+            err = cmd_long(&p, keys[key], 1, IMU_MAX_POLL_RATE_HZ, &n);
+            if (!err) poll = (int)n;
+            break;
+        }
+
+        if (err < 0) {
+            // In range but not a rate/scale the chip supports
+            if (p.error[0] == '\0') {
+                cmd_fail(&p, "Invalid value '%.*s' for '%s' at column %d", (int)value.len,
+                         value.ptr, keys[key], (int)(value.ptr - p.line) + 1);
+            }
+            return cmd_error(&p, response, response_size);
+        }
+        changed = 1;
+    }
+
+    pthread_mutex_lock(&device_mutex);
+
+    int verified = 1;
+    if (changed) {
+        verified = lsm9ds1_configure(&sensor, &requested);
+        
+        // Report what the chip actually holds, not what was requested
+        lsm9ds1_read_config(&sensor, &config);
+        history_scale_id = imu_history_register_scale(
+            sensor.accel_scale, sensor.gyro_scale, sensor.mag_scale);
+        poll_rate_hz = poll;
+        if (sched_task_id >= 0) {
+            sched_set_period(sched_task_id, 1000000 / poll);
+        }
+        lsm9ds1_set_group_period(&sensor, LSM9DS1_GROUP_TEMP, temp_period_us);
+        
+        // Output registers still hold old-range data for up to two periods
+        float odr = lsm9ds1_odr_hz(config.odr);
+        settle_until_us = get_time_microseconds() +
+                          (odr > 0.0f ? (uint64_t)(2000000.0f / odr) : 0);
+        
+        printf("[IMU] Reconfigured: ODR %.1f Hz, poll %d Hz\n", odr, poll_rate_hz);
+    }
+    format_config(&config, poll_rate_hz, sensor.groups[LSM9DS1_GROUP_TEMP].period_us,
+                  verified, response, response_size);
+
+    pthread_mutex_unlock(&device_mutex);
+    return verified ? 0 : -1;
+}
+
+// ---------------------------
+// Per-group acquisition rates: "" or "reset"
+// ---------------------------
+static int execute_rates_command(const char *args, char *response, size_t response_size) {
+    static const char *names[LSM9DS1_NUM_GROUPS] = { "xg", "mag", "temp" };
+    size_t pos = 0;
+    unsigned long long saved_total = 0;
+    cmd_parser_t p;
+
+    cmd_init(&p, args);
+    int reset = cmd_match(&p, "reset");
+    if (cmd_end(&p) < 0) {
+        return cmd_error(&p, response, response_size);
+    }
+
+    pthread_mutex_lock(&device_mutex);
+
+    if (reset) {
+        lsm9ds1_reset_group_stats(&sensor);
+        pthread_mutex_unlock(&device_mutex);
+        snprintf(response, response_size, "OK\n");
+        return 0;
+    }
+
+    uint64_t now = get_time_microseconds();
+    pos += snprintf(response + pos, response_size - pos, "{");
+    for (int g = 0; g < LSM9DS1_NUM_GROUPS && pos < response_size; g++) {
+        const lsm9ds1_group_state_t *st = &sensor.groups[g];
+        double span = (st->last_read_us - st->first_read_us) / 1000000.0;
+        saved_total += st->bytes_saved;
+        pos += snprintf(response + pos, response_size - pos,
+            "%s\"%s\":{\"period_us\":%u,\"reads\":%lu,\"skipped\":%lu,\"errors\":%lu,"
+            "\"achieved_hz\":%.2f,\"age_ms\":%.1f,\"bytes\":%llu,\"bytes_saved\":%llu}",
+            g ? "," : "", names[g], st->period_us, st->reads, st->skipped, st->errors,
+            (st->reads > 1 && span > 0) ? (st->reads - 1) / span : 0.0,
+            st->reads ? (now - st->last_read_us) / 1000.0 : 0.0,
+            st->bytes, st->bytes_saved);
+    }
+    if (pos < response_size) {
+        snprintf(response + pos, response_size - pos, ",\"bytes_saved\":%llu}\n", saved_total);
+    }
+
+    pthread_mutex_unlock(&device_mutex);
+    return 0;
+}
+
+// ---------------------------
+// Select attitude filter and gain: "[accel|complementary|madgwick] [gain]"
+// ---------------------------
+static int execute_filter_command(const char *args, char *response, size_t response_size) {
+    // Same order as attitude_filter_t
+    static const char *const names[] = { "accel", "complementary", "madgwick" };
+    cmd_parser_t p;
+    float gain = 0.0f;
+    int n = 0;
+    int filter = 0;
+
+    cmd_init(&p, args);
+    if (!cmd_done(&p)) {
+        filter = cmd_keyword(&p, "IMU filter", names, 3);
+        n = 1;
+        if (filter >= 0 && !cmd_done(&p)) {
+            n = cmd_float(&p, "filter gain", 0.0f, 100.0f, &gain) < 0 ? -1 : 2;
+        }
+        if (filter < 0 || n < 0 || cmd_end(&p) < 0) {
+            return cmd_error(&p, response, response_size);
+        }
+    }
+
+    pthread_mutex_lock(&sensor_mutex);
+
+    if (n >= 1) {
+        if ((attitude_filter_t)filter != attitude.filter) {
+            attitude.filter = (attitude_filter_t)filter;
+            attitude_reset(&attitude);
+        }
+        if (n == 2 && filter == ATTITUDE_FILTER_MADGWICK) attitude.beta = gain;
+        if (n == 2 && filter == ATTITUDE_FILTER_COMPLEMENTARY) attitude.kp = gain;
+    }
+
+    snprintf(response, response_size,
+        "{\"filter\":\"%s\",\"beta\":%.3f,\"kp\":%.3f}\n",
+        attitude_filter_name(attitude.filter), attitude.beta, attitude.kp);
+
+    pthread_mutex_unlock(&sensor_mutex);
+    return 0;
+}
+
 // ---------------------------
 // Execute IMU command and format response
 // Commands:
 //   "read" or "get" - Get current sensor data in JSON format
 //   "raw" - Get raw sensor values
 //   "orientation" - Get only roll, pitch, yaw
+//   "filter" - Get attitude filter settings
+//   "filter <accel|complementary|madgwick> [gain]" - Select attitude filter
+//   "history [last <n> | range <t0_us> <t1_us>] [packed]" - Buffered raw samples
+//   "stats [window_ms]" - Min/max/mean/RMS per axis over a sliding window
+//   "config [odr <hz>] [range <g>] [gyro <dps>] [mag <gauss>] [magodr <hz>]
+//           [temp <hz>] [poll <hz>]" - Reconfigure live, report read-back config
+//   "rates [reset]" - Achieved rate, freshness and I2C bytes saved per group
 // ---------------------------
 int execute_imu_command(char *cmd_str, char *response, size_t response_size) {
+    static const char *const commands[] = {
+        "read", "get", "raw", "orientation", "rates", "config", "history", "stats", "filter"
+    };
+    enum { CMD_READ, CMD_GET, CMD_RAW, CMD_ORIENTATION, CMD_RATES, CMD_CONFIG,
+           CMD_HISTORY, CMD_STATS, CMD_FILTER };
+    cmd_parser_t p;
+
     if (cmd_str == NULL || response == NULL) {
         return -1;
     }
     
-    // Remove trailing whitespace
-    char *end = cmd_str + strlen(cmd_str) - 1;
-    while (end > cmd_str && (*end == ' ' || *end == '\t' || *end == '\n')) {
-        *end = '\0';
-        end--;
+    cmd_init(&p, cmd_str);
+    int cmd = cmd_done(&p) ? CMD_READ : cmd_keyword(&p, "IMU command", commands,
+                                                     (int)(sizeof(commands) / sizeof(commands[0])));
+    
+    // Sub-commands parse the rest of the line themselves
+    switch (cmd) {
+    case CMD_RATES:   return execute_rates_command(cmd_rest(&p), response, response_size);
+    case CMD_CONFIG:  return execute_config_command(cmd_rest(&p), response, response_size);
+    case CMD_HISTORY: return execute_history_command(cmd_rest(&p), response, response_size);
+    case CMD_STATS:   return execute_stats_command(cmd_rest(&p), response, response_size);
+    case CMD_FILTER:  return execute_filter_command(cmd_rest(&p), response, response_size);
+    }
+    if (cmd < 0 || cmd_end(&p) < 0) {
+        return cmd_error(&p, response, response_size);
     }
     
     imu_data_t data;
     get_imu_data(&data);
     
-    if (strcmp(cmd_str, "read") == 0 || strcmp(cmd_str, "get") == 0 || strcmp(cmd_str, "") == 0) {
+    if (cmd == CMD_READ || cmd == CMD_GET) {
         // Full JSON response
         snprintf(response, response_size,
             "{\"accel\":[%.3f,%.3f,%.3f],"
@@ -178,7 +673,7 @@ int execute_imu_command(char *cmd_str, char *response, size_t response_size) {
             data.temp,
             data.roll, data.pitch, data.yaw);
     }
-    else if (strcmp(cmd_str, "raw") == 0) {
+    else if (cmd == CMD_RAW) {
         // Raw sensor values
         snprintf(response, response_size,
             "Accel: %.3f %.3f %.3f | Gyro: %.3f %.3f %.3f | Mag: %.3f %.3f %.3f | Temp: %.1f°C\n",
@@ -187,16 +682,32 @@ int execute_imu_command(char *cmd_str, char *response, size_t response_size) {
             data.mag_x, data.mag_y, data.mag_z,
             data.temp);
     }
-    else if (strcmp(cmd_str, "orientation") == 0) {
+    else {
         // Only orientation
         snprintf(response, response_size,
             "Roll: %.1f° | Pitch: %.1f° | Yaw: %.1f°\n",
             data.roll, data.pitch, data.yaw);
     }
-    else {
-        snprintf(response, response_size, "ERROR: Unknown IMU command '%s'\n", cmd_str);
-        return -1;
-    }
     
     return 0;
 }
+
+// ---------------------------
+// Registry hooks
+// ---------------------------
+static int imu_module_start(int use_sched) {
+    return use_sched ? start_imu_task() : start_imu_thread();
+}
+
+const module_t imu_module = {
+    .name = "imu",
+    .prefix = "IMU",
+    .usage = "IMU read | IMU raw | IMU orientation | IMU filter [accel|complementary|madgwick] [gain]\n"
+             "           IMU history [last <n> | range <t0_us> <t1_us>] [packed] | IMU stats [100|1000|10000]\n"
+             "           IMU config [odr <hz>] [range <g>] [gyro <dps>] [mag <gauss>] [magodr <hz>] [temp <hz>] [poll <hz>]\n"
+             "           IMU rates [reset]",
+    .init = init_imu_controller,
+    .start = imu_module_start,
+    .stop = close_imu_controller,
+    .command = execute_imu_command,
+};
@@ -3,10 +3,12 @@
 
 #include <stdint.h>
 #include <pthread.h>
+#include "module.h"
 
 // Configuration
 #define IMU_I2C_DEVICE "/dev/i2c-1"
-#define IMU_UPDATE_RATE_HZ 10
+#define IMU_UPDATE_RATE_HZ 10      // Default poll rate, see "IMU config poll"
+#define IMU_MAX_POLL_RATE_HZ 1000
 
 // Structure to store sensor data
 typedef struct {
@@ -15,18 +17,41 @@ typedef struct {
     float mag_x, mag_y, mag_z;
     float temp;
     float roll, pitch, yaw;
+    uint64_t timestamp_us;  // CLOCK_MONOTONIC time of the sample
 } imu_data_t;
 
 // IMU Controller Functions
 int init_imu_controller(void);
 void close_imu_controller(void);
 int start_imu_thread(void);
+int start_imu_task(void);   // Poll from the shared scheduler (scheduler.h)
 void stop_imu_thread(void);
 
 // Data access (thread-safe)
 void get_imu_data(imu_data_t *data);
 
+// Counters since start (metrics.c)
+typedef struct {
+    unsigned long samples;      // Published samples, replayed ones included
+    unsigned long overruns;     // Read thread periods that missed their deadline
+    int poll_rate_hz;
+} imu_counters_t;
+void imu_get_counters(imu_counters_t *counters);
+
+// Called from the read thread with a copy of every new sample (NULL to clear)
+typedef void (*imu_sample_callback_t)(const imu_data_t *data);
+void set_imu_sample_callback(imu_sample_callback_t callback);
+
+// Replay source (replay.c): while active, published samples come from
+// imu_replay_sample() instead of the device; roll/pitch/yaw are recomputed
+void imu_replay_begin(void);
+void imu_replay_sample(const imu_data_t *sample);
+void imu_replay_end(void);
+
 // Command execution
 int execute_imu_command(char *cmd_str, char *response, size_t response_size);
 
+// Registry descriptor (module.h)
+extern const module_t imu_module;
+
 #endif // IMU_H
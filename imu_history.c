@@ -0,0 +1,632 @@
+#include "imu_history.h"
+#include "cmd_parse.h"
+#include "imu_stream.h"
+#include "lsm9ds1.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+// Monotonic deque of ring slots for sliding min/max
+typedef struct {
+    uint32_t *slot;
+    uint32_t capacity;
+    uint32_t head;
+    uint32_t size;
+} slot_deque_t;
+
+typedef struct {
+    uint64_t window_us;
+    uint32_t max_count;
+    uint64_t tail;          // Oldest sequence number inside the window
+    uint32_t count;
+    double sum[IMU_HISTORY_AXES];
+    double sumsq[IMU_HISTORY_AXES];
+    slot_deque_t min_dq[IMU_HISTORY_AXES];
+    slot_deque_t max_dq[IMU_HISTORY_AXES];
+} window_t;
+
+// Static variables
+static pthread_mutex_t history_mutex = PTHREAD_MUTEX_INITIALIZER;
+static imu_history_sample_t *ring = NULL;
+static uint64_t total = 0;  // Samples pushed since init (next sequence number)
+static uint64_t first_seq = 0;  // First sample since the last restart
+static float scales[IMU_HISTORY_MAX_SCALES][3];
+static int scale_count = 0;
+static window_t windows[IMU_HISTORY_NUM_WINDOWS];
+static unsigned long long packed_samples = 0;  // "history ... packed" totals
+static unsigned long long packed_bytes = 0;
+static uint64_t packed_ns = 0;
+
+static uint64_t get_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// ---------------------------
+// Sample helpers
+// ---------------------------
+static inline uint32_t slot_of(uint64_t seq) {
+    return (uint32_t)(seq % IMU_HISTORY_CAPACITY);
+}
+
+static inline imu_history_sample_t *sample_at(uint64_t seq) {
+    return &ring[slot_of(seq)];
+}
+
+static inline uint64_t sample_time(const imu_history_sample_t *s) {
+    return ((uint64_t)s->t_hi << 32) | s->t_lo;
+}
+
+static inline float sample_value(const imu_history_sample_t *s, int axis) {
+    return s->raw[axis] * scales[s->scale_id][axis / 3];
+}
+
+static inline uint64_t oldest_seq(void) {
+    uint64_t oldest = total > IMU_HISTORY_CAPACITY ? total - IMU_HISTORY_CAPACITY : 0;
+    return oldest > first_seq ? oldest : first_seq;
+}
+
+// ---------------------------
+// Deque operations (indices wrap inside the deque's own buffer)
+// ---------------------------
+static inline uint32_t dq_front(const slot_deque_t *dq) {
+    return dq->slot[dq->head];
+}
+
+static inline uint32_t dq_back(const slot_deque_t *dq) {
+    return dq->slot[(dq->head + dq->size - 1) % dq->capacity];
+}
+
+static inline void dq_push_back(slot_deque_t *dq, uint32_t slot) {
+    dq->slot[(dq->head + dq->size) % dq->capacity] = slot;
+    dq->size++;
+}
+
+static inline void dq_pop_front(slot_deque_t *dq) {
+    dq->head = (dq->head + 1) % dq->capacity;
+    dq->size--;
+}
+
+// ---------------------------
+// Sliding window maintenance
+// ---------------------------
+static void window_evict(window_t *w) {
+    uint32_t slot = slot_of(w->tail);
+    const imu_history_sample_t *s = &ring[slot];
+    for (int axis = 0; axis < IMU_HISTORY_AXES; axis++) {
+        float v = sample_value(s, axis);
+        w->sum[axis] -= v;
+        w->sumsq[axis] -= (double)v * v;
+        if (w->min_dq[axis].size && dq_front(&w->min_dq[axis]) == slot) {
+            dq_pop_front(&w->min_dq[axis]);
+        }
+        if (w->max_dq[axis].size && dq_front(&w->max_dq[axis]) == slot) {
+            dq_pop_front(&w->max_dq[axis]);
+        }
+    }
+    w->tail++;
+    w->count--;
+}
+
+static void window_add(window_t *w, uint64_t seq, uint64_t now) {
+    // Bound the deques even if samples arrive faster than the nominal max rate
+    if (w->count >= w->max_count) {
+        window_evict(w);
+    }
+    if (w->count == 0) {
+        w->tail = seq;
+    }
+
+    uint32_t slot = slot_of(seq);
+    const imu_history_sample_t *s = &ring[slot];
+    for (int axis = 0; axis < IMU_HISTORY_AXES; axis++) {
+        float v = sample_value(s, axis);
+        slot_deque_t *min_dq = &w->min_dq[axis];
+        slot_deque_t *max_dq = &w->max_dq[axis];
+
+        w->sum[axis] += v;
+        w->sumsq[axis] += (double)v * v;
+
+        while (min_dq->size && sample_value(&ring[dq_back(min_dq)], axis) >= v) min_dq->size--;
+        dq_push_back(min_dq, slot);
+        while (max_dq->size && sample_value(&ring[dq_back(max_dq)], axis) <= v) max_dq->size--;
+        dq_push_back(max_dq, slot);
+    }
+    w->count++;
+
+    while (w->count > 1 && now - sample_time(sample_at(w->tail)) > w->window_us) {
+        window_evict(w);
+    }
+}
+
+// ---------------------------
+// Initialize history ring and windows
+// ---------------------------
+int imu_history_init(void) {
+    static const uint32_t window_ms[IMU_HISTORY_NUM_WINDOWS] = IMU_HISTORY_WINDOWS;
+
+    pthread_mutex_lock(&history_mutex);
+
+    ring = calloc(IMU_HISTORY_CAPACITY, sizeof(imu_history_sample_t));
+    if (ring == NULL) {
+        pthread_mutex_unlock(&history_mutex);
+        fprintf(stderr, "[IMU] Failed to allocate history buffer\n");
+        return -1;
+    }
+
+    for (int i = 0; i < IMU_HISTORY_NUM_WINDOWS; i++) {
+        window_t *w = &windows[i];
+        memset(w, 0, sizeof(window_t));
+        w->window_us = (uint64_t)window_ms[i] * 1000;
+        w->max_count = window_ms[i] * IMU_HISTORY_MAX_RATE_HZ / 1000 + 1;
+        for (int axis = 0; axis < IMU_HISTORY_AXES; axis++) {
+            w->min_dq[axis].capacity = w->max_count;
+            w->max_dq[axis].capacity = w->max_count;
+            w->min_dq[axis].slot = malloc(w->max_count * sizeof(uint32_t));
+            w->max_dq[axis].slot = malloc(w->max_count * sizeof(uint32_t));
+            if (w->min_dq[axis].slot == NULL || w->max_dq[axis].slot == NULL) {
+                pthread_mutex_unlock(&history_mutex);
+                fprintf(stderr, "[IMU] Failed to allocate history windows\n");
+                imu_history_close();
+                return -1;
+            }
+        }
+    }
+
+    total = 0;
+    first_seq = 0;
+    scale_count = 0;
+
+    pthread_mutex_unlock(&history_mutex);
+
+    printf("[IMU] History: %d s at up to %d Hz (%zu KB)\n",
+           IMU_HISTORY_SECONDS, IMU_HISTORY_MAX_RATE_HZ,
+           IMU_HISTORY_CAPACITY * sizeof(imu_history_sample_t) / 1024);
+    return 0;
+}
+
+// ---------------------------
+// Release history memory
+// ---------------------------
+void imu_history_close(void) {
+    pthread_mutex_lock(&history_mutex);
+    for (int i = 0; i < IMU_HISTORY_NUM_WINDOWS; i++) {
+        for (int axis = 0; axis < IMU_HISTORY_AXES; axis++) {
+            free(windows[i].min_dq[axis].slot);
+            free(windows[i].max_dq[axis].slot);
+            windows[i].min_dq[axis].slot = NULL;
+            windows[i].max_dq[axis].slot = NULL;
+        }
+    }
+    free(ring);
+    ring = NULL;
+    total = first_seq = 0;
+    pthread_mutex_unlock(&history_mutex);
+}
+
+// ---------------------------
+// Register a scale set (reuses an identical existing entry)
+// ---------------------------
+int imu_history_register_scale(float accel, float gyro, float mag) {
+    int id;
+
+    pthread_mutex_lock(&history_mutex);
+    for (id = 0; id < scale_count; id++) {
+        if (scales[id][0] == accel && scales[id][1] == gyro && scales[id][2] == mag) {
+            break;
+        }
+    }
+    if (id == scale_count) {
+        if (scale_count == IMU_HISTORY_MAX_SCALES) {
+            id = -1;
+        } else {
+            scales[id][0] = accel;
+            scales[id][1] = gyro;
+            scales[id][2] = mag;
+            scale_count++;
+        }
+    }
+    pthread_mutex_unlock(&history_mutex);
+
+    return id;
+}
+
+// ---------------------------
+// Drop the samples so far and empty the windows; call with the lock held
+// ---------------------------
+static void restart_locked(void) {
+    first_seq = total;
+    for (int i = 0; i < IMU_HISTORY_NUM_WINDOWS; i++) {
+        window_t *w = &windows[i];
+        w->count = 0;
+        memset(w->sum, 0, sizeof(w->sum));
+        memset(w->sumsq, 0, sizeof(w->sumsq));
+        for (int axis = 0; axis < IMU_HISTORY_AXES; axis++) {
+            w->min_dq[axis].size = w->max_dq[axis].size = 0;
+        }
+    }
+}
+
+void imu_history_restart(void) {
+    pthread_mutex_lock(&history_mutex);
+    if (ring) {
+        restart_locked();
+    }
+    pthread_mutex_unlock(&history_mutex);
+}
+
+// ---------------------------
+// Append one sample and update the sliding windows
+// ---------------------------
+void imu_history_push(uint64_t timestamp_us, int scale_id,
+                      const int16_t accel[3], const int16_t gyro[3],
+                      const int16_t mag[3], int16_t temp_raw) {
+    if (scale_id < 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&history_mutex);
+
+    if (ring == NULL) {
+        pthread_mutex_unlock(&history_mutex);
+        return;
+    }
+
+    // Lookups assume time order: a step back (a replay moving to another
+    // run) starts a new history
+    if (total > first_seq && timestamp_us < sample_time(sample_at(total - 1))) {
+        restart_locked();
+    }
+
+    uint64_t seq = total;
+    imu_history_sample_t *s = sample_at(seq);
+
+    // The windows never reach back far enough to see the slot being reused
+    s->t_lo = (uint32_t)timestamp_us;
+    s->t_hi = (uint16_t)(timestamp_us >> 32);
+    s->scale_id = (uint8_t)scale_id;
+    s->reserved = 0;
+    memcpy(&s->raw[0], accel, 3 * sizeof(int16_t));
+    memcpy(&s->raw[3], gyro, 3 * sizeof(int16_t));
+    memcpy(&s->raw[6], mag, 3 * sizeof(int16_t));
+    s->temp_raw = temp_raw;
+    total++;
+
+    for (int i = 0; i < IMU_HISTORY_NUM_WINDOWS; i++) {
+        window_add(&windows[i], seq, timestamp_us);
+    }
+
+    pthread_mutex_unlock(&history_mutex);
+}
+
+// ---------------------------
+// First sequence number with timestamp >= t (binary search)
+// ---------------------------
+static uint64_t lower_bound(uint64_t t) {
+    uint64_t lo = oldest_seq(), hi = total;
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (sample_time(sample_at(mid)) < t) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// ---------------------------
+// Samples copied out of the ring so a page is formatted without holding
+// history_mutex (the sampler thread pushes under it at up to 952 Hz).
+// Entries of scales[] never change once registered, so the copies' scale
+// ids stay valid after the unlock.
+// ---------------------------
+typedef struct {
+    imu_history_sample_t *samples;
+    size_t count;
+    int more;           // Samples after the copied ones are in the range
+    uint64_t next_us;   // Time of the first of them
+} history_page_t;
+
+// Fewest response bytes a sample can take: a JSON sample with every value
+// zero, or an 11-byte imu_stream delta record in base64
+#define HISTORY_MIN_JSON_BYTES    57
+#define HISTORY_MIN_PACKED_BYTES  14
+
+// Copy samples [first, last), at most page->count of them; call with the lock held
+static void copy_page_locked(uint64_t first, uint64_t last, history_page_t *page) {
+    if (last < first) {
+        last = first;
+    }
+    if (last - first < page->count) {
+        page->count = last - first;
+    }
+    for (size_t i = 0; i < page->count; i++) {
+        page->samples[i] = *sample_at(first + i);
+    }
+    page->more = first + page->count < last;
+    page->next_us = page->more ? sample_time(sample_at(first + page->count)) : 0;
+}
+
+// ---------------------------
+// Move the page's samples from 'first' into a SoA block, up to a full
+// block or the next scale change; returns how many
+// ---------------------------
+static size_t fill_block(lsm9ds1_block_t *block, const history_page_t *page, size_t first) {
+    uint8_t id = page->samples[first].scale_id;
+    size_t n = 0;
+
+    block->accel_scale = scales[id][0];
+    block->gyro_scale = scales[id][1];
+    block->mag_scale = scales[id][2];
+    while (n < LSM9DS1_BLOCK_SIZE && first + n < page->count &&
+           page->samples[first + n].scale_id == id) {
+        for (int axis = 0; axis < IMU_HISTORY_AXES; axis++) {
+            block->raw[axis][n] = page->samples[first + n].raw[axis];
+        }
+        n++;
+    }
+    block->count = n;
+    return n;
+}
+
+// ---------------------------
+// Format a page as JSON, stopping when the buffer is full. Values are
+// converted a block at a time with the vector kernels (lsm9ds1.h).
+// ---------------------------
+static int format_samples(const history_page_t *page, char *response, size_t response_size) {
+    lsm9ds1_block_t block;
+    size_t pos = 0;
+    size_t i = 0;
+    int full = 0;
+    int n = snprintf(response, response_size, "{\"samples\":[");
+    if (n < 0 || (size_t)n >= response_size) return -1;
+    pos = n;
+
+    // Reserve room for the closing fields
+    size_t limit = response_size > 96 ? response_size - 96 : 0;
+
+    while (i < page->count && !full) {
+        size_t count = fill_block(&block, page, i);
+        lsm9ds1_block_convert(&block);
+
+        for (size_t j = 0; j < count; j++, i++) {
+            float (*si)[LSM9DS1_BLOCK_SIZE] = block.si;
+            n = snprintf(response + pos, limit > pos ? limit - pos : 0,
+                "%s[%llu,%.3f,%.3f,%.3f,%.4f,%.4f,%.4f,%.2f,%.2f,%.2f]",
+                i == 0 ? "" : ",",
+                (unsigned long long)sample_time(&page->samples[i]),
+                si[0][j], si[1][j], si[2][j], si[3][j], si[4][j], si[5][j],
+                si[6][j], si[7][j], si[8][j]);
+            if (n < 0 || pos + n >= limit) {
+                full = 1;
+                break;
+            }
+            pos += n;
+        }
+    }
+
+    if (i < page->count || page->more) {
+        // Truncated: tell the client where to resume
+        snprintf(response + pos, response_size - pos,
+            "],\"count\":%zu,\"truncated\":true,\"next_us\":%llu}\n", i,
+            (unsigned long long)(i < page->count ? sample_time(&page->samples[i]) : page->next_us));
+    } else {
+        snprintf(response + pos, response_size - pos,
+            "],\"count\":%zu,\"truncated\":false}\n", i);
+    }
+    return 0;
+}
+
+// ---------------------------
+// Encode a page as a base64 imu_stream (imu_stream.h), stopping when the
+// buffer is full
+// ---------------------------
+static int format_packed(const history_page_t *page, char *response, size_t response_size) {
+    // Room for the fields around the data, then 4 base64 characters per 3 bytes
+    size_t text_size = response_size > 256 ? response_size - 256 : 0;
+    size_t size = text_size / 4 * 3;
+    imu_stream_encoder_t enc;
+    size_t i;
+
+    uint8_t *stream = malloc(size ? size : 1);
+    if (stream == NULL || imu_stream_encoder_init(&enc, stream, size, 0) < 0) {
+        free(stream);
+        snprintf(response, response_size, "ERROR: No room for a packed IMU history\n");
+        return -1;
+    }
+
+    uint64_t start = get_time_ns();
+    for (i = 0; i < page->count; i++) {
+        const imu_history_sample_t *s = &page->samples[i];
+        imu_stream_sample_t sample;
+        sample.t_us = sample_time(s);
+        memcpy(sample.scale, scales[s->scale_id], sizeof(sample.scale));
+        memcpy(sample.raw, s->raw, sizeof(s->raw));
+        sample.raw[IMU_HISTORY_AXES] = s->temp_raw;
+        if (imu_stream_encode(&enc, &sample) < 0) {
+            break;
+        }
+    }
+    size_t len = imu_stream_finish(&enc);
+    uint64_t elapsed = get_time_ns() - start;
+
+    size_t raw_bytes = i * sizeof(imu_history_sample_t);
+    pthread_mutex_lock(&history_mutex);
+    packed_samples += i;
+    packed_bytes += len;
+    packed_ns += elapsed;
+    pthread_mutex_unlock(&history_mutex);
+
+    size_t pos = snprintf(response, response_size,
+        "{\"encoding\":\"imu_stream\",\"version\":%d,\"count\":%zu,\"bytes\":%zu,"
+        "\"raw_bytes\":%zu,\"ratio\":%.2f,\"encode_ns_per_sample\":%.1f,",
+        IMU_STREAM_VERSION, i, len, raw_bytes,
+        len ? (double)raw_bytes / len : 0.0, i ? (double)elapsed / i : 0.0);
+    if (i < page->count || page->more) {
+        // Truncated: tell the client where to resume
+        pos += snprintf(response + pos, response_size - pos, "\"truncated\":true,\"next_us\":%llu,",
+            (unsigned long long)(i < page->count ? sample_time(&page->samples[i]) : page->next_us));
+    } else {
+        pos += snprintf(response + pos, response_size - pos, "\"truncated\":false,");
+    }
+    pos += snprintf(response + pos, response_size - pos, "\"data\":\"");
+    pos += imu_stream_base64_encode(stream, len, response + pos, response_size - pos);
+    snprintf(response + pos, response_size - pos, "\"}\n");
+    free(stream);
+    return 0;
+}
+
+// ---------------------------
+// History command
+//   ""                      - Buffer info
+//   "last <n>"              - Most recent n samples
+//   "range <t0_us> <t1_us>" - Samples with t0 <= t < t1
+// Samples are [t_us, ax, ay, az, gx, gy, gz, mx, my, mz] in SI units, or
+// with "packed" after the range the raw values as a delta/varint encoded
+// imu_stream in base64 (decode with tools/imu_stream_decode)
+// ---------------------------
+int execute_history_command(const char *args, char *response, size_t response_size) {
+    static const char *const modes[] = { "last", "range" };
+    enum { MODE_SUMMARY = -2, MODE_LAST = 0, MODE_RANGE = 1 };
+    cmd_parser_t p;
+    uint64_t a = 0, b = 0;
+    int packed = 0;
+    int ret = 0;
+
+    cmd_init(&p, args);
+    int mode = cmd_done(&p) ? MODE_SUMMARY : cmd_keyword(&p, "IMU history command", modes, 2);
+    if (mode == -1 ||
+        (mode == MODE_LAST && cmd_u64(&p, "count", &a) < 0) ||
+        (mode == MODE_RANGE && (cmd_u64(&p, "t0_us", &a) < 0 || cmd_u64(&p, "t1_us", &b) < 0))) {
+        return cmd_error(&p, response, response_size);
+    }
+    packed = mode != MODE_SUMMARY && cmd_match(&p, "packed");
+    if (cmd_end(&p) < 0) {
+        return cmd_error(&p, response, response_size);
+    }
+
+    // Never copy more samples than the response could hold
+    history_page_t page = { 0 };
+    if (mode != MODE_SUMMARY) {
+        page.count = response_size / (packed ? HISTORY_MIN_PACKED_BYTES : HISTORY_MIN_JSON_BYTES) + 1;
+        if (page.count > IMU_HISTORY_CAPACITY) page.count = IMU_HISTORY_CAPACITY;
+        if (mode == MODE_LAST && a < page.count) page.count = (size_t)a;
+        page.samples = malloc(page.count ? page.count * sizeof(imu_history_sample_t) : 1);
+        if (page.samples == NULL) {
+            snprintf(response, response_size, "ERROR: Out of memory\n");
+            return -1;
+        }
+    }
+
+    pthread_mutex_lock(&history_mutex);
+
+    if (ring == NULL) {
+        snprintf(response, response_size, "ERROR: IMU history not initialized\n");
+        ret = -1;
+    }
+    else if (mode == MODE_SUMMARY) {
+        uint64_t first = oldest_seq();
+        uint64_t count = total - first;
+        snprintf(response, response_size,
+            "{\"capacity\":%d,\"count\":%llu,\"sample_bytes\":%zu,"
+            "\"oldest_us\":%llu,\"newest_us\":%llu,"
+            "\"packed\":{\"samples\":%llu,\"bytes\":%llu,\"ratio\":%.2f,\"encode_ns_per_sample\":%.1f}}\n",
+            IMU_HISTORY_CAPACITY, (unsigned long long)count, sizeof(imu_history_sample_t),
+            count ? (unsigned long long)sample_time(sample_at(first)) : 0ULL,
+            count ? (unsigned long long)sample_time(sample_at(total - 1)) : 0ULL,
+            packed_samples, packed_bytes,
+            packed_bytes ? (double)(packed_samples * sizeof(imu_history_sample_t)) / packed_bytes : 0.0,
+            packed_samples ? (double)packed_ns / packed_samples : 0.0);
+    }
+    else if (mode == MODE_LAST) {
+        uint64_t first = oldest_seq();
+        if (a < total - first) first = total - a;
+        copy_page_locked(first, total, &page);
+    }
+    else {
+        copy_page_locked(lower_bound(a), lower_bound(b), &page);
+    }
+
+    pthread_mutex_unlock(&history_mutex);
+
+    if (ret == 0 && mode != MODE_SUMMARY) {
+        ret = packed ? format_packed(&page, response, response_size)
+                     : format_samples(&page, response, response_size);
+    }
+    free(page.samples);
+    return ret;
+}
+
+static void get_window_stats(const window_t *w, imu_history_stats_t *out) {
+    out->window_ms = (uint32_t)(w->window_us / 1000);
+    out->count = w->count;
+    for (int axis = 0; axis < IMU_HISTORY_AXES; axis++) {
+        if (w->count == 0) {
+            out->min[axis] = out->max[axis] = out->mean[axis] = out->rms[axis] = 0.0f;
+            continue;
+        }
+        out->min[axis] = sample_value(&ring[dq_front(&w->min_dq[axis])], axis);
+        out->max[axis] = sample_value(&ring[dq_front(&w->max_dq[axis])], axis);
+        out->mean[axis] = (float)(w->sum[axis] / w->count);
+        out->rms[axis] = (float)sqrt(fmax(w->sumsq[axis] / w->count, 0.0));
+    }
+}
+
+// ---------------------------
+// Stats command: "<window_ms>" (defaults to 1000)
+// ---------------------------
+int execute_stats_command(const char *args, char *response, size_t response_size) {
+    static const uint32_t window_ms[IMU_HISTORY_NUM_WINDOWS] = IMU_HISTORY_WINDOWS;
+    long requested = 1000;
+    imu_history_stats_t st;
+    cmd_parser_t p;
+    int i;
+
+    cmd_init(&p, args);
+    if ((!cmd_done(&p) && cmd_long(&p, "window_ms", 0, 1000000, &requested) < 0) ||
+        cmd_end(&p) < 0) {
+        return cmd_error(&p, response, response_size);
+    }
+
+    for (i = 0; i < IMU_HISTORY_NUM_WINDOWS; i++) {
+        if ((long)window_ms[i] == requested) break;
+    }
+    if (i == IMU_HISTORY_NUM_WINDOWS) {
+        snprintf(response, response_size, "ERROR: Window must be one of 100, 1000, 10000 ms\n");
+        return -1;
+    }
+
+    pthread_mutex_lock(&history_mutex);
+    if (ring == NULL) {
+        pthread_mutex_unlock(&history_mutex);
+        snprintf(response, response_size, "ERROR: IMU history not initialized\n");
+        return -1;
+    }
+    get_window_stats(&windows[i], &st);
+    pthread_mutex_unlock(&history_mutex);
+
+    static const char *groups[3] = { "accel", "gyro", "mag" };
+    size_t pos = 0;
+    int n = snprintf(response, response_size, "{\"window_ms\":%u,\"count\":%u",
+                     st.window_ms, st.count);
+    for (int g = 0; g < 3 && n > 0 && (pos += n) < response_size; g++) {
+        int a = g * 3;
+        n = snprintf(response + pos, response_size - pos,
+            ",\"%s\":{\"min\":[%.4f,%.4f,%.4f],\"max\":[%.4f,%.4f,%.4f],"
+            "\"mean\":[%.4f,%.4f,%.4f],\"rms\":[%.4f,%.4f,%.4f]}",
+            groups[g],
+            st.min[a], st.min[a + 1], st.min[a + 2],
+            st.max[a], st.max[a + 1], st.max[a + 2],
+            st.mean[a], st.mean[a + 1], st.mean[a + 2],
+            st.rms[a], st.rms[a + 1], st.rms[a + 2]);
+    }
+    if (n > 0 && (pos += n) < response_size) {
+        snprintf(response + pos, response_size - pos, "}\n");
+    }
+    return 0;
+}
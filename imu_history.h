@@ -0,0 +1,59 @@
+#ifndef IMU_HISTORY_H
+#define IMU_HISTORY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Configuration
+#define IMU_HISTORY_SECONDS      120
+#define IMU_HISTORY_MAX_RATE_HZ  952
+#define IMU_HISTORY_CAPACITY     (IMU_HISTORY_SECONDS * IMU_HISTORY_MAX_RATE_HZ)
+#define IMU_HISTORY_AXES         9    // accel xyz, gyro xyz, mag xyz
+#define IMU_HISTORY_MAX_SCALES   256
+
+// Sliding windows with incrementally maintained aggregates (ms)
+#define IMU_HISTORY_WINDOWS      { 100, 1000, 10000 }
+#define IMU_HISTORY_NUM_WINDOWS  3
+
+// Compact raw sample (28 bytes): 48-bit microsecond timestamp, the id of
+// the scale set that was active when it was read, and the raw int16 axes
+typedef struct {
+    uint32_t t_lo;
+    uint16_t t_hi;
+    uint8_t scale_id;
+    uint8_t reserved;
+    int16_t raw[IMU_HISTORY_AXES];
+    int16_t temp_raw;
+} imu_history_sample_t;
+
+// Per-axis aggregates over one sliding window (SI units)
+typedef struct {
+    uint32_t window_ms;
+    uint32_t count;
+    float min[IMU_HISTORY_AXES];
+    float max[IMU_HISTORY_AXES];
+    float mean[IMU_HISTORY_AXES];
+    float rms[IMU_HISTORY_AXES];
+} imu_history_stats_t;
+
+// History Functions
+int imu_history_init(void);
+void imu_history_close(void);
+
+// Register SI-per-LSB factors for accel, gyro and mag; returns a scale id
+int imu_history_register_scale(float accel, float gyro, float mag);
+
+// Called for every published sample, live or replayed. A timestamp older
+// than the newest sample restarts the history.
+void imu_history_push(uint64_t timestamp_us, int scale_id,
+                      const int16_t accel[3], const int16_t gyro[3],
+                      const int16_t mag[3], int16_t temp_raw);
+
+// Forget the samples so far, e.g. when a replay starts
+void imu_history_restart(void);
+
+// Command execution
+int execute_history_command(const char *args, char *response, size_t response_size);
+int execute_stats_command(const char *args, char *response, size_t response_size);
+
+#endif // IMU_HISTORY_H
@@ -0,0 +1,295 @@
+#include "imu_stream.h"
+#include <string.h>
+
+#define KEYFRAME_SIZE  (8 + 3 * 4 + IMU_STREAM_AXES * 2)   // t_us, scales, raw
+#define MAX_DELTA      (5 * (1 + IMU_STREAM_AXES))          // 32-bit varints
+#define MAX_DT_CHANGE  1000000                              // Larger: new block
+
+static uint16_t fletcher16(const uint8_t *data, size_t len) {
+    uint32_t a = 0, b = 0;
+    for (size_t i = 0; i < len; i++) {
+        a = (a + data[i]) % 255;
+        b = (b + a) % 255;
+    }
+    return (uint16_t)((b << 8) | a);
+}
+
+// ---------------------------
+// Varints (LEB128); signed values are zigzag mapped first so small
+// negative changes stay short
+// ---------------------------
+static inline size_t put_varint(uint8_t *out, uint32_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+static inline size_t put_signed(uint8_t *out, int32_t value) {
+    return put_varint(out, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
+
+// 0 if the varint runs past 'end' or is longer than 32 bits
+static inline size_t get_signed(const uint8_t *in, const uint8_t *end, int32_t *value) {
+    uint32_t v = 0;
+    size_t n = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (in + n >= end) return 0;
+        uint8_t byte = in[n++];
+        v |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+            return n;
+        }
+    }
+    return 0;
+}
+
+// ---------------------------
+// Encoder
+// ---------------------------
+int imu_stream_encoder_init(imu_stream_encoder_t *enc, uint8_t *out, size_t size,
+                            uint16_t keyframe_interval) {
+    imu_stream_header_t header = {
+        .magic = IMU_STREAM_MAGIC,
+        .version = IMU_STREAM_VERSION,
+        .axes = IMU_STREAM_AXES,
+        .keyframe_interval = keyframe_interval ? keyframe_interval : IMU_STREAM_KEYFRAME_INTERVAL,
+    };
+
+    memset(enc, 0, sizeof(*enc));
+    if (size < sizeof(header)) {
+        return -1;
+    }
+    memcpy(out, &header, sizeof(header));
+    enc->out = out;
+    enc->size = size;
+    enc->pos = sizeof(header);
+    enc->interval = header.keyframe_interval;
+    return 0;
+}
+
+static void close_block(imu_stream_encoder_t *enc) {
+    if (!enc->open) {
+        return;
+    }
+    size_t start = enc->block + sizeof(imu_stream_block_t);
+    imu_stream_block_t block = {
+        .sync = IMU_STREAM_SYNC,
+        .length = (uint16_t)(enc->pos - start),
+        .count = enc->count,
+        .checksum = fletcher16(enc->out + start, enc->pos - start),
+    };
+    memcpy(enc->out + enc->block, &block, sizeof(block));
+    enc->open = 0;
+}
+
+int imu_stream_encode(imu_stream_encoder_t *enc, const imu_stream_sample_t *s) {
+    const imu_stream_sample_t *prev = &enc->prev;
+    int64_t dt = (int64_t)(s->t_us - prev->t_us);
+    int64_t dt_change = dt - enc->prev_dt;
+
+    if (enc->open && enc->count < enc->interval &&
+        dt_change >= -MAX_DT_CHANGE && dt_change <= MAX_DT_CHANGE &&
+        memcmp(s->scale, prev->scale, sizeof(s->scale)) == 0) {
+        uint8_t delta[MAX_DELTA];
+        size_t n = put_signed(delta, (int32_t)dt_change);
+        for (int axis = 0; axis < IMU_STREAM_AXES; axis++) {
+            n += put_signed(delta + n, (int32_t)s->raw[axis] - prev->raw[axis]);
+        }
+
+        size_t payload = enc->pos - enc->block - sizeof(imu_stream_block_t);
+        if (payload + n <= IMU_STREAM_MAX_PAYLOAD) {
+            if (enc->pos + n > enc->size) {
+                return -1;
+            }
+            memcpy(enc->out + enc->pos, delta, n);
+            enc->pos += n;
+            enc->count++;
+            enc->prev_dt = dt;
+            enc->prev = *s;
+            return 0;
+        }
+    }
+
+    // Keyframe in a new block
+    if (enc->pos + sizeof(imu_stream_block_t) + KEYFRAME_SIZE > enc->size) {
+        return -1;
+    }
+    close_block(enc);
+    enc->block = enc->pos;
+    enc->pos += sizeof(imu_stream_block_t);
+    memcpy(enc->out + enc->pos, &s->t_us, 8);
+    memcpy(enc->out + enc->pos + 8, s->scale, 3 * 4);
+    memcpy(enc->out + enc->pos + 20, s->raw, IMU_STREAM_AXES * 2);
+    enc->pos += KEYFRAME_SIZE;
+    enc->open = 1;
+    enc->count = 1;
+    enc->prev_dt = 0;
+    enc->prev = *s;
+    return 0;
+}
+
+size_t imu_stream_finish(imu_stream_encoder_t *enc) {
+    close_block(enc);
+    return enc->pos;
+}
+
+// ---------------------------
+// Decoder
+// ---------------------------
+int imu_stream_read_header(const uint8_t *data, size_t len, imu_stream_header_t *header) {
+    if (len < sizeof(*header)) {
+        return -1;
+    }
+    memcpy(header, data, sizeof(*header));
+    if (header->magic != IMU_STREAM_MAGIC || header->version != IMU_STREAM_VERSION ||
+        header->axes != IMU_STREAM_AXES) {
+        return -1;
+    }
+    return 0;
+}
+
+// Decode one verified payload; -1 if it does not parse to exactly 'count'
+// samples. *stop is set when the visitor asks to stop.
+static long decode_block(const uint8_t *in, const imu_stream_block_t *block,
+                         imu_stream_visit_fn fn, void *ctx, int *stop) {
+    const uint8_t *end = in + block->length;
+    imu_stream_sample_t s;
+    int64_t dt = 0;
+    long visited = 0;
+
+    if (block->count == 0 || block->length < KEYFRAME_SIZE) {
+        return -1;
+    }
+    memcpy(&s.t_us, in, 8);
+    memcpy(s.scale, in + 8, 3 * 4);
+    memcpy(s.raw, in + 20, IMU_STREAM_AXES * 2);
+    in += KEYFRAME_SIZE;
+
+    for (unsigned i = 0; ; i++) {
+        if (fn && fn(&s, ctx)) {
+            *stop = 1;
+            return visited + 1;
+        }
+        visited++;
+        if (i + 1 == block->count) break;
+
+        int32_t change;
+        size_t n = get_signed(in, end, &change);
+        if (n == 0) return -1;
+        in += n;
+        dt += change;
+        s.t_us += (uint64_t)dt;
+        for (int axis = 0; axis < IMU_STREAM_AXES; axis++) {
+            if ((n = get_signed(in, end, &change)) == 0) return -1;
+            in += n;
+            s.raw[axis] = (int16_t)(s.raw[axis] + change);
+        }
+    }
+    return in == end ? visited : -1;
+}
+
+long imu_stream_decode(const uint8_t *data, size_t len, imu_stream_visit_fn fn, void *ctx,
+                       imu_stream_decode_stats_t *stats) {
+    imu_stream_decode_stats_t st;
+    imu_stream_header_t header;
+    size_t pos = sizeof(header);
+    long samples = 0;
+    int stop = 0;
+
+    memset(&st, 0, sizeof(st));
+    if (imu_stream_read_header(data, len, &header) < 0) {
+        return -1;
+    }
+
+    while (!stop && pos + sizeof(imu_stream_block_t) <= len) {
+        imu_stream_block_t block;
+        memcpy(&block, data + pos, sizeof(block));
+        const uint8_t *payload = data + pos + sizeof(block);
+
+        if (block.sync != IMU_STREAM_SYNC) {
+            pos++;
+            st.skipped_bytes++;
+            continue;
+        }
+        if (block.length > IMU_STREAM_MAX_PAYLOAD || pos + sizeof(block) + block.length > len ||
+            fletcher16(payload, block.length) != block.checksum) {
+            // Damaged or a false sync inside another block: resync
+            st.bad_blocks++;
+            pos++;
+            st.skipped_bytes++;
+            continue;
+        }
+
+        // The checksum passed, so the samples are visited as they parse
+        long n = decode_block(payload, &block, fn, ctx, &stop);
+        if (n < 0) {
+            st.bad_blocks++;
+            pos++;
+            st.skipped_bytes++;
+            continue;
+        }
+        samples += n;
+        st.blocks++;
+        pos += sizeof(block) + block.length;
+    }
+
+    if (stats) *stats = st;
+    return samples;
+}
+
+// ---------------------------
+// Base64
+// ---------------------------
+static const char base64_chars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+size_t imu_stream_base64_encode(const uint8_t *data, size_t len, char *out, size_t size) {
+    size_t needed = (len + 2) / 3 * 4;
+    size_t n = 0;
+
+    if (needed + 1 > size) {
+        return 0;
+    }
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t v = (uint32_t)data[i] << 16;
+        if (i + 1 < len) v |= (uint32_t)data[i + 1] << 8;
+        if (i + 2 < len) v |= data[i + 2];
+        out[n++] = base64_chars[(v >> 18) & 63];
+        out[n++] = base64_chars[(v >> 12) & 63];
+        out[n++] = i + 1 < len ? base64_chars[(v >> 6) & 63] : '=';
+        out[n++] = i + 2 < len ? base64_chars[v & 63] : '=';
+    }
+    out[n] = '\0';
+    return n;
+}
+
+static int base64_value(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+long imu_stream_base64_decode(const char *text, uint8_t *out, size_t size) {
+    uint32_t v = 0;
+    int bits = 0;
+    size_t n = 0;
+
+    for (; base64_value(*text) >= 0; text++) {
+        v = (v << 6) | (uint32_t)base64_value(*text);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            if (n == size) return -1;
+            out[n++] = (uint8_t)(v >> bits);
+        }
+    }
+    return (long)n;
+}
@@ -0,0 +1,106 @@
+#ifndef IMU_STREAM_H
+#define IMU_STREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ---------------------------
+// Compressed IMU sample stream, shared with tools/imu_stream_decode
+// (little-endian)
+//
+// A stream is an imu_stream_header_t followed by blocks. A block is an
+// imu_stream_block_t and its payload: a keyframe with the first sample's
+// absolute time, scale factors and raw values, then one delta record per
+// following sample. A delta record is a zigzag varint of the change in
+// sample interval (us) and one zigzag varint per axis of the change from
+// the previous sample. A scale change, a time jump or keyframe_interval
+// samples start a new block; the sync word and checksum let a decoder
+// that lost bytes pick up again at the next block.
+// ---------------------------
+#define IMU_STREAM_MAGIC              0x534D4956u   // "VIMS"
+#define IMU_STREAM_VERSION            1
+#define IMU_STREAM_AXES               10            // accel xyz, gyro xyz, mag xyz, temp
+#define IMU_STREAM_SYNC               0xA7B5
+#define IMU_STREAM_KEYFRAME_INTERVAL  100           // Default samples per block
+#define IMU_STREAM_MAX_PAYLOAD        4096          // Bytes per block after its header
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint8_t axes;
+    uint8_t reserved;
+    uint16_t keyframe_interval;
+    uint16_t reserved2;
+} imu_stream_header_t;
+
+typedef struct {
+    uint16_t sync;
+    uint16_t length;    // Payload bytes
+    uint16_t count;     // Samples, keyframe included
+    uint16_t checksum;  // Fletcher-16 of the payload
+} imu_stream_block_t;
+
+typedef struct {
+    uint64_t t_us;
+    float scale[3];     // SI units per LSB for accel, gyro and mag
+    int16_t raw[IMU_STREAM_AXES];
+} imu_stream_sample_t;
+
+// ---------------------------
+// Encoder: writes into a caller buffer
+// ---------------------------
+typedef struct {
+    uint8_t *out;
+    size_t size;
+    size_t pos;
+    size_t block;       // Offset of the open block's header
+    int open;
+    uint16_t interval;
+    uint16_t count;
+    int64_t prev_dt;
+    imu_stream_sample_t prev;
+} imu_stream_encoder_t;
+
+// Writes the stream header; -1 if 'size' cannot hold it
+int imu_stream_encoder_init(imu_stream_encoder_t *enc, uint8_t *out, size_t size,
+                            uint16_t keyframe_interval);
+
+// Append one sample; -1 (nothing written) when the buffer is full
+int imu_stream_encode(imu_stream_encoder_t *enc, const imu_stream_sample_t *sample);
+
+// Close the open block; returns the stream length in bytes
+size_t imu_stream_finish(imu_stream_encoder_t *enc);
+
+// ---------------------------
+// Decoder
+// ---------------------------
+
+// Called for each sample in stream order; a nonzero return stops decoding
+typedef int (*imu_stream_visit_fn)(const imu_stream_sample_t *sample, void *ctx);
+
+typedef struct {
+    unsigned long blocks;
+    unsigned long bad_blocks;   // Failed the checksum or did not parse
+    size_t skipped_bytes;       // Scanned past while looking for a sync word
+} imu_stream_decode_stats_t;
+
+// 0, or -1 if the data does not start with a version 1 header
+int imu_stream_read_header(const uint8_t *data, size_t len, imu_stream_header_t *header);
+
+// Decode every block after the header. Returns the number of samples
+// visited, or -1 if the header is invalid. stats may be NULL.
+long imu_stream_decode(const uint8_t *data, size_t len, imu_stream_visit_fn fn, void *ctx,
+                       imu_stream_decode_stats_t *stats);
+
+// ---------------------------
+// Base64, to carry a stream in a text response line
+// ---------------------------
+
+// Returns the encoded length (a NUL follows), or 0 if 'size' is too small
+size_t imu_stream_base64_encode(const uint8_t *data, size_t len, char *out, size_t size);
+
+// Stops at the first character outside the alphabet; returns the decoded
+// length, or -1 if 'size' is too small
+long imu_stream_base64_decode(const char *text, uint8_t *out, size_t size);
+
+#endif // IMU_STREAM_H
@@ -1,15 +1,12 @@
 #include "lsm9ds1.h"
+#include "i2c_bus.h"
+#include "trace.h"
 #include <stdio.h>
 #include <stdlib.h>
-#include <fcntl.h>
+#include <string.h>
 #include <unistd.h>
-#include <sys/ioctl.h>
-#include <linux/i2c-dev.h>
 #include <math.h>
 
-#define SENSORS_GRAVITY_STANDARD 9.80665f
-#define SENSORS_DPS_TO_RADS      0.017453293f
-
 // Facteurs de conversion LSB
 #define LSM9DS1_ACCEL_MG_LSB_2G   0.061f
 #define LSM9DS1_ACCEL_MG_LSB_4G   0.122f
@@ -20,78 +17,52 @@
 #define LSM9DS1_GYRO_DPS_DIGIT_500DPS   0.01750f
 #define LSM9DS1_GYRO_DPS_DIGIT_2000DPS  0.07000f
 
-// Fonctions utilitaires I2C
-static int i2c_open_device(const char *bus, int addr) {
-    int fd = open(bus, O_RDWR);
-    if (fd < 0) {
-        perror("Erreur ouverture bus I2C");
-        return -1;
-    }
-    
-    if (ioctl(fd, I2C_SLAVE, addr) < 0) {
-        perror("Erreur configuration adresse I2C");
-        close(fd);
-        return -1;
-    }
-    
-    return fd;
+// Fonctions utilitaires I2C (transactions passées par l'arbitre de bus)
+static int i2c_write_byte(int dev, uint8_t reg, uint8_t value) {
+    return i2c_bus_write_reg(dev, reg, value);
 }
 
-static int i2c_write_byte(int fd, uint8_t reg, uint8_t value) {
-    uint8_t buffer[2] = {reg, value};
-    if (write(fd, buffer, 2) != 2) {
-        perror("Erreur écriture I2C");
-        return -1;
-    }
-    return 0;
+static int i2c_read_byte(int dev, uint8_t reg, uint8_t *value) {
+    return i2c_bus_read_reg(dev, reg, value);
 }
 
-static int i2c_read_byte(int fd, uint8_t reg, uint8_t *value) {
-    if (write(fd, &reg, 1) != 1) {
-        perror("Erreur écriture registre I2C");
-        return -1;
-    }
-    if (read(fd, value, 1) != 1) {
-        perror("Erreur lecture I2C");
-        return -1;
-    }
-    return 0;
+static int i2c_read_block(int dev, uint8_t reg, uint8_t *buffer, size_t len) {
+    // Pour lire plusieurs registres contigus, on utilise l'auto-increment
+    uint64_t t0 = trace_begin();
+    int result = i2c_bus_read_block(dev, reg | 0x80, buffer, len);
+    trace_end("i2c_read_block", t0);
+    return result;
 }
 
-static int i2c_read_block(int fd, uint8_t reg, uint8_t *buffer, size_t len) {
-    // Pour lire plusieurs registres contigus, on utilise l'auto-increment
-    reg |= 0x80;
-    
-    if (write(fd, &reg, 1) != 1) {
-        perror("Erreur écriture registre I2C");
+static int i2c_update_bits(int dev, uint8_t reg, uint8_t mask, uint8_t value) {
+    uint8_t current;
+    if (i2c_read_byte(dev, reg, &current) < 0) {
         return -1;
     }
-    if (read(fd, buffer, len) != len) {
-        perror("Erreur lecture bloc I2C");
-        return -1;
-    }
-    return 0;
+    return i2c_write_byte(dev, reg, (current & ~mask) | (value & mask));
 }
 
 // Initialisation
-bool lsm9ds1_init(lsm9ds1_t *lsm, const char *i2c_bus) {
-    // Ouvrir les deux devices I2C
-    lsm->fd_xg = i2c_open_device(i2c_bus, LSM9DS1_ADDRESS_ACCELGYRO);
-    if (lsm->fd_xg < 0) {
+bool lsm9ds1_init(lsm9ds1_t *lsm, const char *i2c_bus, const lsm9ds1_config_t *config) {
+    // Enregistrer les deux devices auprès de l'arbitre (lectures de télémétrie)
+    lsm->dev_xg = i2c_bus_attach(i2c_bus, "lsm9ds1_xg", LSM9DS1_ADDRESS_ACCELGYRO,
+                                 I2C_PRIO_TELEMETRY);
+    if (lsm->dev_xg < 0) {
         printf("Erreur: Impossible d'ouvrir accel/gyro\n");
         return false;
     }
     
-    lsm->fd_mag = i2c_open_device(i2c_bus, LSM9DS1_ADDRESS_MAG);
-    if (lsm->fd_mag < 0) {
+    lsm->dev_mag = i2c_bus_attach(i2c_bus, "lis3mdl", LSM9DS1_ADDRESS_MAG,
+                                  I2C_PRIO_TELEMETRY);
+    if (lsm->dev_mag < 0) {
         printf("Erreur: Impossible d'ouvrir magnétomètre\n");
-        close(lsm->fd_xg);
+        i2c_bus_detach(lsm->dev_xg);
         return false;
     }
     
     // Vérifier les WHO_AM_I
     uint8_t id;
-    if (i2c_read_byte(lsm->fd_xg, LSM9DS1_REGISTER_WHO_AM_I_XG, &id) < 0) {
+    if (i2c_read_byte(lsm->dev_xg, LSM9DS1_REGISTER_WHO_AM_I_XG, &id) < 0) {
         printf("Erreur lecture WHO_AM_I accel/gyro\n");
         return false;
     }
@@ -100,7 +71,7 @@ bool lsm9ds1_init(lsm9ds1_t *lsm, const char *i2c_bus) {
         return false;
     }
     
-    if (i2c_read_byte(lsm->fd_mag, LIS3MDL_REGISTER_WHO_AM_I, &id) < 0) {
+    if (i2c_read_byte(lsm->dev_mag, LIS3MDL_REGISTER_WHO_AM_I, &id) < 0) {
         printf("Erreur lecture WHO_AM_I mag\n");
         return false;
     }
@@ -110,38 +81,95 @@ bool lsm9ds1_init(lsm9ds1_t *lsm, const char *i2c_bus) {
     }
     
     // Soft reset
-    i2c_write_byte(lsm->fd_xg, LSM9DS1_REGISTER_CTRL_REG8, 0x05);
+    i2c_write_byte(lsm->dev_xg, LSM9DS1_REGISTER_CTRL_REG8, 0x05);
     usleep(10000); // 10ms
     
-    // Activer le gyroscope
-    i2c_write_byte(lsm->fd_xg, LSM9DS1_REGISTER_CTRL_REG1_G, 0xC0);
-    
-    // Activer l'accéléromètre
-    i2c_write_byte(lsm->fd_xg, LSM9DS1_REGISTER_CTRL_REG5_XL, 0x38);
-    i2c_write_byte(lsm->fd_xg, LSM9DS1_REGISTER_CTRL_REG6_XL, 0xC0);
+    // Activer les 3 axes de l'accéléromètre
+    i2c_write_byte(lsm->dev_xg, LSM9DS1_REGISTER_CTRL_REG5_XL, 0x38);
     
     // Activer le magnétomètre en mode continu
-    i2c_write_byte(lsm->fd_mag, LIS3MDL_REGISTER_CTRL_REG3, 0x00);
+    i2c_write_byte(lsm->dev_mag, LIS3MDL_REGISTER_CTRL_REG3, 0x00);
+    
+    // Température : évolue lentement, 1 Hz suffit
+    memset(lsm->groups, 0, sizeof(lsm->groups));
+    lsm9ds1_set_group_period(lsm, LSM9DS1_GROUP_TEMP, LSM9DS1_TEMP_PERIOD_US);
+    
+    // Appliquer directement la configuration demandée (ODR, plages, gain)
+    return lsm9ds1_configure(lsm, config);
+}
+
+// Reconfiguration à chaud; l'accel et le gyro partagent le même ODR
+bool lsm9ds1_configure(lsm9ds1_t *lsm, const lsm9ds1_config_t *config) {
+    lsm9ds1_config_t readback;
+    
+    lsm9ds1_setup_accel(lsm, config->accel_range, config->odr);
+    i2c_update_bits(lsm->dev_xg, LSM9DS1_REGISTER_CTRL_REG1_G, 0b11100000, config->odr);
+    lsm9ds1_setup_gyro(lsm, config->gyro_scale);
+    lsm9ds1_setup_mag(lsm, config->mag_gain);
+    lsm9ds1_setup_mag_rate(lsm, config->mag_odr);
     
-    // Configuration par défaut
-    lsm9ds1_setup_accel(lsm, LSM9DS1_ACCELRANGE_2G, LSM9DS1_ACCELDATARATE_10HZ);
-    lsm9ds1_setup_gyro(lsm, LSM9DS1_GYROSCALE_245DPS);
-    lsm9ds1_setup_mag(lsm, LSM9DS1_MAGGAIN_4GAUSS);
+    // Vérifier que le capteur a bien accepté les valeurs
+    if (!lsm9ds1_read_config(lsm, &readback)) {
+        return false;
+    }
+    return readback.odr == config->odr &&
+           readback.accel_range == config->accel_range &&
+           readback.gyro_scale == config->gyro_scale &&
+           readback.mag_gain == config->mag_gain &&
+           readback.mag_odr == config->mag_odr;
+}
+
+// Relire la configuration depuis les registres du capteur
+bool lsm9ds1_read_config(lsm9ds1_t *lsm, lsm9ds1_config_t *config) {
+    uint8_t reg6_xl, reg1_g, reg1_m, reg2_m;
     
+    if (i2c_read_byte(lsm->dev_xg, LSM9DS1_REGISTER_CTRL_REG6_XL, &reg6_xl) < 0 ||
+        i2c_read_byte(lsm->dev_xg, LSM9DS1_REGISTER_CTRL_REG1_G, &reg1_g) < 0 ||
+        i2c_read_byte(lsm->dev_mag, LIS3MDL_REGISTER_CTRL_REG1, &reg1_m) < 0 ||
+        i2c_read_byte(lsm->dev_mag, LIS3MDL_REGISTER_CTRL_REG2, &reg2_m) < 0) {
+        return false;
+    }
+    
+    // L'ODR effectif est celui du gyroscope quand les deux sont actifs
+    config->odr = (lsm9ds1_accel_datarate_t)(reg1_g & 0b11100000);
+    config->accel_range = (lsm9ds1_accel_range_t)(reg6_xl & 0b00011000);
+    config->gyro_scale = (lsm9ds1_gyro_scale_t)(reg1_g & 0b00011000);
+    config->mag_gain = (lsm9ds1_mag_gain_t)((reg2_m >> 5) & 0x03);
+    config->mag_odr = (lsm9ds1_mag_datarate_t)(reg1_m & 0b00011100);
     return true;
 }
 
+// Fréquence nominale (Hz) d'un code ODR du magnétomètre
+float lsm9ds1_mag_odr_hz(lsm9ds1_mag_datarate_t odr) {
+    return 0.625f * (float)(1 << ((odr >> 2) & 0x07));
+}
+
+// Fréquence nominale (Hz) d'un code ODR accel/gyro
+float lsm9ds1_odr_hz(lsm9ds1_accel_datarate_t odr) {
+    switch (odr) {
+        case LSM9DS1_ACCELDATARATE_POWERDOWN: return 0.0f;
+        case LSM9DS1_ACCELDATARATE_10HZ:      return 14.9f;
+        case LSM9DS1_ACCELDATARATE_50HZ:      return 59.5f;
+        case LSM9DS1_ACCELDATARATE_119HZ:     return 119.0f;
+        case LSM9DS1_ACCELDATARATE_238HZ:     return 238.0f;
+        case LSM9DS1_ACCELDATARATE_476HZ:     return 476.0f;
+        case LSM9DS1_ACCELDATARATE_952HZ:     return 952.0f;
+    }
+    return 0.0f;
+}
+
 void lsm9ds1_close(lsm9ds1_t *lsm) {
-    if (lsm->fd_xg >= 0) close(lsm->fd_xg);
-    if (lsm->fd_mag >= 0) close(lsm->fd_mag);
+    i2c_bus_detach(lsm->dev_xg);
+    i2c_bus_detach(lsm->dev_mag);
+    lsm->dev_xg = lsm->dev_mag = -1;
 }
 
 void lsm9ds1_setup_accel(lsm9ds1_t *lsm, lsm9ds1_accel_range_t range, lsm9ds1_accel_datarate_t rate) {
     uint8_t reg;
-    i2c_read_byte(lsm->fd_xg, LSM9DS1_REGISTER_CTRL_REG6_XL, &reg);
+    i2c_read_byte(lsm->dev_xg, LSM9DS1_REGISTER_CTRL_REG6_XL, &reg);
     reg &= ~0b11111000;
     reg |= range | rate;
-    i2c_write_byte(lsm->fd_xg, LSM9DS1_REGISTER_CTRL_REG6_XL, reg);
+    i2c_write_byte(lsm->dev_xg, LSM9DS1_REGISTER_CTRL_REG6_XL, reg);
     
     // Mettre à jour le facteur de conversion
     switch(range) {
@@ -158,14 +186,15 @@ void lsm9ds1_setup_accel(lsm9ds1_t *lsm, lsm9ds1_accel_range_t range, lsm9ds1_ac
             lsm->accel_mg_lsb = LSM9DS1_ACCEL_MG_LSB_16G;
             break;
     }
+    lsm->accel_scale = lsm->accel_mg_lsb / 1000.0f * SENSORS_GRAVITY_STANDARD;
 }
 
 void lsm9ds1_setup_gyro(lsm9ds1_t *lsm, lsm9ds1_gyro_scale_t scale) {
     uint8_t reg;
-    i2c_read_byte(lsm->fd_xg, LSM9DS1_REGISTER_CTRL_REG1_G, &reg);
+    i2c_read_byte(lsm->dev_xg, LSM9DS1_REGISTER_CTRL_REG1_G, &reg);
     reg &= ~0b00011000;
     reg |= scale;
-    i2c_write_byte(lsm->fd_xg, LSM9DS1_REGISTER_CTRL_REG1_G, reg);
+    i2c_write_byte(lsm->dev_xg, LSM9DS1_REGISTER_CTRL_REG1_G, reg);
     
     switch(scale) {
         case LSM9DS1_GYROSCALE_245DPS:
@@ -178,11 +207,12 @@ void lsm9ds1_setup_gyro(lsm9ds1_t *lsm, lsm9ds1_gyro_scale_t scale) {
             lsm->gyro_dps_digit = LSM9DS1_GYRO_DPS_DIGIT_2000DPS;
             break;
     }
+    lsm->gyro_scale = lsm->gyro_dps_digit * SENSORS_DPS_TO_RADS;
 }
 
 void lsm9ds1_setup_mag(lsm9ds1_t *lsm, lsm9ds1_mag_gain_t gain) {
     uint8_t reg_value = (gain & 0x03) << 5;
-    i2c_write_byte(lsm->fd_mag, LIS3MDL_REGISTER_CTRL_REG2, reg_value);
+    i2c_write_byte(lsm->dev_mag, LIS3MDL_REGISTER_CTRL_REG2, reg_value);
     
     // Facteurs de conversion pour LIS3MDL
     switch(gain) {
@@ -199,26 +229,43 @@ void lsm9ds1_setup_mag(lsm9ds1_t *lsm, lsm9ds1_mag_gain_t gain) {
             lsm->mag_gauss_lsb = 1.0f / 1711.0f;
             break;
     }
+    lsm->mag_scale = lsm->mag_gauss_lsb * 100.0f;
 }
 
-bool lsm9ds1_read(lsm9ds1_t *lsm) {
+void lsm9ds1_setup_mag_rate(lsm9ds1_t *lsm, lsm9ds1_mag_datarate_t rate) {
+    i2c_update_bits(lsm->dev_mag, LIS3MDL_REGISTER_CTRL_REG1, 0b00011100, rate);
+    
+    // Le groupe mag suit l'ODR du LIS3MDL : relire plus souvent est inutile
+    lsm9ds1_set_group_period(lsm, LSM9DS1_GROUP_MAG,
+                             (uint32_t)(1000000.0f / lsm9ds1_mag_odr_hz(rate)));
+}
+
+// Octets transférés sur le bus par lecture de groupe
+// (adresse W + registre + adresse R + données, par transaction)
+static const unsigned int group_bytes[LSM9DS1_NUM_GROUPS] = {
+    [LSM9DS1_GROUP_XG]   = 2 * (3 + 6),
+    [LSM9DS1_GROUP_MAG]  = 3 + 6,
+    [LSM9DS1_GROUP_TEMP] = 3 + 2,
+};
+
+static bool read_xg(lsm9ds1_t *lsm) {
     uint8_t buffer[6];
     
     // Lire l'accéléromètre
-    if (i2c_read_block(lsm->fd_xg, LSM9DS1_REGISTER_OUT_X_L_XL, buffer, 6) < 0) {
+    if (i2c_read_block(lsm->dev_xg, LSM9DS1_REGISTER_OUT_X_L_XL, buffer, 6) < 0) {
         return false;
     }
     lsm->accel_raw[0] = (int16_t)((buffer[1] << 8) | buffer[0]);
     lsm->accel_raw[1] = (int16_t)((buffer[3] << 8) | buffer[2]);
     lsm->accel_raw[2] = (int16_t)((buffer[5] << 8) | buffer[4]);
     
-    // Convertir en m/s²
-    lsm->acceleration.x = (lsm->accel_raw[0] * lsm->accel_mg_lsb / 1000.0f) * SENSORS_GRAVITY_STANDARD;
-    lsm->acceleration.y = (lsm->accel_raw[1] * lsm->accel_mg_lsb / 1000.0f) * SENSORS_GRAVITY_STANDARD;
-    lsm->acceleration.z = (lsm->accel_raw[2] * lsm->accel_mg_lsb / 1000.0f) * SENSORS_GRAVITY_STANDARD;
+    // Convertir en m/s² (un seul produit par axe)
+    lsm->acceleration.x = lsm->accel_raw[0] * lsm->accel_scale;
+    lsm->acceleration.y = lsm->accel_raw[1] * lsm->accel_scale;
+    lsm->acceleration.z = lsm->accel_raw[2] * lsm->accel_scale;
     
     // Lire le gyroscope
-    if (i2c_read_block(lsm->fd_xg, LSM9DS1_REGISTER_OUT_X_L_G, buffer, 6) < 0) {
+    if (i2c_read_block(lsm->dev_xg, LSM9DS1_REGISTER_OUT_X_L_G, buffer, 6) < 0) {
         return false;
     }
     lsm->gyro_raw[0] = (int16_t)((buffer[1] << 8) | buffer[0]);
@@ -226,12 +273,17 @@ bool lsm9ds1_read(lsm9ds1_t *lsm) {
     lsm->gyro_raw[2] = (int16_t)((buffer[5] << 8) | buffer[4]);
     
     // Convertir en rad/s
-    lsm->gyro.x = lsm->gyro_raw[0] * lsm->gyro_dps_digit * SENSORS_DPS_TO_RADS;
-    lsm->gyro.y = lsm->gyro_raw[1] * lsm->gyro_dps_digit * SENSORS_DPS_TO_RADS;
-    lsm->gyro.z = lsm->gyro_raw[2] * lsm->gyro_dps_digit * SENSORS_DPS_TO_RADS;
+    lsm->gyro.x = lsm->gyro_raw[0] * lsm->gyro_scale;
+    lsm->gyro.y = lsm->gyro_raw[1] * lsm->gyro_scale;
+    lsm->gyro.z = lsm->gyro_raw[2] * lsm->gyro_scale;
+    
+    return true;
+}
+
+static bool read_mag(lsm9ds1_t *lsm) {
+    uint8_t buffer[6];
     
-    // Lire le magnétomètre
-    if (i2c_read_block(lsm->fd_mag, LIS3MDL_REGISTER_OUT_X_L, buffer, 6) < 0) {
+    if (i2c_read_block(lsm->dev_mag, LIS3MDL_REGISTER_OUT_X_L, buffer, 6) < 0) {
         return false;
     }
     lsm->mag_raw[0] = (int16_t)((buffer[1] << 8) | buffer[0]);
@@ -239,17 +291,82 @@ bool lsm9ds1_read(lsm9ds1_t *lsm) {
     lsm->mag_raw[2] = (int16_t)((buffer[5] << 8) | buffer[4]);
     
     // Convertir en uT (microTesla)
-    lsm->magnetic.x = lsm->mag_raw[0] * lsm->mag_gauss_lsb * 100.0f;
-    lsm->magnetic.y = lsm->mag_raw[1] * lsm->mag_gauss_lsb * 100.0f;
-    lsm->magnetic.z = lsm->mag_raw[2] * lsm->mag_gauss_lsb * 100.0f;
+    lsm->magnetic.x = lsm->mag_raw[0] * lsm->mag_scale;
+    lsm->magnetic.y = lsm->mag_raw[1] * lsm->mag_scale;
+    lsm->magnetic.z = lsm->mag_raw[2] * lsm->mag_scale;
     
-    // Lire la température
+    return true;
+}
+
+static bool read_temp(lsm9ds1_t *lsm) {
     uint8_t temp_buffer[2];
-    if (i2c_read_block(lsm->fd_xg, LSM9DS1_REGISTER_TEMP_OUT_L, temp_buffer, 2) < 0) {
+    
+    if (i2c_read_block(lsm->dev_xg, LSM9DS1_REGISTER_TEMP_OUT_L, temp_buffer, 2) < 0) {
         return false;
     }
     lsm->temp_raw = (int16_t)((temp_buffer[1] << 8) | temp_buffer[0]);
-    lsm->temperature = 21.0f + (float)lsm->temp_raw / 8.0f;
+    lsm->temperature = LSM9DS1_TEMP_OFFSET_C + (float)lsm->temp_raw / LSM9DS1_TEMP_LSB_PER_C;
     
     return true;
 }
+
+// Lecture complète (tous les groupes), sans ordonnancement
+bool lsm9ds1_read(lsm9ds1_t *lsm) {
+    return read_xg(lsm) && read_mag(lsm) && read_temp(lsm);
+}
+
+// ---------------------------
+// Ordonnanceur multi-fréquence : ne lit que les groupes dont la période est
+// écoulée. Les échéances s'accumulent (next_due += période) pour que la
+// fréquence moyenne soit exacte; une tolérance d'un quart de période évite
+// de rater une échéance à cause de la gigue de l'appelant.
+// Retourne le masque des groupes lus (1 << groupe), ou -1 en cas d'erreur.
+// ---------------------------
+int lsm9ds1_poll(lsm9ds1_t *lsm, uint64_t now_us) {
+    static bool (*const readers[LSM9DS1_NUM_GROUPS])(lsm9ds1_t *) = {
+        [LSM9DS1_GROUP_XG]   = read_xg,
+        [LSM9DS1_GROUP_MAG]  = read_mag,
+        [LSM9DS1_GROUP_TEMP] = read_temp,
+    };
+    int mask = 0;
+    
+    for (int g = 0; g < LSM9DS1_NUM_GROUPS; g++) {
+        lsm9ds1_group_state_t *st = &lsm->groups[g];
+        
+        if (st->reads > 0 && now_us + st->period_us / 4 < st->next_due_us) {
+            st->skipped++;
+            st->bytes_saved += group_bytes[g];
+            continue;
+        }
+        
+        if (!readers[g](lsm)) {
+            st->errors++;
+            return -1;
+        }
+        
+        if (st->reads == 0) st->first_read_us = now_us;
+        st->reads++;
+        st->bytes += group_bytes[g];
+        st->last_read_us = now_us;
+        st->next_due_us += st->period_us;
+        if (st->next_due_us + st->period_us < now_us) {
+            st->next_due_us = now_us + st->period_us;  // Resynchroniser après un retard
+        }
+        mask |= 1 << g;
+    }
+    
+    return mask;
+}
+
+void lsm9ds1_set_group_period(lsm9ds1_t *lsm, lsm9ds1_group_t group, uint32_t period_us) {
+    lsm->groups[group].period_us = period_us;
+    lsm->groups[group].next_due_us = 0;
+}
+
+void lsm9ds1_reset_group_stats(lsm9ds1_t *lsm) {
+    for (int g = 0; g < LSM9DS1_NUM_GROUPS; g++) {
+        uint32_t period = lsm->groups[g].period_us;
+        memset(&lsm->groups[g], 0, sizeof(lsm9ds1_group_state_t));
+        lsm->groups[g].period_us = period;
+    }
+}
@@ -3,12 +3,17 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 // Adresses I2C
 #define LSM9DS1_ADDRESS_ACCELGYRO  0x6B
 #define LSM9DS1_ADDRESS_MAG        0x1E
 #define LSM9DS1_XG_ID              0x68
 
+// Constantes de conversion
+#define SENSORS_GRAVITY_STANDARD 9.80665f
+#define SENSORS_DPS_TO_RADS      0.017453293f
+
 // Registres Accel/Gyro
 #define LSM9DS1_REGISTER_WHO_AM_I_XG    0x0F
 #define LSM9DS1_REGISTER_CTRL_REG1_G    0x10
@@ -61,6 +66,54 @@ typedef enum {
     LSM9DS1_MAGGAIN_16GAUSS = 3
 } lsm9ds1_mag_gain_t;
 
+// Fréquences de données du magnétomètre (LIS3MDL CTRL_REG1, bits DO)
+typedef enum {
+    LSM9DS1_MAGDATARATE_0_625HZ = (0b000 << 2),
+    LSM9DS1_MAGDATARATE_1_25HZ  = (0b001 << 2),
+    LSM9DS1_MAGDATARATE_2_5HZ   = (0b010 << 2),
+    LSM9DS1_MAGDATARATE_5HZ     = (0b011 << 2),
+    LSM9DS1_MAGDATARATE_10HZ    = (0b100 << 2),
+    LSM9DS1_MAGDATARATE_20HZ    = (0b101 << 2),
+    LSM9DS1_MAGDATARATE_40HZ    = (0b110 << 2),
+    LSM9DS1_MAGDATARATE_80HZ    = (0b111 << 2)
+} lsm9ds1_mag_datarate_t;
+
+// Configuration complète du capteur (accel et gyro partagent l'ODR)
+typedef struct {
+    lsm9ds1_accel_datarate_t odr;
+    lsm9ds1_accel_range_t accel_range;
+    lsm9ds1_gyro_scale_t gyro_scale;
+    lsm9ds1_mag_gain_t mag_gain;
+    lsm9ds1_mag_datarate_t mag_odr;
+} lsm9ds1_config_t;
+
+// Groupes de canaux lus à des fréquences différentes
+typedef enum {
+    LSM9DS1_GROUP_XG = 0,   // Accel + gyro
+    LSM9DS1_GROUP_MAG,
+    LSM9DS1_GROUP_TEMP,
+    LSM9DS1_NUM_GROUPS
+} lsm9ds1_group_t;
+
+#define LSM9DS1_TEMP_PERIOD_US 1000000
+
+// Température : 21 °C + brut / 8
+#define LSM9DS1_TEMP_OFFSET_C   21.0f
+#define LSM9DS1_TEMP_LSB_PER_C  8.0f
+
+// État et statistiques de l'ordonnanceur pour un groupe
+typedef struct {
+    uint32_t period_us;         // 0 = à chaque appel de lsm9ds1_poll
+    uint64_t next_due_us;
+    uint64_t first_read_us;
+    uint64_t last_read_us;      // Fraîcheur de la dernière lecture
+    unsigned long reads;
+    unsigned long skipped;
+    unsigned long errors;
+    unsigned long long bytes;        // Octets transférés sur le bus
+    unsigned long long bytes_saved;  // Octets évités par rapport à tout lire
+} lsm9ds1_group_state_t;
+
 // Structure pour les données 3 axes
 typedef struct {
     float x;
@@ -70,12 +123,17 @@ typedef struct {
 
 // Structure principale du capteur
 typedef struct {
-    int fd_xg;          // File descriptor pour accel/gyro
-    int fd_mag;         // File descriptor pour magnétomètre
+    int dev_xg;         // Handle i2c_bus pour accel/gyro
+    int dev_mag;        // Handle i2c_bus pour magnétomètre
     float accel_mg_lsb;
     float gyro_dps_digit;
     float mag_gauss_lsb;
     
+    // Facteurs précalculés (unités SI par LSB), mis à jour par setup_*
+    float accel_scale;      // m/s² par LSB
+    float gyro_scale;       // rad/s par LSB
+    float mag_scale;        // uT par LSB
+    
     // Données brutes
     int16_t accel_raw[3];
     int16_t gyro_raw[3];
@@ -87,15 +145,54 @@ typedef struct {
     vector3_t gyro;         // rad/s
     vector3_t magnetic;     // uT
     float temperature;      // °C
+    
+    // Ordonnancement multi-fréquence
+    lsm9ds1_group_state_t groups[LSM9DS1_NUM_GROUPS];
 } lsm9ds1_t;
 
+// Bloc d'échantillons en structure de tableaux (SoA) pour la conversion par
+// lots (pages de l'historique IMU); tous partagent les mêmes facteurs
+#define LSM9DS1_BLOCK_SIZE 64
+
+typedef enum {
+    LSM9DS1_AXIS_AX = 0, LSM9DS1_AXIS_AY, LSM9DS1_AXIS_AZ,
+    LSM9DS1_AXIS_GX, LSM9DS1_AXIS_GY, LSM9DS1_AXIS_GZ,
+    LSM9DS1_AXIS_MX, LSM9DS1_AXIS_MY, LSM9DS1_AXIS_MZ,
+    LSM9DS1_NUM_AXES
+} lsm9ds1_axis_t;
+
+typedef struct {
+    size_t count;
+    float accel_scale;
+    float gyro_scale;
+    float mag_scale;
+    int16_t raw[LSM9DS1_NUM_AXES][LSM9DS1_BLOCK_SIZE] __attribute__((aligned(32)));
+    float si[LSM9DS1_NUM_AXES][LSM9DS1_BLOCK_SIZE] __attribute__((aligned(32)));
+} lsm9ds1_block_t;
+
 // Fonctions principales
-bool lsm9ds1_init(lsm9ds1_t *lsm, const char *i2c_bus);
+bool lsm9ds1_init(lsm9ds1_t *lsm, const char *i2c_bus, const lsm9ds1_config_t *config);
 void lsm9ds1_close(lsm9ds1_t *lsm);
 bool lsm9ds1_read(lsm9ds1_t *lsm);
+int lsm9ds1_poll(lsm9ds1_t *lsm, uint64_t now_us);
+void lsm9ds1_set_group_period(lsm9ds1_t *lsm, lsm9ds1_group_t group, uint32_t period_us);
+void lsm9ds1_reset_group_stats(lsm9ds1_t *lsm);
 void lsm9ds1_setup_accel(lsm9ds1_t *lsm, lsm9ds1_accel_range_t range, lsm9ds1_accel_datarate_t rate);
 void lsm9ds1_setup_gyro(lsm9ds1_t *lsm, lsm9ds1_gyro_scale_t scale);
 void lsm9ds1_setup_mag(lsm9ds1_t *lsm, lsm9ds1_mag_gain_t gain);
+void lsm9ds1_setup_mag_rate(lsm9ds1_t *lsm, lsm9ds1_mag_datarate_t rate);
+bool lsm9ds1_configure(lsm9ds1_t *lsm, const lsm9ds1_config_t *config);
+bool lsm9ds1_read_config(lsm9ds1_t *lsm, lsm9ds1_config_t *config);
+float lsm9ds1_odr_hz(lsm9ds1_accel_datarate_t odr);
+float lsm9ds1_mag_odr_hz(lsm9ds1_mag_datarate_t odr);
+
+// Conversion par lots : raw -> si pour les 'count' premiers échantillons
+void lsm9ds1_block_convert(lsm9ds1_block_t *block);
+
+// Noyaux de conversion int16 -> float (out[i] = in[i] * scale)
+void lsm9ds1_convert_i16(const int16_t *in, float *out, size_t n, float scale);
+void lsm9ds1_convert_i16_scalar(const int16_t *in, float *out, size_t n, float scale);
+const char *lsm9ds1_convert_impl(void);
 
 #endif // LSM9DS1_H
 
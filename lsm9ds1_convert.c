@@ -0,0 +1,86 @@
+#include "lsm9ds1.h"
+#include <string.h>
+
+// Sélection du noyau vectoriel à la compilation (LSM9DS1_NO_SIMD force le scalaire)
+#if !defined(LSM9DS1_NO_SIMD) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CONVERT_NEON
+#elif !defined(LSM9DS1_NO_SIMD) && defined(__AVX2__)
+#include <immintrin.h>
+#define CONVERT_AVX2
+#elif !defined(LSM9DS1_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#define CONVERT_SSE2
+#endif
+
+// ---------------------------
+// Référence scalaire : int16 -> float exact, puis un seul produit arrondi
+// ---------------------------
+void lsm9ds1_convert_i16_scalar(const int16_t *in, float *out, size_t n, float scale) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = (float)in[i] * scale;
+    }
+}
+
+// ---------------------------
+// Noyau vectoriel : mêmes opérations que la référence, donc bit à bit identique
+// ---------------------------
+void lsm9ds1_convert_i16(const int16_t *in, float *out, size_t n, float scale) {
+    size_t i = 0;
+
+#if defined(CONVERT_NEON)
+    float32x4_t vscale = vdupq_n_f32(scale);
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t v = vld1q_s16(in + i);
+        float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v)));
+        float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v)));
+        vst1q_f32(out + i, vmulq_f32(lo, vscale));
+        vst1q_f32(out + i + 4, vmulq_f32(hi, vscale));
+    }
+#elif defined(CONVERT_AVX2)
+    __m256 vscale = _mm256_set1_ps(scale);
+    for (; i + 16 <= n; i += 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(in + i));
+        __m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(v)));
+        __m256 hi = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(v, 1)));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(lo, vscale));
+        _mm256_storeu_ps(out + i + 8, _mm256_mul_ps(hi, vscale));
+    }
+#elif defined(CONVERT_SSE2)
+    __m128 vscale = _mm_set1_ps(scale);
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+        // Extension de signe : dupliquer chaque mot puis décaler arithmétiquement
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), vscale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), vscale));
+    }
+#endif
+
+    // Reste (ou tout le bloc sans SIMD)
+    lsm9ds1_convert_i16_scalar(in + i, out + i, n - i, scale);
+}
+
+const char *lsm9ds1_convert_impl(void) {
+#if defined(CONVERT_NEON)
+    return "neon";
+#elif defined(CONVERT_AVX2)
+    return "avx2";
+#elif defined(CONVERT_SSE2)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+// ---------------------------
+// Convertir tout le bloc en unités SI (un appel de noyau par axe)
+// ---------------------------
+void lsm9ds1_block_convert(lsm9ds1_block_t *block) {
+    for (int axis = 0; axis < LSM9DS1_NUM_AXES; axis++) {
+        float scale = axis < LSM9DS1_AXIS_GX ? block->accel_scale :
+                      axis < LSM9DS1_AXIS_MX ? block->gyro_scale : block->mag_scale;
+        lsm9ds1_convert_i16(block->raw[axis], block->si[axis], block->count, scale);
+    }
+}
@@ -4,15 +4,36 @@
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <signal.h>
-#include "pwm.h"
-#include "imu.h"
-#include "sonar.h"
+#include <stdint.h>
+#include <time.h>
+#include "module.h"
+#include "scheduler.h"
+#include "hal.h"
+#include "recorder.h"
+#include "replay.h"
+#include "trace.h"
+#include "metrics.h"
+#include "rt.h"
+#include "net_server.h"
 
 // Server Configuration
 #define SERVER_IP "0.0.0.0"
 #define SERVER_PORT 5000
+#define RESPONSE_BUFFER_SIZE 65536  // Large enough for IMU history pages
 
 static volatile int running = 1;
+static int use_sched = 0;
+static uint64_t start_us = 0;
+
+static uint64_t get_time_microseconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static double ms_since_start(void) {
+    return (get_time_microseconds() - start_us) / 1000.0;
+}
 
 void signal_handler(int sig) {
     (void)sig;
@@ -21,121 +42,133 @@ void signal_handler(int sig) {
 }
 
 // ---------------------------
-// Handle client connection
+// Handle one command line (called by the network backend)
 // ---------------------------
-void handle_client(int client_fd, int i2c_fd) {
-    char buffer[256];
-    char response[1024];
-    memset(buffer, 0, sizeof(buffer));
-    int total = 0;
-    int n;
-
-    while(total < sizeof(buffer)-1 && (n = read(client_fd, buffer+total, 1)) > 0) {
-        if(buffer[total] == '\n') break;
-        total += n;
-    }
-    buffer[total] = '\0';
-
-    if (total > 0) {
-        printf("Received: %s\n", buffer);
-
-        // Command routing
-        if (strncmp(buffer, "IMU", 3) == 0) {
-            // IMU command: "IMU <command>"
-            char *imu_cmd = buffer + 3;
-            while (*imu_cmd == ' ') imu_cmd++;
-            
-            if (execute_imu_command(imu_cmd, response, sizeof(response)) == 0) {
-                write(client_fd, response, strlen(response));
-            } else {
-                write(client_fd, response, strlen(response));
-            }
-        }
-        else if (strncmp(buffer, "SONAR", 5) == 0) {
-            // SONAR command: "SONAR <command>"
-            char *sonar_cmd = buffer + 5;
-            while (*sonar_cmd == ' ') sonar_cmd++;
-            
-            if (execute_sonar_command(sonar_cmd, response, sizeof(response)) == 0) {
-                write(client_fd, response, strlen(response));
-            } else {
-                write(client_fd, response, strlen(response));
-            }
-        }
-        else if (strncmp(buffer, "PWM", 3) == 0) {
-            // PWM command: "PWM <command>"
-            char *pwm_cmd = buffer + 3;
-            while (*pwm_cmd == ' ') pwm_cmd++;
-            
-            if (execute_pwm_command(i2c_fd, pwm_cmd) == 0) {
-                write(client_fd, "OK\n", 3);
-            } else {
-                write(client_fd, "ERROR\n", 6);
-            }
-        }
-        else {
-            // Default: assume PWM command for backward compatibility
-            if (execute_pwm_command(i2c_fd, buffer) == 0) {
-                write(client_fd, "OK\n", 3);
-            } else {
-                write(client_fd, "ERROR\n", 6);
-            }
-        }
+size_t handle_command(char *buffer, char *response, size_t response_size, void *ctx) {
+    (void)ctx;
+
+    printf("Received: %s\n", buffer);
+    response[0] = '\0';
+
+    // Control and telemetry commands run on different threads
+    static int served = 0;
+    if (!__atomic_exchange_n(&served, 1, __ATOMIC_RELAXED)) {
+        printf("First command served %.1f ms after start\n", ms_since_start());
     }
+
+    // Routed by command prefix through the module registry
+    uint64_t t0 = trace_begin();
+    size_t len = modules_dispatch(buffer, response, response_size);
+    trace_end("handle_command", t0);
+    return len;
+}
+
+// Actuator modules (module_t.control) go ahead of telemetry
+static net_class_t classify_command(const char *line, void *ctx) {
+    (void)ctx;
+    return modules_is_control(line) ? NET_CLASS_CONTROL : NET_CLASS_TELEMETRY;
 }
 
 // ---------------------------
 // Main server loop
 // ---------------------------
-int main() {
-    int server_fd, client_fd;
+int main(int argc, char *argv[]) {
+    int server_fd;
     struct sockaddr_in addr;
+    int use_uring = 0;
+    const char *record_prefix = NULL;
+    char *replay_list = NULL;
+    float replay_speed = 1.0f;
+    int metrics_port = 0;
+    char metrics_ip[16] = METRICS_IP;
+    int use_rt = 0;
+    int use_qos = 1;
+    long telemetry_rate = NET_TELEMETRY_RATE;
 
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
+    start_us = get_time_microseconds();
 
-    // Initialize PWM controller
-    printf("Initializing PWM controller...\n");
-    int i2c_fd = init_pwm_controller();
-    if (i2c_fd < 0) {
-        fprintf(stderr, "Failed to initialize PWM controller\n");
-        return 1;
-    }
-    printf("PWM controller initialized\n");
-
-    // Initialize IMU controller
-    printf("Initializing IMU controller...\n");
-    if (init_imu_controller() < 0) {
-        fprintf(stderr, "Warning: Failed to initialize IMU\n");
-    } else {
-        printf("IMU controller initialized\n");
-        if (start_imu_thread() < 0) {
-            fprintf(stderr, "Warning: Failed to start IMU thread\n");
+    // --sched: run the sensor loops as tasks of one scheduler thread (the
+    //     sonar keeps its own, see sonar.c)
+    // --uring: serve clients through io_uring (falls back if unavailable)
+    // --disable <name>[,<name>...]: leave modules off (e.g. no sonar fitted)
+    // --emulate: run against emulated chips (hal_emu.c) on a dev box
+    // --record <prefix>: record telemetry from startup (see "REC")
+    // --record-dir <dir>: where "REC start <name>" records (default recordings)
+    // --replay <file>[,<file>...]: play a recording back in place of the
+    //     sensors, on emulated chips; --replay-speed <x>|max sets the pace
+    // --metrics [<addr>:]<port>: serve Prometheus metrics over HTTP (see
+    //     metrics.h), on all interfaces unless an address is given
+    // --rt: real-time profile for the sampler threads (see rt.h)
+    // --telemetry-rate <KiB/s>: response bytes per client for telemetry
+    //     commands, 0 for no limit; --no-qos serves every command in
+    //     arrival order on one thread (see net_server_set_qos())
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--sched") == 0) {
+            use_sched = 1;
+        } else if (strcmp(argv[i], "--rt") == 0) {
+            use_rt = 1;
+        } else if (strcmp(argv[i], "--uring") == 0) {
+            use_uring = 1;
+        } else if (strcmp(argv[i], "--emulate") == 0) {
+            hal_use_emulated(NULL);
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record_prefix = argv[++i];
+        } else if (strcmp(argv[i], "--record-dir") == 0 && i + 1 < argc) {
+            if (recorder_set_dir(argv[++i]) < 0) {
+                fprintf(stderr, "Recording directory name too long\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_list = argv[++i];
+            hal_use_emulated(NULL);
+        } else if (strcmp(argv[i], "--replay-speed") == 0 && i + 1 < argc) {
+            i++;
+            replay_speed = strcmp(argv[i], "max") == 0 ? 0.0f : strtof(argv[i], NULL);
+        } else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+            const char *value = argv[++i];
+            const char *colon = strrchr(value, ':');
+            if (colon) {
+                snprintf(metrics_ip, sizeof(metrics_ip), "%.*s", (int)(colon - value), value);
+                value = colon + 1;
+            }
+            metrics_port = atoi(value);
+        } else if (strcmp(argv[i], "--telemetry-rate") == 0 && i + 1 < argc) {
+            telemetry_rate = atol(argv[++i]) * 1024;
+        } else if (strcmp(argv[i], "--no-qos") == 0) {
+            use_qos = 0;
+        } else if (strcmp(argv[i], "--disable") == 0 && i + 1 < argc) {
+            for (char *name = strtok(argv[++i], ","); name; name = strtok(NULL, ",")) {
+                if (modules_disable(name) < 0) {
+                    fprintf(stderr, "Unknown module '%s'\n", name);
+                    return 1;
+                }
+            }
         } else {
-            printf("IMU thread started\n");
+            fprintf(stderr, "Usage: %s [--sched] [--rt] [--uring] [--emulate] [--record <prefix>]\n"
+                            "       [--record-dir <dir>]\n"
+                            "       [--replay <file>[,<file>...] [--replay-speed <x>|max]]\n"
+                            "       [--metrics [<addr>:]<port>] [--telemetry-rate <KiB/s>] [--no-qos]\n"
+                            "       [--disable <module>[,<module>...]]\n", argv[0]);
+            return 1;
         }
     }
 
-    // Initialize SONAR controller
-    printf("Initializing SONAR controller...\n");
-    if (init_sonar_controller() < 0) {
-        fprintf(stderr, "Warning: Failed to initialize SONAR\n");
-    } else {
-        printf("SONAR controller initialized\n");
-        if (start_sonar_thread() < 0) {
-            fprintf(stderr, "Warning: Failed to start SONAR thread\n");
-        } else {
-            printf("SONAR thread started\n");
-        }
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+    // A client closing before its reply is written is an error on that
+    // socket, not a reason to stop the car
+    signal(SIGPIPE, SIG_IGN);
+
+    // Before any sampler thread starts, so they all get the profile
+    if (use_rt) {
+        rt_enable();
     }
 
-    // Create server socket
+    // Open the listener first; commands to devices still coming up get
+    // an "initializing" error instead of waiting in the backlog
     server_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (server_fd < 0) {
         perror("Failed to create socket");
-        close_sonar_controller();
-        close_imu_controller();
-        close_pwm_controller(i2c_fd);
         return 1;
     }
 
@@ -149,49 +182,80 @@ int main() {
     if (bind(server_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
         perror("Failed to bind socket");
         close(server_fd);
-        close_sonar_controller();
-        close_imu_controller();
-        close_pwm_controller(i2c_fd);
         return 1;
     }
 
     if (listen(server_fd, 5) < 0) {
         perror("Failed to listen");
         close(server_fd);
-        close_sonar_controller();
-        close_imu_controller();
-        close_pwm_controller(i2c_fd);
         return 1;
     }
 
-    printf("Server listening on %s:%d\n", SERVER_IP, SERVER_PORT);
-    printf("\nCommand formats:\n");
-    printf("  PWM:   <pwm%%> | PWM <pwm%%> | PWM -c <ch> <pwm%%>\n");
-    printf("  IMU:   IMU read | IMU raw | IMU orientation\n");
-    printf("  SONAR: SONAR read | SONAR distance | SONAR status\n");
-    printf("\nReady to accept commands\n");
-
     struct timeval tv;
     tv.tv_sec = 1;
     tv.tv_usec = 0;
     setsockopt(server_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
 
-    while(running) {
-        client_fd = accept(server_fd, NULL, NULL);
-        if (client_fd < 0) {
-            if (running) continue;
-            else break;
+    printf("Server listening on %s:%d after %.1f ms (%s backend)\n",
+           SERVER_IP, SERVER_PORT, ms_since_start(), hal_backend_name());
+
+    // Tasks may register while the scheduler is already running
+    if (use_sched) {
+        if (sched_init() < 0 || sched_start() < 0) {
+            fprintf(stderr, "Warning: Failed to start scheduler, using threads\n");
+            use_sched = 0;
+        } else {
+            printf("Scheduler started\n");
         }
+    }
 
-        handle_client(client_fd, i2c_fd);
-        close(client_fd);
+    if (replay_list) {
+        const char *paths[REPLAY_MAX_FILES];
+        int count = 0;
+        for (char *path = strtok(replay_list, ","); path && count < REPLAY_MAX_FILES;
+             path = strtok(NULL, ",")) {
+            paths[count++] = path;
+        }
+        if (replay_configure(paths, count, replay_speed) < 0) {
+            fprintf(stderr, "Cannot replay %s\n", replay_list);
+            return 1;
+        }
+    }
+
+    // Before the sensors start so their first samples are kept
+    if (record_prefix && recorder_start(record_prefix, 0) < 0) {
+        fprintf(stderr, "Warning: Telemetry recording not started\n");
+    }
+
+    // Bring up all enabled modules concurrently
+    modules_start(use_sched, start_us, &running);
+
+    if (metrics_port > 0 && metrics_start(metrics_ip, metrics_port) < 0) {
+        fprintf(stderr, "Warning: Metrics endpoint not started\n");
+    }
+
+    if (use_qos) {
+        net_server_set_qos(classify_command, telemetry_rate > 0 ? (uint32_t)telemetry_rate : 0,
+                           telemetry_rate > 0 ? NET_TELEMETRY_BURST : 0);
+    }
+
+    printf("\nCommand formats:\n");
+    modules_print_usage();
+    printf("\nReady to accept commands\n");
+
+    if (!use_uring ||
+        net_serve_uring(server_fd, &running, handle_command, NULL, RESPONSE_BUFFER_SIZE) < 0) {
+        if (use_uring) {
+            printf("Falling back to blocking socket I/O\n");
+        }
+        net_serve_blocking(server_fd, &running, handle_command, NULL, RESPONSE_BUFFER_SIZE);
     }
 
     printf("Cleaning up...\n");
     close(server_fd);
-    close_sonar_controller();
-    close_imu_controller();
-    close_pwm_controller(i2c_fd);
+    metrics_stop();
+    modules_shutdown();
+    sched_stop();
     printf("Server stopped\n");
     
     return 0;
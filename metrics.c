@@ -0,0 +1,348 @@
+#include "metrics.h"
+#include "module.h"
+#include "i2c_bus.h"
+#include "scheduler.h"
+#include "net_server.h"
+#ifndef MODULE_NO_IMU
+#include "imu.h"
+#endif
+#ifndef MODULE_NO_SONAR
+#include "sonar.h"
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+
+// Static variables
+static pthread_t metrics_thread;
+static volatile int thread_running = 0;
+static int listen_fd = -1;
+
+// ---------------------------
+// Sensors: achieved rates come from rate() over the sample counters
+// ---------------------------
+static void render_sensors(FILE *out) {
+#ifndef MODULE_NO_IMU
+    imu_counters_t imu;
+    imu_get_counters(&imu);
+    fprintf(out, "# HELP vehicule_imu_samples_total IMU samples published.\n"
+                 "# TYPE vehicule_imu_samples_total counter\n"
+                 "vehicule_imu_samples_total %lu\n", imu.samples);
+    fprintf(out, "# HELP vehicule_imu_overruns_total IMU read periods that missed their deadline.\n"
+                 "# TYPE vehicule_imu_overruns_total counter\n"
+                 "vehicule_imu_overruns_total %lu\n", imu.overruns);
+    fprintf(out, "# HELP vehicule_imu_poll_rate_hz Configured IMU poll rate.\n"
+                 "# TYPE vehicule_imu_poll_rate_hz gauge\n"
+                 "vehicule_imu_poll_rate_hz %d\n", imu.poll_rate_hz);
+#endif
+#ifndef MODULE_NO_SONAR
+    sonar_counters_t sonar;
+    sonar_get_counters(&sonar);
+    fprintf(out, "# HELP vehicule_sonar_measurements_total Sonar measurements published.\n"
+                 "# TYPE vehicule_sonar_measurements_total counter\n"
+                 "vehicule_sonar_measurements_total %lu\n", sonar.measurements);
+    fprintf(out, "# HELP vehicule_sonar_invalid_total Sonar measurements without a valid echo.\n"
+                 "# TYPE vehicule_sonar_invalid_total counter\n"
+                 "vehicule_sonar_invalid_total %lu\n", sonar.invalid);
+#endif
+    (void)out;
+}
+
+// ---------------------------
+// I2C bus and devices ("I2C reset" restarts these counters)
+// ---------------------------
+static void render_i2c(FILE *out) {
+    i2c_bus_stats_t bus;
+    i2c_device_stats_t devices[I2C_BUS_MAX_DEVICES];
+    int count = i2c_bus_get_stats(&bus, devices, I2C_BUS_MAX_DEVICES);
+
+    fprintf(out, "# HELP vehicule_i2c_busy_seconds_total Time spent in I2C transfers.\n"
+                 "# TYPE vehicule_i2c_busy_seconds_total counter\n"
+                 "vehicule_i2c_busy_seconds_total %.6f\n", bus.busy_us / 1e6);
+    fprintf(out, "# HELP vehicule_i2c_transactions_total I2C register transactions per device.\n"
+                 "# TYPE vehicule_i2c_transactions_total counter\n");
+    for (int i = 0; i < count; i++) {
+        fprintf(out, "vehicule_i2c_transactions_total{device=\"%s\"} %lu\n",
+                devices[i].name, devices[i].transactions);
+    }
+    fprintf(out, "# HELP vehicule_i2c_errors_total Failed I2C transactions per device.\n"
+                 "# TYPE vehicule_i2c_errors_total counter\n");
+    for (int i = 0; i < count; i++) {
+        fprintf(out, "vehicule_i2c_errors_total{device=\"%s\"} %lu\n",
+                devices[i].name, devices[i].errors);
+    }
+    fprintf(out, "# HELP vehicule_i2c_queue_max_seconds Longest wait for the bus per device.\n"
+                 "# TYPE vehicule_i2c_queue_max_seconds gauge\n");
+    for (int i = 0; i < count; i++) {
+        fprintf(out, "vehicule_i2c_queue_max_seconds{device=\"%s\"} %.6f\n",
+                devices[i].name, devices[i].queue_max_us / 1e6);
+    }
+}
+
+// ---------------------------
+// Scheduler tasks (--sched)
+// ---------------------------
+static void render_sched(FILE *out) {
+    sched_task_stats_t tasks[SCHED_MAX_TASKS];
+    int count = sched_get_stats(tasks, SCHED_MAX_TASKS);
+    if (count <= 0) {
+        return;
+    }
+
+    fprintf(out, "# HELP vehicule_sched_runs_total Scheduler task runs.\n"
+                 "# TYPE vehicule_sched_runs_total counter\n");
+    for (int i = 0; i < count; i++) {
+        fprintf(out, "vehicule_sched_runs_total{task=\"%s\"} %lu\n", tasks[i].name, tasks[i].runs);
+    }
+    fprintf(out, "# HELP vehicule_sched_deadline_misses_total Runs started after the next release.\n"
+                 "# TYPE vehicule_sched_deadline_misses_total counter\n");
+    for (int i = 0; i < count; i++) {
+        fprintf(out, "vehicule_sched_deadline_misses_total{task=\"%s\"} %lu\n",
+                tasks[i].name, tasks[i].deadline_misses);
+    }
+    fprintf(out, "# HELP vehicule_sched_overruns_total Timer expirations that were never run.\n"
+                 "# TYPE vehicule_sched_overruns_total counter\n");
+    for (int i = 0; i < count; i++) {
+        fprintf(out, "vehicule_sched_overruns_total{task=\"%s\"} %lu\n",
+                tasks[i].name, tasks[i].overruns);
+    }
+}
+
+// ---------------------------
+// Command server: clients and per-module command counts and latencies
+// ---------------------------
+static void render_commands(FILE *out) {
+    net_server_stats_t net;
+    module_stats_t modules[MODULE_MAX];
+    int count = modules_get_stats(modules, MODULE_MAX);
+
+    net_server_get_stats(&net);
+    fprintf(out, "# HELP vehicule_clients Command connections open.\n"
+                 "# TYPE vehicule_clients gauge\n"
+                 "vehicule_clients %d\n", net.clients);
+    fprintf(out, "# HELP vehicule_connections_total Command connections served.\n"
+                 "# TYPE vehicule_connections_total counter\n"
+                 "vehicule_connections_total %lu\n", net.requests);
+    fprintf(out, "# HELP vehicule_class_requests_total Commands handled per traffic class.\n"
+                 "# TYPE vehicule_class_requests_total counter\n"
+                 "vehicule_class_requests_total{class=\"control\"} %lu\n"
+                 "vehicule_class_requests_total{class=\"telemetry\"} %lu\n",
+            net.class_requests[NET_CLASS_CONTROL], net.class_requests[NET_CLASS_TELEMETRY]);
+    fprintf(out, "# HELP vehicule_telemetry_refused_total Telemetry commands refused.\n"
+                 "# TYPE vehicule_telemetry_refused_total counter\n"
+                 "vehicule_telemetry_refused_total{reason=\"rate_limited\"} %lu\n"
+                 "vehicule_telemetry_refused_total{reason=\"queue_full\"} %lu\n",
+            net.rate_limited, net.queue_full);
+
+    fprintf(out, "# HELP vehicule_module_ready 1 if the module is up.\n"
+                 "# TYPE vehicule_module_ready gauge\n");
+    for (int i = 0; i < count; i++) {
+        fprintf(out, "vehicule_module_ready{module=\"%s\"} %d\n",
+                modules[i].name, modules[i].state == MODULE_READY);
+    }
+    fprintf(out, "# HELP vehicule_command_errors_total Commands answered with an error.\n"
+                 "# TYPE vehicule_command_errors_total counter\n");
+    for (int i = 0; i < count; i++) {
+        fprintf(out, "vehicule_command_errors_total{module=\"%s\"} %lu\n",
+                modules[i].name, modules[i].errors);
+    }
+
+    fprintf(out, "# HELP vehicule_command_duration_seconds Time to execute a command.\n"
+                 "# TYPE vehicule_command_duration_seconds histogram\n");
+    for (int i = 0; i < count; i++) {
+        const module_stats_t *m = &modules[i];
+        unsigned long cumulative = 0;
+        for (int b = 0; b < MODULE_LATENCY_BUCKETS - 1; b++) {
+            cumulative += m->buckets[b];
+            fprintf(out, "vehicule_command_duration_seconds_bucket{module=\"%s\",le=\"%g\"} %lu\n",
+                    m->name, m->bucket_le_us[b] / 1e6, cumulative);
+        }
+        fprintf(out, "vehicule_command_duration_seconds_bucket{module=\"%s\",le=\"+Inf\"} %lu\n"
+                     "vehicule_command_duration_seconds_sum{module=\"%s\"} %.6f\n"
+                     "vehicule_command_duration_seconds_count{module=\"%s\"} %lu\n",
+                m->name, m->commands, m->name, m->latency_sum_us / 1e6, m->name, m->commands);
+    }
+}
+
+// ---------------------------
+// CPU time of each thread, from /proc/self/task/<tid>/stat
+// ---------------------------
+static void render_threads(FILE *out) {
+    DIR *dir = opendir("/proc/self/task");
+    if (dir == NULL) {
+        return;
+    }
+    double ticks = (double)sysconf(_SC_CLK_TCK);
+
+    fprintf(out, "# HELP vehicule_thread_cpu_seconds_total CPU time per thread.\n"
+                 "# TYPE vehicule_thread_cpu_seconds_total counter\n");
+    struct dirent *d;
+    while ((d = readdir(dir)) != NULL) {
+        char path[300], line[512];
+        if (d->d_name[0] == '.') continue;
+
+        snprintf(path, sizeof(path), "/proc/self/task/%s/stat", d->d_name);
+        FILE *f = fopen(path, "r");
+        if (f == NULL) continue;   // Thread exited meanwhile
+        char *ok = fgets(line, sizeof(line), f);
+        fclose(f);
+
+        // "<tid> (<name>) <state> ..." - the name may contain spaces
+        char *open = ok ? strchr(line, '(') : NULL;
+        char *close = ok ? strrchr(line, ')') : NULL;
+        unsigned long utime, stime;
+        if (open == NULL || close == NULL || close < open ||
+            sscanf(close + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+                   &utime, &stime) != 2) {
+            continue;
+        }
+        *close = '\0';
+        for (char *c = open + 1; *c; c++) {
+            if (*c == '"' || *c == '\\') *c = '_';
+        }
+        fprintf(out, "vehicule_thread_cpu_seconds_total{thread=\"%s\",tid=\"%s\",mode=\"user\"} %.2f\n"
+                     "vehicule_thread_cpu_seconds_total{thread=\"%s\",tid=\"%s\",mode=\"system\"} %.2f\n",
+                open + 1, d->d_name, utime / ticks, open + 1, d->d_name, stime / ticks);
+    }
+    closedir(dir);
+}
+
+void metrics_render(FILE *out) {
+    render_sensors(out);
+    render_i2c(out);
+    render_sched(out);
+    render_commands(out);
+    render_threads(out);
+}
+
+// ---------------------------
+// Serve one HTTP request: GET /metrics, anything else is 404
+// ---------------------------
+static void serve_client(int fd) {
+    char request[METRICS_REQUEST_SIZE];
+    size_t total = 0;
+    ssize_t n;
+
+    // Read up to the end of the headers (or the client's 1 s timeout)
+    while (total < sizeof(request) - 1 &&
+           (n = read(fd, request + total, sizeof(request) - 1 - total)) > 0) {
+        total += n;
+        request[total] = '\0';
+        if (strstr(request, "\r\n\r\n") || strstr(request, "\n\n")) break;
+    }
+    request[total] = '\0';
+
+    char *body = NULL;
+    size_t body_len = 0;
+    const char *status = "200 OK";
+    FILE *out = open_memstream(&body, &body_len);
+    if (out == NULL) {
+        return;
+    }
+    if (strncmp(request, "GET /metrics ", 13) == 0 || strncmp(request, "GET / ", 6) == 0) {
+        metrics_render(out);
+    } else {
+        status = "404 Not Found";
+        fprintf(out, "Try GET /metrics\n");
+    }
+    fclose(out);
+
+    char header[160];
+    int header_len = snprintf(header, sizeof(header),
+                              "HTTP/1.0 %s\r\n"
+                              "Content-Type: text/plain; version=0.0.4\r\n"
+                              "Content-Length: %zu\r\n"
+                              "Connection: close\r\n\r\n", status, body_len);
+    // MSG_NOSIGNAL: a scraper that hangs up early must not raise SIGPIPE
+    if (send(fd, header, header_len, MSG_NOSIGNAL) == header_len) {
+        for (size_t sent = 0; sent < body_len; sent += n) {
+            n = send(fd, body + sent, body_len - sent, MSG_NOSIGNAL);
+            if (n <= 0) break;
+        }
+    }
+    free(body);
+}
+
+static void *metrics_thread_main(void *arg) {
+    (void)arg;
+    prctl(PR_SET_NAME, "metrics");
+
+    while (thread_running) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            continue;  // SO_RCVTIMEO expired: recheck thread_running
+        }
+        struct timeval tv = { 1, 0 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        serve_client(fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+// ---------------------------
+// Start and stop the listener
+// ---------------------------
+int metrics_start(const char *ip, int port) {
+    struct sockaddr_in addr;
+
+    if (thread_running) {
+        return -1;
+    }
+    if (ip == NULL) {
+        ip = METRICS_IP;
+    }
+
+    listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        perror("[METRICS] Failed to create socket");
+        return -1;
+    }
+    int opt = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, ip, &addr.sin_addr) != 1) {
+        fprintf(stderr, "[METRICS] Invalid address '%s'\n", ip);
+        close(listen_fd);
+        listen_fd = -1;
+        return -1;
+    }
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listen_fd, 4) < 0) {
+        perror("[METRICS] Failed to listen");
+        close(listen_fd);
+        listen_fd = -1;
+        return -1;
+    }
+
+    struct timeval tv = { 1, 0 };
+    setsockopt(listen_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    thread_running = 1;
+    if (pthread_create(&metrics_thread, NULL, metrics_thread_main, NULL) != 0) {
+        perror("[METRICS] Failed to create thread");
+        thread_running = 0;
+        close(listen_fd);
+        listen_fd = -1;
+        return -1;
+    }
+    printf("[METRICS] Serving http://%s:%d/metrics\n", ip, port);
+    return 0;
+}
+
+void metrics_stop(void) {
+    if (!thread_running) {
+        return;
+    }
+    thread_running = 0;
+    pthread_join(metrics_thread, NULL);
+    close(listen_fd);
+    listen_fd = -1;
+}
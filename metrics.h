@@ -0,0 +1,25 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdio.h>
+
+// Configuration
+#define METRICS_IP            "0.0.0.0"   // Default bind address
+#define METRICS_DEFAULT_PORT  9105
+#define METRICS_REQUEST_SIZE  1024
+
+// Minimal HTTP listener for Prometheus scrapes ("GET /metrics") on its own
+// thread and port. The sensor loops only bump counters; everything is
+// collected and formatted here at scrape time.
+//
+//     curl http://localhost:9105/metrics
+//
+// 'ip' is the IPv4 address to bind (NULL for METRICS_IP), e.g. "127.0.0.1"
+// to keep the endpoint off the network.
+int metrics_start(const char *ip, int port);
+void metrics_stop(void);
+
+// Write the current values in Prometheus text exposition format
+void metrics_render(FILE *out);
+
+#endif // METRICS_H
@@ -0,0 +1,392 @@
+#include "module.h"
+#include "pwm.h"
+#include "i2c_bus.h"
+#include "scheduler.h"
+#include "recorder.h"
+#include "replay.h"
+#include "trace.h"
+#include "rt.h"
+#include "snapshot.h"
+#include "batch.h"
+#ifndef MODULE_NO_IMU
+#include "imu.h"
+#endif
+#ifndef MODULE_NO_HEADING
+#include "heading.h"
+#endif
+#ifndef MODULE_NO_SONAR
+#include "sonar.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+static int execute_modules_command(char *cmd_str, char *response, size_t response_size);
+
+static const module_t registry_module = {
+    .name = "modules",
+    .prefix = "MODULES",
+    .usage = "MODULES (name, prefix and state of each module)",
+    .command = execute_modules_command,
+};
+
+// Modules compiled into this binary (make DISABLE="sonar ..." drops some).
+// Stopped in reverse order.
+static const module_t *const builtin_modules[] = {
+    &pwm_module,
+#ifndef MODULE_NO_HEADING
+    &heading_module,
+#endif
+#ifndef MODULE_NO_IMU
+    &imu_module,
+#endif
+#ifndef MODULE_NO_SONAR
+    &sonar_module,
+#endif
+    &sched_module,
+    &i2c_module,
+    &recorder_module,
+    &replay_module,
+    &snapshot_module,
+    &trace_module,
+    &rt_module,
+    &batch_module,
+    &registry_module,
+};
+
+#define NUM_BUILTIN (int)(sizeof(builtin_modules) / sizeof(builtin_modules[0]))
+
+typedef struct {
+    const module_t *module;
+    module_state_t state;
+    pthread_t thread;
+    int thread_started;
+
+    // Command statistics (protected by stats_mutex)
+    unsigned long commands;
+    unsigned long errors;
+    double latency_sum_us;
+    unsigned long buckets[MODULE_LATENCY_BUCKETS];
+} entry_t;
+
+static const uint32_t latency_bounds_us[MODULE_LATENCY_BUCKETS - 1] = {
+    10, 50, 100, 500, 1000, 10000, 100000
+};
+
+// Sorted by prefix for binary search
+typedef struct {
+    const char *prefix;
+    size_t len;
+    entry_t *entry;
+} route_t;
+
+// Static variables
+static entry_t entries[MODULE_MAX];
+static int disabled[MODULE_MAX];
+static route_t routes[MODULE_MAX];
+static int route_count = 0;
+static entry_t *fallback = NULL;
+static pthread_mutex_t state_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t state_cond = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int sched_mode = 0;
+static uint64_t launch_us = 0;
+static volatile int *server_running = NULL;
+
+static uint64_t get_time_microseconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static const char *state_name(module_state_t state) {
+    switch (state) {
+        case MODULE_DISABLED:     return "disabled";
+        case MODULE_INITIALIZING: return "initializing";
+        case MODULE_READY:        return "ready";
+        case MODULE_FAILED:       return "unavailable";
+    }
+    return "unknown";
+}
+
+static module_state_t get_state(entry_t *e) {
+    pthread_mutex_lock(&state_mutex);
+    module_state_t state = e->state;
+    pthread_mutex_unlock(&state_mutex);
+    return state;
+}
+
+static void set_state(entry_t *e, module_state_t state) {
+    pthread_mutex_lock(&state_mutex);
+    e->state = state;
+    pthread_cond_broadcast(&state_cond);
+    pthread_mutex_unlock(&state_mutex);
+}
+
+static entry_t *find_entry(const char *name) {
+    for (int i = 0; i < NUM_BUILTIN; i++) {
+        if (strcmp(entries[i].module->name, name) == 0) return &entries[i];
+    }
+    return NULL;
+}
+
+int modules_disable(const char *name) {
+    for (int i = 0; i < NUM_BUILTIN; i++) {
+        if (strcmp(builtin_modules[i]->name, name) == 0) {
+            disabled[i] = 1;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// ---------------------------
+// Bring one module up (runs on its own thread)
+// ---------------------------
+static void *init_thread(void *arg) {
+    entry_t *e = arg;
+    const module_t *m = e->module;
+
+    // Wait for the module this one needs (e.g. heading needs PWM)
+    if (m->depends) {
+        entry_t *dep = find_entry(m->depends);
+        pthread_mutex_lock(&state_mutex);
+        while (dep && dep->state == MODULE_INITIALIZING) {
+            pthread_cond_wait(&state_cond, &state_mutex);
+        }
+        int dep_ready = dep && dep->state == MODULE_READY;
+        pthread_mutex_unlock(&state_mutex);
+
+        if (!dep_ready) {
+            fprintf(stderr, "Warning: %s needs %s, not started\n", m->name, m->depends);
+            set_state(e, MODULE_FAILED);
+            return NULL;
+        }
+    }
+
+    if (m->init && m->init() < 0) {
+        fprintf(stderr, "Warning: Failed to initialize %s\n", m->name);
+        set_state(e, MODULE_FAILED);
+        if (m->required) {
+            *server_running = 0;
+        }
+        return NULL;
+    }
+    if (m->start && m->start(sched_mode) < 0) {
+        fprintf(stderr, "Warning: Failed to start %s\n", m->name);
+    }
+
+    set_state(e, MODULE_READY);
+    if (m->init) {
+        printf("Module %s ready after %.1f ms\n", m->name,
+               (get_time_microseconds() - launch_us) / 1000.0);
+    }
+    return NULL;
+}
+
+static int compare_routes(const void *a, const void *b) {
+    return strcmp(((const route_t *)a)->prefix, ((const route_t *)b)->prefix);
+}
+
+// ---------------------------
+// Build the routing table and start every enabled module
+// ---------------------------
+int modules_start(int use_sched, uint64_t start_us, volatile int *running) {
+    sched_mode = use_sched;
+    launch_us = start_us;
+    server_running = running;
+
+    for (int i = 0; i < NUM_BUILTIN; i++) {
+        entry_t *e = &entries[i];
+        e->module = builtin_modules[i];
+        e->state = disabled[i] ? MODULE_DISABLED : MODULE_INITIALIZING;
+
+        // Disabled modules keep their route so they can answer "disabled"
+        if (e->module->prefix) {
+            routes[route_count].prefix = e->module->prefix;
+            routes[route_count].len = strlen(e->module->prefix);
+            routes[route_count].entry = e;
+            route_count++;
+        }
+        if (e->module->fallback) {
+            fallback = e;
+        }
+    }
+    qsort(routes, route_count, sizeof(route_t), compare_routes);
+
+    for (int i = 0; i < NUM_BUILTIN; i++) {
+        entry_t *e = &entries[i];
+        if (e->state == MODULE_DISABLED) {
+            continue;
+        }
+        if (pthread_create(&e->thread, NULL, init_thread, e) != 0) {
+            perror("Failed to create init thread");
+            set_state(e, MODULE_FAILED);
+            continue;
+        }
+        e->thread_started = 1;
+    }
+    return 0;
+}
+
+// ---------------------------
+// Wait for init threads, then stop ready modules in reverse order
+// ---------------------------
+void modules_shutdown(void) {
+    for (int i = 0; i < NUM_BUILTIN; i++) {
+        if (entries[i].thread_started) {
+            pthread_join(entries[i].thread, NULL);
+            entries[i].thread_started = 0;
+        }
+    }
+    for (int i = NUM_BUILTIN - 1; i >= 0; i--) {
+        entry_t *e = &entries[i];
+        if (e->state == MODULE_READY && e->module->stop) {
+            e->module->stop();
+        }
+        e->state = MODULE_DISABLED;
+    }
+}
+
+void modules_print_usage(void) {
+    for (int i = 0; i < NUM_BUILTIN; i++) {
+        const module_t *m = builtin_modules[i];
+        char label[16];
+        if (m->usage && !disabled[i]) {
+            snprintf(label, sizeof(label), "%s:", m->prefix);
+            printf("  %-8s %s\n", label, m->usage);
+        }
+    }
+}
+
+// ---------------------------
+// Binary search on the first word of the line
+// ---------------------------
+static entry_t *find_route(const char *word, size_t len) {
+    int lo = 0, hi = route_count - 1;
+
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        const route_t *r = &routes[mid];
+        int cmp = strncmp(word, r->prefix, len < r->len ? len : r->len);
+        if (cmp == 0) {
+            cmp = (len > r->len) - (len < r->len);
+        }
+        if (cmp == 0) return r->entry;
+        if (cmp < 0) hi = mid - 1;
+        else lo = mid + 1;
+    }
+    return NULL;
+}
+
+// Account one answered command
+static void record_command(entry_t *e, const char *response, uint64_t start_us) {
+    double elapsed = (double)(get_time_microseconds() - start_us);
+    int b = 0;
+    while (b < MODULE_LATENCY_BUCKETS - 1 && elapsed > latency_bounds_us[b]) b++;
+
+    pthread_mutex_lock(&stats_mutex);
+    e->commands++;
+    if (strncmp(response, "ERROR", 5) == 0) e->errors++;
+    e->latency_sum_us += elapsed;
+    e->buckets[b]++;
+    pthread_mutex_unlock(&stats_mutex);
+}
+
+size_t modules_dispatch(char *line, char *response, size_t response_size) {
+    size_t len = strcspn(line, " \t");
+    entry_t *e = find_route(line, len);
+    char *cmd = line;
+
+    if (e) {
+        cmd = line + len;
+        while (*cmd == ' ' || *cmd == '\t') cmd++;
+    } else {
+        e = fallback;  // e.g. bare "50" is a PWM command
+    }
+
+    response[0] = '\0';
+    if (e == NULL) {
+        snprintf(response, response_size, "ERROR: Unknown command\n");
+        return strlen(response);
+    }
+
+    uint64_t start_us = get_time_microseconds();
+    module_state_t state = get_state(e);
+    if (state != MODULE_READY) {
+        snprintf(response, response_size, "ERROR: %s %s\n",
+                 e->module->prefix ? e->module->prefix : e->module->name, state_name(state));
+        record_command(e, response, start_us);
+        return strlen(response);
+    }
+
+    // One span per command, named after the module's prefix
+    uint64_t t0 = trace_begin();
+    e->module->command(cmd, response, response_size);
+    trace_end(e->module->prefix ? e->module->prefix : e->module->name, t0);
+    record_command(e, response, start_us);
+    return strlen(response);
+}
+
+int modules_is_control(const char *line) {
+    size_t len = strcspn(line, " \t");
+    entry_t *e = find_route(line, len);
+    const char *cmd = line;
+
+    if (e) {
+        cmd = line + len;
+        while (*cmd == ' ' || *cmd == '\t') cmd++;
+    } else {
+        e = fallback;
+    }
+    if (e == NULL) {
+        return 0;
+    }
+    return e->module->is_control ? e->module->is_control(cmd) : e->module->control;
+}
+
+int modules_get_stats(module_stats_t *stats, int max_modules) {
+    int count = 0;
+
+    for (int i = 0; i < NUM_BUILTIN && count < max_modules; i++) {
+        entry_t *e = &entries[i];
+        if (e->module == NULL) continue;   // Before modules_start()
+
+        module_stats_t *s = &stats[count++];
+        s->name = e->module->name;
+        s->state = get_state(e);
+        pthread_mutex_lock(&stats_mutex);
+        s->commands = e->commands;
+        s->errors = e->errors;
+        s->latency_sum_us = e->latency_sum_us;
+        memcpy(s->buckets, e->buckets, sizeof(s->buckets));
+        pthread_mutex_unlock(&stats_mutex);
+        memcpy(s->bucket_le_us, latency_bounds_us, sizeof(latency_bounds_us));
+        s->bucket_le_us[MODULE_LATENCY_BUCKETS - 1] = 0;
+    }
+    return count;
+}
+
+// ---------------------------
+// Execute registry command
+// Commands:
+//   "" - List modules and their state
+// ---------------------------
+static int execute_modules_command(char *cmd_str, char *response, size_t response_size) {
+    (void)cmd_str;
+    size_t pos = snprintf(response, response_size, "{\"modules\":[");
+
+    for (int i = 0; i < NUM_BUILTIN && pos < response_size; i++) {
+        entry_t *e = &entries[i];
+        pos += snprintf(response + pos, response_size - pos,
+            "%s{\"name\":\"%s\",\"prefix\":\"%s\",\"state\":\"%s\"}",
+            i ? "," : "", e->module->name, e->module->prefix ? e->module->prefix : "",
+            state_name(get_state(e)));
+    }
+    if (pos < response_size) {
+        snprintf(response + pos, response_size - pos, "]}\n");
+    }
+    return 0;
+}
@@ -0,0 +1,66 @@
+#ifndef MODULE_H
+#define MODULE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Configuration
+#define MODULE_MAX               16
+#define MODULE_LATENCY_BUCKETS   8      // Command latency histogram, last is +Inf
+
+// Module descriptor: each device file exports one (e.g. imu_module).
+// Any hook may be NULL.
+typedef struct {
+    const char *name;       // Launch-time name, e.g. "sonar" for --disable sonar
+    const char *prefix;     // Command prefix, e.g. "SONAR" (NULL: no commands)
+    const char *usage;      // Help text printed at startup
+    const char *depends;    // Module that must be ready before init, or NULL
+    int required;           // Init failure shuts the server down
+    int fallback;           // Receives lines that match no prefix
+    int control;            // Actuator commands: served ahead of telemetry (net_server.h)
+
+    int (*init)(void);                  // Bring up the device (may block)
+    int (*start)(int use_sched);        // Start periodic work
+    void (*stop)(void);                 // Stop and release the device
+    int (*command)(char *cmd_str, char *response, size_t response_size);
+    int (*is_control)(const char *cmd_str);    // Per-line class in place of 'control'
+} module_t;
+
+typedef enum {
+    MODULE_DISABLED,
+    MODULE_INITIALIZING,
+    MODULE_READY,
+    MODULE_FAILED
+} module_state_t;
+
+// Disable a built-in module before modules_start(); -1 if unknown
+int modules_disable(const char *name);
+
+// Build the dispatch table and bring every enabled module up on its own
+// thread. A required module that fails clears *running.
+int modules_start(int use_sched, uint64_t start_us, volatile int *running);
+void modules_shutdown(void);
+
+void modules_print_usage(void);
+
+// Route one command line; fills response and returns its length
+size_t modules_dispatch(char *line, char *response, size_t response_size);
+
+// 1 if the line goes to a control module (same routing as dispatch)
+int modules_is_control(const char *line);
+
+// Commands routed to one module since start (metrics.c)
+typedef struct {
+    const char *name;
+    module_state_t state;
+    unsigned long commands;
+    unsigned long errors;           // Answered "ERROR: ..."
+    double latency_sum_us;
+    uint32_t bucket_le_us[MODULE_LATENCY_BUCKETS];  // Upper bounds, last unused
+    unsigned long buckets[MODULE_LATENCY_BUCKETS];  // Not cumulative
+} module_stats_t;
+
+// Fills up to max_modules entries; returns the count
+int modules_get_stats(module_stats_t *stats, int max_modules);
+
+#endif // MODULE_H
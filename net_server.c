@@ -0,0 +1,676 @@
+#include "net_server.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <linux/io_uring.h>
+
+// Static variables (the serving thread writes them; the telemetry worker
+// only counts the connections it closes)
+static volatile unsigned long stat_requests = 0;
+static volatile unsigned long stat_syscalls = 0;
+static volatile int stat_clients = 0;
+static volatile unsigned long stat_class[NET_NUM_CLASSES];
+static volatile unsigned long stat_rate_limited = 0;
+static volatile unsigned long stat_queue_full = 0;
+
+#define STAT_ADD(counter, n)  __atomic_add_fetch(&(counter), (n), __ATOMIC_RELAXED)
+
+void net_server_get_stats(net_server_stats_t *stats) {
+    stats->requests = stat_requests;
+    stats->syscalls = stat_syscalls;
+    stats->clients = stat_clients;
+    for (int c = 0; c < NET_NUM_CLASSES; c++) {
+        stats->class_requests[c] = stat_class[c];
+    }
+    stats->rate_limited = stat_rate_limited;
+    stats->queue_full = stat_queue_full;
+}
+
+static uint64_t get_time_microseconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+// ---------------------------
+// Traffic classes: control lines are answered inline by the backend,
+// telemetry lines are handed with their connection to a worker thread
+// ---------------------------
+typedef enum { ROUTE_INLINE, ROUTE_QUEUED, ROUTE_REFUSED } route_t;
+
+typedef struct {
+    int fd;
+    uint32_t addr;          // Client, for its token bucket
+    char line[NET_LINE_SIZE];
+} job_t;
+
+typedef struct {
+    uint32_t addr;          // IPv4, network order
+    int used;
+    double tokens;          // Response bytes; negative after a large reply
+    uint64_t updated_us;
+} bucket_t;
+
+static net_classify_fn qos_classify = NULL;
+static uint32_t qos_rate = 0, qos_burst = 0;
+static pthread_mutex_t qos_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t qos_cond = PTHREAD_COND_INITIALIZER;
+static job_t jobs[NET_TELEMETRY_QUEUE];
+static int job_head = 0, job_count = 0;
+static bucket_t buckets[NET_QOS_MAX_CLIENTS];
+static int worker_running = 0;
+static pthread_t worker_thread;
+static net_command_fn worker_handler;
+static void *worker_ctx;
+static size_t worker_response_size;
+
+void net_server_set_qos(net_classify_fn classify, uint32_t rate, uint32_t burst) {
+    qos_classify = classify;
+    qos_rate = rate;
+    qos_burst = burst ? burst : rate;
+}
+
+static void set_socket_class(int fd, net_class_t class) {
+    int tos = (class == NET_CLASS_CONTROL ? NET_DSCP_CONTROL : NET_DSCP_TELEMETRY) << 2;
+    int priority = class == NET_CLASS_CONTROL ? NET_PRIORITY_CONTROL : NET_PRIORITY_TELEMETRY;
+
+    // IP_TOS also sets the priority, so SO_PRIORITY goes second
+    setsockopt(fd, IPPROTO_IP, IP_TOS, &tos, sizeof(tos));
+    setsockopt(fd, SOL_SOCKET, SO_PRIORITY, &priority, sizeof(priority));
+    STAT_ADD(stat_syscalls, 2);
+}
+
+// Bucket of a client, refilled up to now (qos_mutex held). An unknown
+// client takes a free bucket or the least recently used one, full.
+static bucket_t *find_bucket(uint32_t addr, uint64_t now, int create) {
+    bucket_t *oldest = &buckets[0];
+
+    for (int i = 0; i < NET_QOS_MAX_CLIENTS; i++) {
+        bucket_t *b = &buckets[i];
+        if (b->used && b->addr == addr) {
+            b->tokens += (double)qos_rate * (now - b->updated_us) / 1e6;
+            if (b->tokens > qos_burst) b->tokens = qos_burst;
+            b->updated_us = now;
+            return b;
+        }
+        if (!b->used || (oldest->used && b->updated_us < oldest->updated_us)) {
+            oldest = b;
+        }
+    }
+    if (!create) {
+        return NULL;
+    }
+    oldest->used = 1;
+    oldest->addr = addr;
+    oldest->tokens = qos_burst;
+    oldest->updated_us = now;
+    return oldest;
+}
+
+// ---------------------------
+// Decide how a line is served. QUEUED: the worker owns the connection
+// now. REFUSED: 'response' holds the error to send. INLINE: the caller
+// runs the handler.
+// ---------------------------
+static route_t qos_route(int fd, const char *line, void *ctx,
+                         char *response, size_t response_size, size_t *len) {
+    if (qos_classify == NULL) {
+        return ROUTE_INLINE;
+    }
+
+    net_class_t class = qos_classify(line, ctx);
+    set_socket_class(fd, class);
+    if (class == NET_CLASS_CONTROL || !worker_running) {
+        STAT_ADD(stat_class[class], 1);
+        return ROUTE_INLINE;
+    }
+
+    struct sockaddr_in peer;
+    socklen_t peer_len = sizeof(peer);
+    uint32_t addr = 0;
+    if (getpeername(fd, (struct sockaddr *)&peer, &peer_len) == 0 && peer.sin_family == AF_INET) {
+        addr = peer.sin_addr.s_addr;
+    }
+    // A stalled reader cannot hold the worker for long
+    struct timeval tv = { 1, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    STAT_ADD(stat_syscalls, 2);
+
+    pthread_mutex_lock(&qos_mutex);
+    bucket_t *b = find_bucket(addr, get_time_microseconds(), 1);
+    if (qos_rate && b->tokens <= 0) {
+        unsigned wait_ms = (unsigned)(-b->tokens * 1000.0 / qos_rate) + 1;
+        pthread_mutex_unlock(&qos_mutex);
+        STAT_ADD(stat_rate_limited, 1);
+        snprintf(response, response_size, "ERROR: Rate limited, retry in %u ms\n", wait_ms);
+        *len = strlen(response);
+        return ROUTE_REFUSED;
+    }
+    if (job_count == NET_TELEMETRY_QUEUE) {
+        pthread_mutex_unlock(&qos_mutex);
+        STAT_ADD(stat_queue_full, 1);
+        snprintf(response, response_size, "ERROR: Server busy\n");
+        *len = strlen(response);
+        return ROUTE_REFUSED;
+    }
+
+    job_t *job = &jobs[(job_head + job_count) % NET_TELEMETRY_QUEUE];
+    job->fd = fd;
+    job->addr = addr;
+    snprintf(job->line, sizeof(job->line), "%s", line);
+    job_count++;
+    pthread_cond_signal(&qos_cond);
+    pthread_mutex_unlock(&qos_mutex);
+
+    STAT_ADD(stat_class[class], 1);
+    return ROUTE_QUEUED;
+}
+
+static void send_all(int fd, const char *data, size_t len) {
+    size_t sent = 0;
+    while (sent < len) {
+        ssize_t n = send(fd, data + sent, len - sent, MSG_NOSIGNAL);
+        if (n <= 0) break;
+        sent += n;
+    }
+}
+
+static void *telemetry_worker(void *arg) {
+    char *response = arg;
+
+    prctl(PR_SET_NAME, "net-telemetry");
+    // Nice values are per thread on Linux
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), NET_TELEMETRY_NICE);
+
+    pthread_mutex_lock(&qos_mutex);
+    while (1) {
+        while (worker_running && job_count == 0) {
+            pthread_cond_wait(&qos_cond, &qos_mutex);
+        }
+        if (!worker_running) break;
+
+        job_t job = jobs[job_head];
+        job_head = (job_head + 1) % NET_TELEMETRY_QUEUE;
+        job_count--;
+        pthread_mutex_unlock(&qos_mutex);
+
+        uint64_t t0 = trace_begin();
+        size_t len = worker_handler(job.line, response, worker_response_size, worker_ctx);
+        send_all(job.fd, response, len);
+        close(job.fd);
+        trace_end("handle_telemetry", t0);
+        STAT_ADD(stat_clients, -1);
+        STAT_ADD(stat_requests, 1);
+
+        pthread_mutex_lock(&qos_mutex);
+        bucket_t *b = find_bucket(job.addr, get_time_microseconds(), 0);
+        if (b) b->tokens -= (double)len;
+    }
+    pthread_mutex_unlock(&qos_mutex);
+
+    free(response);
+    return NULL;
+}
+
+// Without the worker, telemetry is served inline
+static void qos_start(net_command_fn handler, void *ctx, size_t response_size) {
+    if (qos_classify == NULL) {
+        return;
+    }
+    char *response = malloc(response_size);
+    if (response == NULL) {
+        return;
+    }
+
+    worker_handler = handler;
+    worker_ctx = ctx;
+    worker_response_size = response_size;
+    worker_running = 1;
+    if (pthread_create(&worker_thread, NULL, telemetry_worker, response) != 0) {
+        perror("[NET] Failed to start telemetry worker");
+        worker_running = 0;
+        free(response);
+    }
+}
+
+// Requests still queued are dropped
+static void qos_stop(void) {
+    pthread_mutex_lock(&qos_mutex);
+    int started = worker_running;
+    worker_running = 0;
+    pthread_cond_broadcast(&qos_cond);
+    pthread_mutex_unlock(&qos_mutex);
+
+    if (started) {
+        pthread_join(worker_thread, NULL);
+    }
+    for (; job_count > 0; job_count--) {
+        close(jobs[job_head].fd);
+        job_head = (job_head + 1) % NET_TELEMETRY_QUEUE;
+        STAT_ADD(stat_clients, -1);
+    }
+}
+
+// ---------------------------
+// Blocking backend: one connection at a time, byte-wise line read
+// ---------------------------
+int net_serve_blocking(int server_fd, volatile int *running,
+                       net_command_fn handler, void *ctx, size_t response_size) {
+    char buffer[NET_LINE_SIZE];
+    char *response = malloc(response_size);
+    if (response == NULL) {
+        return -1;
+    }
+    qos_start(handler, ctx, response_size);
+
+    while (*running) {
+        int client_fd = accept(server_fd, NULL, NULL);
+        STAT_ADD(stat_syscalls, 1);
+        if (client_fd < 0) {
+            continue;  // SO_RCVTIMEO expired or interrupted: recheck *running
+        }
+        uint64_t t0 = trace_begin();
+        STAT_ADD(stat_clients, 1);
+
+        size_t total = 0;
+        ssize_t n;
+        memset(buffer, 0, sizeof(buffer));
+        while (total < sizeof(buffer) - 1 && (n = read(client_fd, buffer + total, 1)) > 0) {
+            STAT_ADD(stat_syscalls, 1);
+            if (buffer[total] == '\n') break;
+            total += n;
+        }
+        STAT_ADD(stat_syscalls, 1);
+        buffer[total] = '\0';
+
+        if (total > 0) {
+            size_t len = 0;
+            route_t route = qos_route(client_fd, buffer, ctx, response, response_size, &len);
+            if (route == ROUTE_QUEUED) {
+                trace_end("handle_client", t0);
+                continue;   // The telemetry worker answers and closes it
+            }
+            if (route == ROUTE_INLINE) {
+                len = handler(buffer, response, response_size, ctx);
+            }
+            if (write(client_fd, response, len) < 0) {
+                perror("Failed to send response");
+            }
+            STAT_ADD(stat_syscalls, 1);
+        }
+
+        close(client_fd);
+        STAT_ADD(stat_clients, -1);
+        trace_end("handle_client", t0);
+        STAT_ADD(stat_syscalls, 1);
+        STAT_ADD(stat_requests, 1);
+    }
+
+    qos_stop();
+    free(response);
+    return 0;
+}
+
+// ---------------------------
+// Minimal io_uring ring (raw syscalls, no liburing)
+// ---------------------------
+typedef struct {
+    int fd;
+    unsigned entries;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ptr, *cq_ptr;
+    size_t sq_len, cq_len, sqes_len;
+    unsigned sqe_tail;      // Local tail, published to the kernel on submit
+    unsigned pending;       // Queued but not yet submitted
+} ring_t;
+
+static int ring_init(ring_t *ring, unsigned entries) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    memset(ring, 0, sizeof(*ring));
+
+    ring->fd = syscall(__NR_io_uring_setup, entries, &p);
+    if (ring->fd < 0) {
+        return -1;
+    }
+    ring->entries = p.sq_entries;
+
+    ring->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_len > ring->sq_len) ring->sq_len = ring->cq_len;
+        ring->cq_len = ring->sq_len;
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_len, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) {
+        close(ring->fd);
+        return -1;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ptr = ring->sq_ptr;
+    } else {
+        ring->cq_ptr = mmap(NULL, ring->cq_len, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED) {
+            munmap(ring->sq_ptr, ring->sq_len);
+            close(ring->fd);
+            return -1;
+        }
+    }
+
+    ring->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        if (ring->cq_ptr != ring->sq_ptr) munmap(ring->cq_ptr, ring->cq_len);
+        munmap(ring->sq_ptr, ring->sq_len);
+        close(ring->fd);
+        return -1;
+    }
+
+    char *sq = ring->sq_ptr;
+    char *cq = ring->cq_ptr;
+    ring->sq_head = (unsigned *)(sq + p.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + p.sq_off.array);
+    ring->cq_head = (unsigned *)(cq + p.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    ring->sqe_tail = *ring->sq_tail;
+    return 0;
+}
+
+static void ring_close(ring_t *ring) {
+    munmap(ring->sqes, ring->sqes_len);
+    if (ring->cq_ptr != ring->sq_ptr) munmap(ring->cq_ptr, ring->cq_len);
+    munmap(ring->sq_ptr, ring->sq_len);
+    close(ring->fd);
+}
+
+static struct io_uring_sqe *ring_get_sqe(ring_t *ring) {
+    unsigned tail = ring->sqe_tail;
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (tail - head >= ring->entries) {
+        return NULL;
+    }
+
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[index] = index;
+    ring->sqe_tail = tail + 1;
+    ring->pending++;
+    return sqe;
+}
+
+// Submit everything queued and wait for at least one completion
+static int ring_submit_and_wait(ring_t *ring) {
+    __atomic_store_n(ring->sq_tail, ring->sqe_tail, __ATOMIC_RELEASE);
+    int ret = syscall(__NR_io_uring_enter, ring->fd, ring->pending, 1,
+                      IORING_ENTER_GETEVENTS, NULL, 0);
+    STAT_ADD(stat_syscalls, 1);
+    if (ret < 0) {
+        return -1;
+    }
+    ring->pending -= ret;
+    return 0;
+}
+
+static struct io_uring_cqe *ring_peek_cqe(ring_t *ring) {
+    unsigned head = *ring->cq_head;
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    return &ring->cqes[head & *ring->cq_mask];
+}
+
+static void ring_cqe_seen(ring_t *ring) {
+    __atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+// ---------------------------
+// io_uring backend
+// ---------------------------
+enum { OP_ACCEPT, OP_RECV, OP_SEND, OP_CLOSE, OP_TIMEOUT };
+
+#define USER_DATA(slot, op)  (((uint64_t)(slot) << 8) | (op))
+#define NO_SLOT              0xFF
+
+typedef struct {
+    int fd;             // -1 when free
+    char line[NET_LINE_SIZE];
+    size_t received;
+    char *response;
+    size_t length, sent;
+    int failed;
+} conn_t;
+
+typedef struct {
+    ring_t ring;
+    int server_fd;
+    int accept_armed;
+    conn_t conns[NET_URING_MAX_CONNS];
+    struct __kernel_timespec tick;
+    net_command_fn handler;
+    void *ctx;
+    size_t response_size;
+} server_t;
+
+static void queue_accept(server_t *s) {
+    struct io_uring_sqe *sqe = ring_get_sqe(&s->ring);
+    if (sqe == NULL) return;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = s->server_fd;
+    sqe->user_data = USER_DATA(NO_SLOT, OP_ACCEPT);
+    s->accept_armed = 1;
+}
+
+static void queue_recv(server_t *s, int slot) {
+    conn_t *c = &s->conns[slot];
+    struct io_uring_sqe *sqe = ring_get_sqe(&s->ring);
+    if (sqe == NULL) return;
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = c->fd;
+    sqe->addr = (uint64_t)(uintptr_t)(c->line + c->received);
+    sqe->len = sizeof(c->line) - 1 - c->received;
+    sqe->user_data = USER_DATA(slot, OP_RECV);
+}
+
+// The reply and the close go out in the same submission, linked so the
+// close only runs once the send has fully completed
+static void queue_send_close(server_t *s, int slot) {
+    conn_t *c = &s->conns[slot];
+    struct io_uring_sqe *sqe;
+
+    if (!c->failed && c->sent < c->length) {
+        sqe = ring_get_sqe(&s->ring);
+        if (sqe == NULL) return;
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = c->fd;
+        sqe->addr = (uint64_t)(uintptr_t)(c->response + c->sent);
+        sqe->len = c->length - c->sent;
+        sqe->msg_flags = MSG_NOSIGNAL;
+        sqe->flags = IOSQE_IO_LINK;
+        sqe->user_data = USER_DATA(slot, OP_SEND);
+    }
+
+    sqe = ring_get_sqe(&s->ring);
+    if (sqe == NULL) return;
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->fd = c->fd;
+    sqe->user_data = USER_DATA(slot, OP_CLOSE);
+}
+
+static void queue_timeout(server_t *s) {
+    struct io_uring_sqe *sqe = ring_get_sqe(&s->ring);
+    if (sqe == NULL) return;
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->addr = (uint64_t)(uintptr_t)&s->tick;
+    sqe->len = 1;
+    sqe->user_data = USER_DATA(NO_SLOT, OP_TIMEOUT);
+}
+
+static int free_slot(server_t *s) {
+    for (int i = 0; i < NET_URING_MAX_CONNS; i++) {
+        if (s->conns[i].fd < 0) return i;
+    }
+    return -1;
+}
+
+static void handle_completion(server_t *s, int slot, int op, int res, volatile int *running) {
+    conn_t *c = slot == NO_SLOT ? NULL : &s->conns[slot];
+
+    switch (op) {
+    case OP_ACCEPT: {
+        s->accept_armed = 0;
+        int free = free_slot(s);
+        if (res >= 0 && free >= 0) {
+            c = &s->conns[free];
+            c->fd = res;
+            c->received = 0;
+            c->length = c->sent = 0;
+            c->failed = 0;
+            STAT_ADD(stat_clients, 1);
+            queue_recv(s, free);
+        } else if (res >= 0) {
+            close(res);
+        }
+        if (*running && free_slot(s) >= 0) {
+            queue_accept(s);
+        }
+        break;
+    }
+
+    case OP_RECV: {
+        if (res > 0) {
+            c->received += res;
+        }
+        c->line[c->received] = '\0';
+        char *newline = strchr(c->line, '\n');
+        if (res > 0 && newline == NULL && c->received < sizeof(c->line) - 1) {
+            queue_recv(s, slot);  // Partial line: keep reading
+            break;
+        }
+        if (newline) *newline = '\0';
+
+        if (c->line[0] != '\0') {
+            route_t route = qos_route(c->fd, c->line, s->ctx, c->response, s->response_size, &c->length);
+            if (route == ROUTE_QUEUED) {
+                // The telemetry worker answers and closes it; the slot is free
+                c->fd = -1;
+                if (*running && !s->accept_armed) {
+                    queue_accept(s);
+                }
+                break;
+            }
+            if (route == ROUTE_INLINE) {
+                c->length = s->handler(c->line, c->response, s->response_size, s->ctx);
+            }
+        }
+        queue_send_close(s, slot);
+        break;
+    }
+
+    case OP_SEND:
+        if (res < 0) {
+            c->failed = 1;
+        } else {
+            c->sent += res;
+        }
+        break;
+
+    case OP_CLOSE:
+        if (res == -ECANCELED) {
+            queue_send_close(s, slot);  // Short send broke the link: finish it
+            break;
+        }
+        c->fd = -1;
+        STAT_ADD(stat_clients, -1);
+        STAT_ADD(stat_requests, 1);
+        if (*running && !s->accept_armed) {
+            queue_accept(s);
+        }
+        break;
+
+    case OP_TIMEOUT:
+        if (*running) {
+            queue_timeout(s);
+        }
+        break;
+    }
+}
+
+int net_serve_uring(int server_fd, volatile int *running,
+                    net_command_fn handler, void *ctx, size_t response_size) {
+    server_t *s = calloc(1, sizeof(server_t));
+    if (s == NULL) {
+        return -1;
+    }
+    if (ring_init(&s->ring, NET_URING_ENTRIES) < 0) {
+        perror("[NET] io_uring unavailable");
+        free(s);
+        return -1;
+    }
+
+    s->server_fd = server_fd;
+    s->handler = handler;
+    s->ctx = ctx;
+    s->response_size = response_size;
+    s->tick.tv_sec = 1;  // Wake at least once per second to check *running
+    for (int i = 0; i < NET_URING_MAX_CONNS; i++) {
+        s->conns[i].fd = -1;
+        s->conns[i].response = malloc(response_size);
+        if (s->conns[i].response == NULL) {
+            *running = 0;
+        }
+    }
+
+    qos_start(handler, ctx, response_size);
+    queue_accept(s);
+    queue_timeout(s);
+
+    while (*running) {
+        if (ring_submit_and_wait(&s->ring) < 0 && errno != EINTR) {
+            perror("[NET] io_uring_enter");
+            break;
+        }
+
+        struct io_uring_cqe *cqe;
+        while ((cqe = ring_peek_cqe(&s->ring)) != NULL) {
+            uint64_t data = cqe->user_data;
+            int res = cqe->res;
+            ring_cqe_seen(&s->ring);
+            handle_completion(s, (int)(data >> 8), (int)(data & 0xFF), res, running);
+        }
+    }
+
+    // Closing the ring cancels anything still in flight
+    ring_close(&s->ring);
+    qos_stop();
+    for (int i = 0; i < NET_URING_MAX_CONNS; i++) {
+        if (s->conns[i].fd >= 0) close(s->conns[i].fd);
+        free(s->conns[i].response);
+    }
+    free(s);
+    return 0;
+}
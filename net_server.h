@@ -0,0 +1,71 @@
+#ifndef NET_SERVER_H
+#define NET_SERVER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Configuration
+#define NET_LINE_SIZE        256    // Longest accepted command line
+#define NET_URING_MAX_CONNS  4      // Connections served concurrently by io_uring
+#define NET_URING_ENTRIES    32
+
+// Traffic classes (net_server_set_qos)
+#define NET_DSCP_CONTROL         46      // Expedited Forwarding
+#define NET_DSCP_TELEMETRY       10      // AF11
+#define NET_PRIORITY_CONTROL     6       // SO_PRIORITY; 7 needs CAP_NET_ADMIN
+#define NET_PRIORITY_TELEMETRY   0
+#define NET_TELEMETRY_QUEUE      16      // Requests waiting for the telemetry worker
+#define NET_TELEMETRY_NICE       5       // Worker thread, relative to the server
+#define NET_TELEMETRY_RATE       (256 * 1024)   // Default response bytes/s per client
+#define NET_TELEMETRY_BURST      (128 * 1024)
+#define NET_QOS_MAX_CLIENTS      32      // Token buckets, by client address
+
+// Handle one command line; fill 'response' and return its length
+typedef size_t (*net_command_fn)(char *line, char *response, size_t response_size, void *ctx);
+
+typedef enum {
+    NET_CLASS_CONTROL,      // Answered at once on the serving thread
+    NET_CLASS_TELEMETRY,    // Queued for the worker, rate limited per client
+    NET_NUM_CLASSES
+} net_class_t;
+
+typedef net_class_t (*net_classify_fn)(const char *line, void *ctx);
+
+// Syscalls made by the server loop (excluding those inside the handler)
+typedef struct {
+    unsigned long requests;
+    unsigned long syscalls;
+    int clients;            // Connections open right now
+    unsigned long class_requests[NET_NUM_CLASSES];  // Answered by the handler
+    unsigned long rate_limited;     // Telemetry refused by the client's bucket
+    unsigned long queue_full;       // Telemetry refused, worker backlog full
+} net_server_stats_t;
+
+// Traffic classes, set before serving. A control line is handled as soon
+// as it is read and answered with NET_PRIORITY_CONTROL / NET_DSCP_CONTROL.
+// A telemetry line goes to a worker thread running at lower priority;
+// each client address has a token bucket of response bytes (rate per
+// second, up to burst), charged after the reply, and while it is empty the
+// client gets "ERROR: Rate limited, retry in <n> ms". rate 0: no limit.
+// Without a classifier every line is handled in arrival order.
+void net_server_set_qos(net_classify_fn classify, uint32_t rate, uint32_t burst);
+
+// One command per connection: read a line, reply, close.
+// Both return when *running becomes 0 (checked at least once per second).
+int net_serve_blocking(int server_fd, volatile int *running,
+                       net_command_fn handler, void *ctx, size_t response_size);
+
+// io_uring backend: accept, recv, send and close of all connections are
+// queued on one ring and submitted together. Returns -1 immediately if
+// io_uring is unavailable so the caller can fall back.
+//
+// bench/bench_net: ~1.5 server syscalls per request against 13 for the
+// blocking loop, but requests/s over loopback only ~1.1x on average, and
+// individual runs range from slower to ~1.8x: the clients and the
+// handler, not the syscalls, set the rate.
+int net_serve_uring(int server_fd, volatile int *running,
+                    net_command_fn handler, void *ctx, size_t response_size);
+
+void net_server_get_stats(net_server_stats_t *stats);
+
+#endif // NET_SERVER_H
@@ -1,40 +1,170 @@
 #include "pwm.h"
+#include "scheduler.h"
+#include "i2c_bus.h"
+#include "cmd_parse.h"
+#include "recorder.h"
+#include "trace.h"
+#include "snapshot.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <unistd.h>
-#include <fcntl.h>
-#include <sys/ioctl.h>
-#include <linux/i2c-dev.h>
+#include <pthread.h>
 
 // ---------------------------
 // Write a single byte to a PCA9685 register
 // ---------------------------
-int write_register(int fd, uint8_t reg, uint8_t value) {
-    uint8_t buffer[2] = {reg, value};
-    if (write(fd, buffer, 2) != 2) {
-        perror("Failed to write register");
-        return -1;
+int write_register(int dev, uint8_t reg, uint8_t value) {
+    return i2c_bus_write_reg(dev, reg, value);
+}
+
+// Channel writes held back by pwm_batch_begin() on this thread; the last
+// write to a channel wins. "-t" stop changes are held back with them so a
+// discarded or failed write leaves the channel's pending stop alone.
+typedef struct {
+    int active;
+    uint16_t pending;       // Channel mask
+    uint16_t stop_cancel;   // Channels whose pending stop is dropped
+    uint16_t stop_arm;      // Channels that get a new stop
+    int dev[PWM_NUM_CHANNELS];
+    uint16_t on[PWM_NUM_CHANNELS], off[PWM_NUM_CHANNELS];
+    int stop_duration[PWM_NUM_CHANNELS];
+} pwm_batch_t;
+
+static __thread pwm_batch_t batch;
+
+static void cancel_stop(int channel);
+static int schedule_stop(int dev, int channel, int duration);
+
+// Fill the four one-byte register writes of a channel
+static void fill_channel_txns(i2c_txn_t *txns, uint8_t *regs, int dev, int channel,
+                              uint16_t on, uint16_t off) {
+    int base = 0x06 + 4 * channel;
+
+    regs[0] = on & 0xFF;
+    regs[1] = (on >> 8) & 0x0F;
+    regs[2] = off & 0xFF;
+    regs[3] = (off >> 8) & 0x0F;
+    for (int i = 0; i < 4; i++) {
+        txns[i].dev = dev;
+        txns[i].reg = base + i;
+        txns[i].read = 0;
+        txns[i].len = 1;
+        txns[i].data = &regs[i];
     }
-    return 0;
 }
 
 // ---------------------------
-// Set PWM values for a channel
+// Set PWM values for a channel: the four registers go out in one bus
+// request so other devices cannot interleave with a half-written channel
 // ---------------------------
-int set_pwm(int fd, int channel, uint16_t on, uint16_t off) {
-    int base = 0x06 + 4 * channel;
-    if (write_register(fd, base, on & 0xFF) < 0) return -1;
-    if (write_register(fd, base + 1, (on >> 8) & 0x0F) < 0) return -1;
-    if (write_register(fd, base + 2, off & 0xFF) < 0) return -1;
-    if (write_register(fd, base + 3, (off >> 8) & 0x0F) < 0) return -1;
+int set_pwm(int dev, int channel, uint16_t on, uint16_t off) {
+    uint8_t regs[4];
+    i2c_txn_t txns[4];
+
+    if (batch.active) {
+        if (channel < 0 || channel >= PWM_NUM_CHANNELS) {
+            return -1;
+        }
+        batch.pending |= 1u << channel;
+        batch.dev[channel] = dev;
+        batch.on[channel] = on;
+        batch.off[channel] = off;
+        return 0;
+    }
+
+    fill_channel_txns(txns, regs, dev, channel, on, off);
+
+    uint64_t t0 = trace_begin();
+    int result = i2c_bus_transfer(txns, 4);
+    trace_end("set_pwm", t0);
+
+    if (result == 0) {
+        snapshot_publish_pwm(channel, ((off - on) & 0x0FFF) * 100.0f / 4095.0f);
+    }
+    return result;
+}
+
+// ---------------------------
+// Batched writes: set_pwm() on this thread only queues until the flush,
+// which sends every queued channel in one bus request
+// ---------------------------
+void pwm_batch_begin(void) {
+    batch.active = 1;
+    batch.pending = 0;
+    batch.stop_cancel = 0;
+    batch.stop_arm = 0;
+}
+
+void pwm_batch_discard(void) {
+    batch.active = 0;
+    batch.pending = 0;
+    batch.stop_cancel = 0;
+    batch.stop_arm = 0;
+}
+
+// ---------------------------
+// Apply the queued stop changes of a channel whose write went out
+// ---------------------------
+static int flush_stop(int channel) {
+    uint16_t bit = 1u << channel;
+
+    if (batch.stop_cancel & bit) {
+        cancel_stop(channel);
+    }
+    if ((batch.stop_arm & bit) &&
+        schedule_stop(batch.dev[channel], channel, batch.stop_duration[channel]) < 0) {
+        // Never leave a timed channel running without its stop
+        set_pwm(batch.dev[channel], channel, 0, 0);
+        return -1;
+    }
     return 0;
 }
 
+int pwm_batch_flush(void) {
+    uint8_t regs[PWM_BATCH_CHANNELS][4];
+    i2c_txn_t txns[PWM_BATCH_CHANNELS * 4];
+    int channels[PWM_BATCH_CHANNELS];
+    int result = 0;
+    int n = 0;
+
+    batch.active = 0;
+    uint64_t t0 = trace_begin();
+    for (int ch = 0; ch < PWM_NUM_CHANNELS; ch++) {
+        if (batch.pending & (1u << ch)) {
+            fill_channel_txns(&txns[n * 4], regs[n], batch.dev[ch], ch, batch.on[ch], batch.off[ch]);
+            channels[n++] = ch;
+        }
+        if (n == 0 || (n < PWM_BATCH_CHANNELS && ch < PWM_NUM_CHANNELS - 1)) {
+            continue;
+        }
+
+        if (i2c_bus_transfer(txns, n * 4) < 0) {
+            result = -1;
+        } else {
+            for (int i = 0; i < n; i++) {
+                int c = channels[i];
+                snapshot_publish_pwm(c, ((batch.off[c] - batch.on[c]) & 0x0FFF) * 100.0f / 4095.0f);
+                if (flush_stop(c) < 0) {
+                    result = -1;
+                }
+            }
+        }
+        n = 0;
+    }
+    trace_end("pwm_batch", t0);
+
+    batch.pending = 0;
+    batch.stop_cancel = 0;
+    batch.stop_arm = 0;
+    return result;
+}
+
 // ---------------------------
 // Set PWM frequency (Hz)
 // ---------------------------
-int set_pwm_freq(int fd, float freq_hz) {
+int set_pwm_freq(int dev, float freq_hz) {
     if (freq_hz < 24) freq_hz = 24;
     if (freq_hz > 1526) freq_hz = 1526;
 
@@ -42,113 +172,179 @@ int set_pwm_freq(int fd, float freq_hz) {
     uint8_t prescale = (uint8_t)(prescaleval + 0.5);
 
     uint8_t oldmode = 0;
-    read(fd, &oldmode, 1);
+    i2c_bus_read_reg(dev, 0x00, &oldmode);
 
-    write_register(fd, 0x00, 0x10);
-    write_register(fd, 0xFE, prescale);
-    write_register(fd, 0x00, 0x00);
+    write_register(dev, 0x00, 0x10);
+    write_register(dev, 0xFE, prescale);
+    write_register(dev, 0x00, 0x00);
     usleep(5000);
     return 0;
 }
 
+// Pending "-t" stops run as one-shot scheduler tasks (task id + 1, 0 = none)
+static pthread_mutex_t stop_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int stop_task[PWM_NUM_CHANNELS];
+static int stop_dev = -1;
+
 // ---------------------------
-// Initialize I2C and PCA9685
+// One-shot task: stop a channel when its "-t" duration has elapsed
 // ---------------------------
-int init_pwm_controller(void) {
-    int fd = open(I2C_DEVICE, O_RDWR);
-    if (fd < 0) {
-        perror("Failed to open I2C device");
+static void pwm_stop_task(void *arg) {
+    int channel = (int)(intptr_t)arg;
+
+    pthread_mutex_lock(&stop_mutex);
+    stop_task[channel] = 0;
+    int dev = stop_dev;
+    pthread_mutex_unlock(&stop_mutex);
+
+    printf("Stopping PWM Ch%d\n", channel);
+    set_pwm(dev, channel, 0, 0);
+}
+
+// ---------------------------
+// Drop a pending stop; a new command on the channel supersedes it
+// ---------------------------
+static void cancel_stop(int channel) {
+    if (channel < 0 || channel >= PWM_NUM_CHANNELS) {
+        return;
+    }
+
+    if (batch.active) {
+        batch.stop_cancel |= 1u << channel;
+        batch.stop_arm &= ~(1u << channel);
+        return;
+    }
+
+    pthread_mutex_lock(&stop_mutex);
+    int id = stop_task[channel] - 1;
+    stop_task[channel] = 0;
+    pthread_mutex_unlock(&stop_mutex);
+
+    if (id >= 0) {
+        sched_cancel(id);
+    }
+}
+
+// ---------------------------
+// Schedule a channel stop instead of blocking the caller in sleep()
+// ---------------------------
+static int schedule_stop(int dev, int channel, int duration) {
+    if (!sched_is_running() || channel < 0 || channel >= PWM_NUM_CHANNELS ||
+        duration > (int)(UINT32_MAX / 1000000)) {
+        return -1;
+    }
+
+    if (batch.active) {
+        batch.stop_arm |= 1u << channel;
+        batch.stop_duration[channel] = duration;
+        return 0;
+    }
+
+    int id = sched_add_oneshot("pwm_stop", (uint32_t)duration * 1000000, SCHED_PRIO_HIGH,
+                               pwm_stop_task, (void *)(intptr_t)channel);
+    if (id < 0) {
         return -1;
     }
 
-    if (ioctl(fd, I2C_SLAVE, PCA9685_ADDR) < 0) {
-        perror("Failed to set I2C address");
-        close(fd);
+    pthread_mutex_lock(&stop_mutex);
+    stop_dev = dev;
+    stop_task[channel] = id + 1;
+    pthread_mutex_unlock(&stop_mutex);
+    return 0;
+}
+
+// ---------------------------
+// Initialize I2C and PCA9685; returns the bus device handle
+// ---------------------------
+int init_pwm_controller(void) {
+    int dev = i2c_bus_attach(I2C_DEVICE, "pca9685", PCA9685_ADDR, I2C_PRIO_ACTUATOR);
+    if (dev < 0) {
         return -1;
     }
 
-    if (set_pwm_freq(fd, PWM_FREQ) < 0) {
+    if (set_pwm_freq(dev, PWM_FREQ) < 0) {
         fprintf(stderr, "Failed to set PWM frequency\n");
-        close(fd);
+        i2c_bus_detach(dev);
         return -1;
     }
 
-    return fd;
+    return dev;
 }
 
 // ---------------------------
 // Close PWM controller
 // ---------------------------
-void close_pwm_controller(int fd) {
-    if (fd >= 0) {
-        close(fd);
+void close_pwm_controller(int dev) {
+    if (dev >= 0) {
+        i2c_bus_detach(dev);
     }
 }
 
 // ---------------------------
 // Parse and execute PWM command
 // Format: "<pwm1%>" or "<pwm1%> <pwm2%>" or "-c <ch> <pwm%>" or "-t <time> <pwm%>"
+// (options may appear before or after the values)
 // ---------------------------
-int execute_pwm_command(int i2c_fd, char *cmd_str) {
-    char *tokens[10];
-    int token_count = 0;
-    
-    // Tokenize the command
-    char *token = strtok(cmd_str, " \t\n");
-    while (token != NULL && token_count < 10) {
-        tokens[token_count++] = token;
-        token = strtok(NULL, " \t\n");
-    }
-
-    if (token_count == 0) {
-        fprintf(stderr, "Empty command\n");
-        return -1;
-    }
-
-    int duration = 0;
-    int channel = 0;
+int execute_pwm_command(int pwm_dev, char *cmd_str, char *response, size_t response_size) {
+    cmd_parser_t p;
+    cmd_view_t tok;
+    long duration = 0;
+    long channel = 0;
     int use_dual = 0;
+    int values = 0;
     float pwm1 = 0, pwm2 = 0;
     int custom_channel = 0;
     const int max_count = 4095;
 
+    cmd_init(&p, cmd_str);
+    if (cmd_done(&p)) {
+        cmd_fail(&p, "Empty PWM command");
+        return cmd_error(&p, response, response_size);
+    }
+
     // Parse arguments
-    int i = 0;
-    while (i < token_count) {
-        if (strcmp(tokens[i], "-t") == 0) {
-            if (i + 1 >= token_count) {
-                fprintf(stderr, "Missing timeout value\n");
-                return -1;
-            }
-            duration = atoi(tokens[i + 1]);
-            i += 2;
-        } else if (strcmp(tokens[i], "-c") == 0) {
-            if (i + 1 >= token_count) {
-                fprintf(stderr, "Missing channel value\n");
-                return -1;
-            }
-            channel = atoi(tokens[i + 1]);
+    while (cmd_peek(&p, &tok)) {
+        int err;
+
+        if (cmd_match(&p, "-t")) {
+            err = cmd_long(&p, "duration", 0, 3600, &duration);
+        } else if (cmd_match(&p, "-c")) {
+            err = cmd_long(&p, "channel", 0, PWM_NUM_CHANNELS - 1, &channel);
             custom_channel = 1;
-            i += 2;
-        } else {
+        } else if (values < 2) {
             // PWM values
-            pwm1 = atof(tokens[i]);
-            if (i + 1 < token_count && tokens[i + 1][0] != '-') {
-                pwm2 = atof(tokens[i + 1]);
-                use_dual = 1;
-                i += 2;
-            } else {
-                i++;
-            }
-            break;
+            err = cmd_float(&p, "duty cycle", 0.0f, 100.0f, values ? &pwm2 : &pwm1);
+            values++;
+        } else {
+            err = cmd_end(&p);
+        }
+        if (err < 0) {
+            return cmd_error(&p, response, response_size);
         }
     }
 
-    // Validate PWM
-    if (pwm1 < 0 || pwm1 > 100 || (use_dual && (pwm2 < 0 || pwm2 > 100))) {
-        fprintf(stderr, "Error: PWM must be between 0 and 100\n");
-        return -1;
+    if (duration > 0 && batch.active && !sched_is_running()) {
+        // The blocking fallback would stop the channel before the flush
+        cmd_fail(&p, "-t needs --sched inside BATCH");
+        return cmd_error(&p, response, response_size);
+    }
+
+    if (values == 0) {
+        cmd_fail(&p, "Missing duty cycle");
+        return cmd_error(&p, response, response_size);
     }
+    use_dual = values == 2;
+    if (use_dual && custom_channel) {
+        cmd_fail(&p, "Only one duty cycle with -c");
+        return cmd_error(&p, response, response_size);
+    }
+
+    recorder_pwm_t rec = {
+        .channel = use_dual ? REC_PWM_DUAL : (uint8_t)channel,
+        .duration_s = (uint16_t)duration,
+        .duty = { pwm1, pwm2 },
+    };
+    recorder_log(&rec.rec, REC_PWM, sizeof(rec), 0);
 
     // Execute PWM command
     if (use_dual && !custom_channel) {
@@ -157,34 +353,83 @@ int execute_pwm_command(int i2c_fd, char *cmd_str) {
         uint16_t off2 = (uint16_t)((pwm2 / 100.0) * max_count);
 
         printf("Setting Ch0=%.1f%%, Ch1=%.1f%%", pwm1, pwm2);
-        if (duration > 0) printf(" for %ds", duration);
+        if (duration > 0) printf(" for %lds", duration);
         printf("\n");
 
-        set_pwm(i2c_fd, 0, 0, off1);
-        set_pwm(i2c_fd, 1, 0, off2);
+        cancel_stop(0);
+        cancel_stop(1);
+        set_pwm(pwm_dev, 0, 0, off1);
+        set_pwm(pwm_dev, 1, 0, off2);
 
-        if (duration > 0) {
+        if (duration > 0 && (schedule_stop(pwm_dev, 0, duration) < 0 ||
+                             schedule_stop(pwm_dev, 1, duration) < 0)) {
+            // No scheduler running: block until the duration has elapsed
+            cancel_stop(0);
             sleep(duration);
             printf("Stopping PWM\n");
-            set_pwm(i2c_fd, 0, 0, 0);
-            set_pwm(i2c_fd, 1, 0, 0);
+            set_pwm(pwm_dev, 0, 0, 0);
+            set_pwm(pwm_dev, 1, 0, 0);
         }
     } else {
         // Single channel
         uint16_t off1 = (uint16_t)((pwm1 / 100.0) * max_count);
 
-        printf("Setting Ch%d=%.1f%%", channel, pwm1);
-        if (duration > 0) printf(" for %ds", duration);
+        printf("Setting Ch%ld=%.1f%%", channel, pwm1);
+        if (duration > 0) printf(" for %lds", duration);
         printf("\n");
 
-        set_pwm(i2c_fd, channel, 0, off1);
+        cancel_stop(channel);
+        set_pwm(pwm_dev, channel, 0, off1);
 
-        if (duration > 0) {
+        if (duration > 0 && schedule_stop(pwm_dev, channel, duration) < 0) {
+            // No scheduler running: block until the duration has elapsed
             sleep(duration);
             printf("Stopping PWM\n");
-            set_pwm(i2c_fd, channel, 0, 0);
+            set_pwm(pwm_dev, channel, 0, 0);
         }
     }
 
+    snprintf(response, response_size, "OK\n");
     return 0;
 }
+
+// ---------------------------
+// Registry hooks
+// ---------------------------
+static int module_dev = -1;
+
+int pwm_module_dev(void) {
+    return module_dev;
+}
+
+static int pwm_module_init(void) {
+    printf("Initializing PWM controller...\n");
+    module_dev = init_pwm_controller();
+    return module_dev >= 0 ? 0 : -1;
+}
+
+static void pwm_module_stop(void) {
+    // Pending "-t" stops must not fire on a detached device
+    for (int channel = 0; channel < PWM_NUM_CHANNELS; channel++) {
+        cancel_stop(channel);
+    }
+    close_pwm_controller(module_dev);
+    module_dev = -1;
+}
+
+static int pwm_module_command(char *cmd_str, char *response, size_t response_size) {
+    return execute_pwm_command(module_dev, cmd_str, response, response_size);
+}
+
+// Motor control is required; bare "<pwm%>" lines land here too
+const module_t pwm_module = {
+    .name = "pwm",
+    .prefix = "PWM",
+    .usage = "<pwm%> | PWM <pwm%> | PWM -c <ch> <pwm%> | PWM -t <s> <pwm%>",
+    .required = 1,
+    .fallback = 1,
+    .control = 1,
+    .init = pwm_module_init,
+    .stop = pwm_module_stop,
+    .command = pwm_module_command,
+};
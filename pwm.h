@@ -2,21 +2,40 @@
 #define PWM_H
 
 #include <stdint.h>
+#include <stddef.h>
+#include "module.h"
 
 // Configuration
 #define I2C_DEVICE "/dev/i2c-1"
 #define PCA9685_ADDR 0x40
 #define PWM_FREQ 50.0
+#define PWM_NUM_CHANNELS 16
+#define PWM_BATCH_CHANNELS 10   // Per flush request: 40 register writes, I2C_RDWR takes 42
 
 // PWM Controller Functions
+// (devices are i2c_bus handles, see i2c_bus.h)
 int init_pwm_controller(void);
-void close_pwm_controller(int fd);
-int set_pwm(int fd, int channel, uint16_t on, uint16_t off);
-int set_pwm_freq(int fd, float freq_hz);
-int write_register(int fd, uint8_t reg, uint8_t value);
+void close_pwm_controller(int dev);
+int set_pwm(int dev, int channel, uint16_t on, uint16_t off);
+int set_pwm_freq(int dev, float freq_hz);
+int write_register(int dev, uint8_t reg, uint8_t value);
+
+// Batched writes (BATCH command): between begin and flush/discard,
+// set_pwm() calls made on the same thread are only queued, and so are the
+// "-t" stop cancels and schedules of PWM commands. The flush sends the
+// writes together (one bus request per PWM_BATCH_CHANNELS channels) and
+// applies a channel's stop changes once its write went out; -1 if any
+// write failed. A discard drops both.
+void pwm_batch_begin(void);
+int pwm_batch_flush(void);
+void pwm_batch_discard(void);
 
 // Command execution
-int execute_pwm_command(int i2c_fd, char *cmd_str);
+int execute_pwm_command(int pwm_dev, char *cmd_str, char *response, size_t response_size);
+
+// Registry descriptor (module.h); pwm_module_dev() is -1 until it is ready
+extern const module_t pwm_module;
+int pwm_module_dev(void);
 
 #endif // PWM_H
 
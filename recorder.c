@@ -0,0 +1,555 @@
+#define _GNU_SOURCE     // sync_file_range
+#include "recorder.h"
+#include "cmd_parse.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+
+// The decoder reads these layouts straight from the file
+_Static_assert(sizeof(recorder_file_header_t) == 32, "file header layout");
+_Static_assert(sizeof(recorder_record_t) == 8, "record header layout");
+_Static_assert(sizeof(recorder_index_t) == 32, "index record layout");
+_Static_assert(sizeof(recorder_imu_t) == 60, "IMU record layout");
+_Static_assert(sizeof(recorder_sonar_t) == 16, "sonar record layout");
+_Static_assert(sizeof(recorder_pwm_t) == 20, "PWM record layout");
+
+// One preallocated, mapped file
+typedef struct {
+    int fd;
+    uint8_t *base;
+    size_t size;
+    size_t used;
+    uint32_t number;
+    char path[RECORDER_PATH_SIZE];
+} segment_t;
+
+#define NO_SEGMENT  ((segment_t){ .fd = -1 })
+
+// Static variables
+static pthread_mutex_t rec_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t rec_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t writer_thread;
+static volatile int recording = 0;
+static int thread_running = 0;
+
+// Producers write into 'active'. The writer thread prepares 'standby' and
+// closes 'retired', so file creation and write-back stay off the sensor
+// threads.
+static segment_t active = { .fd = -1 };
+static segment_t standby = { .fd = -1 };
+static segment_t retired = { .fd = -1 };
+
+static char file_prefix[RECORDER_PATH_SIZE - 32];
+static char record_dir[RECORDER_PATH_SIZE / 2] = RECORDER_DEFAULT_DIR;
+static char run_stamp[16];   // YYYYmmdd-HHMMSS
+static size_t segment_size = 0;
+static uint32_t next_number = 0;
+static size_t block_end = 0;        // End of the current block in 'active'
+static uint64_t block_time_us = 0;
+static uint64_t records = 0;
+static unsigned long dropped = 0;
+static unsigned long rotations = 0;
+
+static uint64_t get_time_microseconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+// ---------------------------
+// Create, preallocate and map one file, header written
+// ---------------------------
+static int open_segment(segment_t *s, uint32_t number) {
+    struct timespec real;
+    int err;
+
+    *s = NO_SEGMENT;
+    s->number = number;
+    s->size = segment_size;
+    snprintf(s->path, sizeof(s->path), "%s-%s-%03u.vtl", file_prefix, run_stamp, number);
+
+    s->fd = open(s->path, O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0644);
+    if (s->fd < 0) {
+        fprintf(stderr, "[REC] Error: Cannot create %s: %s\n", s->path, strerror(errno));
+        return -1;
+    }
+    // Blocks are allocated now so appends never wait for block allocation
+    err = posix_fallocate(s->fd, 0, s->size);
+    if (err == 0) {
+        void *base = mmap(NULL, s->size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          s->fd, 0);
+        if (base == MAP_FAILED) {
+            err = errno;
+        } else {
+            s->base = base;
+        }
+    }
+    if (s->base == NULL) {
+        fprintf(stderr, "[REC] Error: Cannot map %s: %s\n", s->path, strerror(err));
+        close(s->fd);
+        unlink(s->path);
+        *s = NO_SEGMENT;
+        return -1;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &real);
+    recorder_file_header_t header = {
+        .magic = RECORDER_MAGIC,
+        .version = RECORDER_VERSION,
+        .header_size = RECORDER_HEADER_SIZE,
+        .block_size = RECORDER_BLOCK_SIZE,
+        .segment = number,
+        .created_mono_us = get_time_microseconds(),
+        .created_real_us = (uint64_t)real.tv_sec * 1000000ULL + real.tv_nsec / 1000,
+    };
+    memcpy(s->base, &header, sizeof(header));
+    s->used = RECORDER_HEADER_SIZE;
+    return 0;
+}
+
+// Flush and trim a finished file, or delete an unused one
+static void close_segment(segment_t *s, int keep) {
+    if (s->base == NULL) return;
+
+    if (keep) {
+        msync(s->base, s->used, MS_SYNC);
+    }
+    munmap(s->base, s->size);
+    if (keep) {
+        if (ftruncate(s->fd, s->used) < 0) {
+            fprintf(stderr, "[REC] Warning: Cannot trim %s\n", s->path);
+        }
+        printf("[REC] Closed %s (%zu bytes)\n", s->path, s->used);
+    }
+    close(s->fd);
+    if (!keep) {
+        unlink(s->path);
+    }
+    *s = NO_SEGMENT;
+}
+
+// ---------------------------
+// Write-fault the pages from 'from' to RECORDER_PREFAULT_KB past it.
+// MAP_POPULATE only read-faults a shared mapping, and write-back makes
+// pages read-only again, so without this the first store to each page
+// would go through the filesystem's page_mkwrite with rec_mutex held on a
+// sensor thread. OR-ing zero keeps the bytes as they are, even when a
+// producer writes the same page meanwhile.
+// ---------------------------
+static void prefault(uint8_t *base, size_t size, size_t from) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t end = from + RECORDER_PREFAULT_KB * 1024;
+
+    if (base == NULL) return;
+    if (end > size) end = size;
+    for (size_t off = from & ~(page - 1); off < end; off += page) {
+        __atomic_fetch_or(base + off, 0, __ATOMIC_RELAXED);
+    }
+}
+
+// ---------------------------
+// Writer thread: keeps a standby file ready, closes full files,
+// periodically writes back the active one and keeps the pages ahead of
+// its append point (and the start of the standby one) writable
+// ---------------------------
+static void *recorder_thread(void *arg) {
+    (void)arg;
+    prctl(PR_SET_NAME, "rec-writer");
+
+    pthread_mutex_lock(&rec_mutex);
+    while (thread_running) {
+        if (retired.base) {
+            segment_t done = retired;
+            retired = NO_SEGMENT;
+            pthread_mutex_unlock(&rec_mutex);
+            close_segment(&done, 1);
+            pthread_mutex_lock(&rec_mutex);
+            continue;
+        }
+
+        if (standby.base == NULL) {
+            segment_t next;
+            uint32_t number = next_number;
+            pthread_mutex_unlock(&rec_mutex);
+            int ok = open_segment(&next, number) == 0;
+            pthread_mutex_lock(&rec_mutex);
+            if (ok) {
+                standby = next;
+                next_number++;
+                continue;
+            }
+            // Retry after the sync period
+        }
+
+        // Start write-back of the pages filled so far without waiting for
+        // it; only this thread closes files, so the fd stays valid unlocked.
+        // The page being appended to is left out: write-back write-protects
+        // it and the next store from a sampler thread would fault.
+        int fd = active.fd;
+        size_t full = active.used & ~((size_t)sysconf(_SC_PAGESIZE) - 1);
+        segment_t cur = active, next = standby;
+        pthread_mutex_unlock(&rec_mutex);
+        if (fd >= 0 && full > 0) {
+            sync_file_range(fd, 0, full, SYNC_FILE_RANGE_WRITE);
+        }
+        prefault(cur.base, cur.size, cur.used);
+        prefault(next.base, next.size, RECORDER_HEADER_SIZE);
+        pthread_mutex_lock(&rec_mutex);
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += RECORDER_SYNC_MS / 1000;
+        deadline.tv_nsec += (RECORDER_SYNC_MS % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_nsec -= 1000000000L;
+            deadline.tv_sec++;
+        }
+        if (thread_running && retired.base == NULL) {
+            pthread_cond_timedwait(&rec_cond, &rec_mutex, &deadline);
+        }
+    }
+
+    segment_t last = active, done = retired, unused = standby;
+    active = retired = standby = NO_SEGMENT;
+    pthread_mutex_unlock(&rec_mutex);
+
+    close_segment(&done, 1);
+    close_segment(&last, 1);
+    close_segment(&unused, 0);
+    return NULL;
+}
+
+// ---------------------------
+// Producer side (rec_mutex held)
+// ---------------------------
+
+// Hand the active file to the writer thread and continue in the standby one
+static int switch_segment(void) {
+    if (standby.base == NULL || retired.base != NULL) {
+        return -1;
+    }
+    retired = active;
+    active = standby;
+    standby = NO_SEGMENT;
+    block_end = RECORDER_HEADER_SIZE;
+    rotations++;
+    pthread_cond_signal(&rec_cond);
+    return 0;
+}
+
+// Start the next block with its index record
+static int begin_block(uint64_t time_us) {
+    if (block_end + RECORDER_BLOCK_SIZE > active.size && switch_segment() < 0) {
+        return -1;
+    }
+
+    size_t pos = block_end;
+    recorder_index_t index = {
+        .rec = { .type = REC_INDEX, .size = sizeof(recorder_index_t) },
+        .time_us = time_us,
+        .seq = records,
+        .block = (uint32_t)((pos - RECORDER_HEADER_SIZE) / RECORDER_BLOCK_SIZE),
+    };
+    memcpy(active.base + pos, &index, sizeof(index));
+    active.used = pos + sizeof(index);
+    block_end = pos + RECORDER_BLOCK_SIZE;
+    block_time_us = time_us;
+    return 0;
+}
+
+void recorder_log(recorder_record_t *rec, recorder_type_t type, size_t size, uint64_t time_us) {
+    if (!recording) {
+        return;
+    }
+    if (time_us == 0) {
+        time_us = get_time_microseconds();
+    }
+    rec->type = type;
+    rec->size = (uint8_t)size;
+    rec->reserved = 0;
+
+    pthread_mutex_lock(&rec_mutex);
+    if (!recording) {
+        pthread_mutex_unlock(&rec_mutex);
+        return;
+    }
+
+    // Sensor threads stamp before taking the lock, so slightly older
+    // times than the block's are normal
+    int64_t dt = (int64_t)(time_us - block_time_us);
+    if (active.used + size > block_end || dt < INT32_MIN || dt > INT32_MAX) {
+        if (begin_block(time_us) < 0) {
+            dropped++;
+            pthread_mutex_unlock(&rec_mutex);
+            return;
+        }
+        dt = 0;
+    }
+    rec->dt_us = (int32_t)dt;
+    memcpy(active.base + active.used, rec, size);
+    active.used += size;
+    records++;
+    pthread_mutex_unlock(&rec_mutex);
+}
+
+// ---------------------------
+// Control
+// ---------------------------
+int recorder_set_dir(const char *dir) {
+    if (strlen(dir) >= sizeof(record_dir)) {
+        return -1;
+    }
+    pthread_mutex_lock(&rec_mutex);
+    strcpy(record_dir, dir);
+    pthread_mutex_unlock(&rec_mutex);
+    return 0;
+}
+
+int recorder_start(const char *prefix, unsigned segment_mb) {
+    time_t now = time(NULL);
+    struct tm local;
+
+    pthread_mutex_lock(&rec_mutex);
+    if (thread_running) {
+        pthread_mutex_unlock(&rec_mutex);
+        fprintf(stderr, "[REC] Already recording\n");
+        return -1;
+    }
+
+    snprintf(file_prefix, sizeof(file_prefix), "%s", prefix ? prefix : RECORDER_DEFAULT_PREFIX);
+    localtime_r(&now, &local);
+    strftime(run_stamp, sizeof(run_stamp), "%Y%m%d-%H%M%S", &local);
+    if (segment_mb == 0) {
+        segment_mb = RECORDER_SEGMENT_MB;
+    }
+    segment_size = RECORDER_HEADER_SIZE +
+                   ((size_t)segment_mb << 20) / RECORDER_BLOCK_SIZE * RECORDER_BLOCK_SIZE;
+    next_number = 0;
+    records = 0;
+    dropped = 0;
+    rotations = 0;
+
+    if (open_segment(&active, next_number) < 0) {
+        pthread_mutex_unlock(&rec_mutex);
+        return -1;
+    }
+    next_number++;
+    block_end = RECORDER_HEADER_SIZE;
+
+    thread_running = 1;
+    if (pthread_create(&writer_thread, NULL, recorder_thread, NULL) != 0) {
+        thread_running = 0;
+        close_segment(&active, 0);
+        pthread_mutex_unlock(&rec_mutex);
+        fprintf(stderr, "[REC] Error: Cannot start writer thread\n");
+        return -1;
+    }
+    recording = 1;
+    printf("[REC] Recording to %s\n", active.path);
+    pthread_mutex_unlock(&rec_mutex);
+    return 0;
+}
+
+void recorder_stop(void) {
+    pthread_mutex_lock(&rec_mutex);
+    if (!thread_running) {
+        pthread_mutex_unlock(&rec_mutex);
+        return;
+    }
+    recording = 0;
+    thread_running = 0;
+    pthread_cond_signal(&rec_cond);
+    pthread_mutex_unlock(&rec_mutex);
+
+    pthread_join(writer_thread, NULL);
+    printf("[REC] Stopped: %llu records, %lu dropped\n", (unsigned long long)records, dropped);
+}
+
+int recorder_rotate(void) {
+    pthread_mutex_lock(&rec_mutex);
+    int result = recording ? switch_segment() : -1;
+    pthread_mutex_unlock(&rec_mutex);
+    return result;
+}
+
+int recorder_is_active(void) {
+    return recording;
+}
+
+// ---------------------------
+// Reading: map the file and walk its blocks
+// ---------------------------
+static const uint8_t *map_file(const char *path, size_t *size, recorder_file_header_t *header) {
+    struct stat st;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(*header)) {
+        close(fd);
+        return NULL;
+    }
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+
+    memcpy(header, base, sizeof(*header));
+    if (header->magic != RECORDER_MAGIC || header->version != RECORDER_VERSION ||
+        header->header_size < sizeof(*header) ||
+        header->block_size < sizeof(recorder_index_t)) {
+        munmap(base, st.st_size);
+        return NULL;
+    }
+    *size = st.st_size;
+    return base;
+}
+
+int recorder_read_header(const char *path, recorder_file_header_t *header) {
+    size_t size;
+    const uint8_t *base = map_file(path, &size, header);
+    if (base == NULL) {
+        return -1;
+    }
+    munmap((void *)base, size);
+    return 0;
+}
+
+int recorder_read_file(const char *path, uint64_t from_us, recorder_visit_fn fn, void *ctx) {
+    recorder_file_header_t header;
+    size_t size;
+    int result = 0;
+
+    const uint8_t *base = map_file(path, &size, &header);
+    if (base == NULL) {
+        return -1;
+    }
+
+    for (size_t block = header.header_size;
+         result == 0 && block + sizeof(recorder_index_t) <= size;
+         block += header.block_size) {
+        recorder_index_t index, next;
+        memcpy(&index, base + block, sizeof(index));
+        if (index.rec.type != REC_INDEX) break;  // Unused tail of a live file
+
+        // Nothing in this block is wanted if the next one starts before from_us
+        size_t next_block = block + header.block_size;
+        if (next_block + sizeof(next) <= size) {
+            memcpy(&next, base + next_block, sizeof(next));
+            if (next.rec.type == REC_INDEX && next.time_us <= from_us) continue;
+        }
+
+        size_t end = next_block < size ? next_block : size;
+        for (size_t pos = block + index.rec.size; pos + sizeof(recorder_record_t) <= end;) {
+            const recorder_record_t *rec = (const recorder_record_t *)(base + pos);
+            if (rec->type == REC_END || rec->size < sizeof(*rec) || pos + rec->size > end) break;
+
+            uint64_t time_us = index.time_us + rec->dt_us;
+            if (time_us >= from_us && (result = fn(rec, time_us, ctx)) != 0) break;
+            pos += rec->size;
+        }
+    }
+
+    munmap((void *)base, size);
+    return result;
+}
+
+// ---------------------------
+// Execute recorder command
+// Commands:
+//   "status" (or empty)          - Current file and counters
+//   "start [<prefix> [<MB>]]"    - Record to <dir>/<prefix>-<date>-<n>.vtl files,
+//                                  <dir> from --record-dir (default recordings)
+//   "stop"                       - Close the current file
+//   "rotate"                     - Continue in a new file now
+// ---------------------------
+int execute_recorder_command(char *cmd_str, char *response, size_t response_size) {
+    static const char *const commands[] = { "status", "start", "stop", "rotate" };
+    enum { CMD_STATUS, CMD_START, CMD_STOP, CMD_ROTATE };
+    cmd_parser_t p;
+
+    if (cmd_str == NULL || response == NULL) {
+        return -1;
+    }
+
+    cmd_init(&p, cmd_str);
+    int cmd = cmd_done(&p) ? CMD_STATUS : cmd_keyword(&p, "REC command", commands, 4);
+    if (cmd < 0) {
+        return cmd_error(&p, response, response_size);
+    }
+
+    if (cmd == CMD_START) {
+        char name[64] = RECORDER_DEFAULT_PREFIX;
+        char prefix[sizeof(file_prefix)];
+        long segment_mb = 0;
+
+        // A bare name: the client cannot write outside the recording directory
+        if (!cmd_done(&p)) {
+            if (cmd_filename(&p, "file prefix", name, sizeof(name)) < 0 ||
+                (!cmd_done(&p) && cmd_long(&p, "size (MB)", 1, 4096, &segment_mb) < 0)) {
+                return cmd_error(&p, response, response_size);
+            }
+        }
+        if (cmd_end(&p) < 0) {
+            return cmd_error(&p, response, response_size);
+        }
+
+        pthread_mutex_lock(&rec_mutex);
+        snprintf(prefix, sizeof(prefix), "%s/%s", record_dir, name);
+        int made = mkdir(record_dir, 0755) == 0 || errno == EEXIST;
+        pthread_mutex_unlock(&rec_mutex);
+        if (!made || recorder_start(prefix, (unsigned)segment_mb) < 0) {
+            snprintf(response, response_size, "ERROR: Cannot start recording\n");
+            return -1;
+        }
+        snprintf(response, response_size, "OK\n");
+        return 0;
+    }
+
+    if (cmd_end(&p) < 0) {
+        return cmd_error(&p, response, response_size);
+    }
+
+    if (cmd == CMD_STOP) {
+        recorder_stop();
+        snprintf(response, response_size, "OK\n");
+        return 0;
+    }
+    if (cmd == CMD_ROTATE) {
+        if (recorder_rotate() < 0) {
+            snprintf(response, response_size, "ERROR: %s\n",
+                     recording ? "Next file not ready" : "Not recording");
+            return -1;
+        }
+        snprintf(response, response_size, "OK\n");
+        return 0;
+    }
+
+    pthread_mutex_lock(&rec_mutex);
+    snprintf(response, response_size,
+             "{\"recording\":%s,\"file\":\"%s\",\"bytes\":%zu,\"size\":%zu,"
+             "\"records\":%llu,\"dropped\":%lu,\"rotations\":%lu}\n",
+             recording ? "true" : "false", active.base ? active.path : "",
+             active.base ? active.used : 0, segment_size,
+             (unsigned long long)records, dropped, rotations);
+    pthread_mutex_unlock(&rec_mutex);
+    return 0;
+}
+
+const module_t recorder_module = {
+    .name = "recorder",
+    .prefix = "REC",
+    .usage = "REC [status] | start [<prefix> [<MB>]] | stop | rotate",
+    .stop = recorder_stop,
+    .command = execute_recorder_command,
+};
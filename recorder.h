@@ -0,0 +1,134 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "module.h"
+
+// Configuration
+#define RECORDER_DEFAULT_PREFIX  "telemetry"
+#define RECORDER_DEFAULT_DIR     "recordings"  // For "REC start" (--record-dir)
+#define RECORDER_SEGMENT_MB      16        // Preallocated size of each file
+#define RECORDER_BLOCK_SIZE      65536     // Spacing of the index records
+#define RECORDER_SYNC_MS         1000      // Write-back period of the active file
+#define RECORDER_PREFAULT_KB     256       // Kept writable ahead of the append point
+#define RECORDER_PATH_SIZE       256
+
+// ---------------------------
+// File format, shared with tools/telemetry_decode (little-endian)
+//
+// A file is a RECORDER_HEADER_SIZE header followed by blocks of
+// block_size bytes. Every block starts with an index record; records never
+// cross a block boundary and a zero type ends a block early. Record times
+// are signed microsecond offsets from the block's index time, on the
+// CLOCK_MONOTONIC clock the sensor threads use.
+// ---------------------------
+#define RECORDER_MAGIC        0x4D4C5456u   // "VTLM"
+#define RECORDER_VERSION      1
+#define RECORDER_HEADER_SIZE  4096
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t block_size;
+    uint32_t segment;           // Rotation count since "REC start"
+    uint64_t created_mono_us;   // Both clocks at creation, to turn record
+    uint64_t created_real_us;   // times into dates
+} recorder_file_header_t;
+
+typedef enum {
+    REC_END = 0,
+    REC_INDEX = 1,
+    REC_IMU = 2,
+    REC_SONAR = 3,
+    REC_PWM = 4,
+} recorder_type_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t size;       // Whole record, header included, multiple of 4
+    uint16_t reserved;
+    int32_t dt_us;      // Offset from the block's index time
+} recorder_record_t;
+
+typedef struct {
+    recorder_record_t rec;
+    uint64_t time_us;   // Block base time
+    uint64_t seq;       // Data records written before this block
+    uint32_t block;
+    uint32_t reserved;
+} recorder_index_t;
+
+typedef struct {
+    recorder_record_t rec;
+    float accel[3];     // m/s^2
+    float gyro[3];      // rad/s
+    float mag[3];       // uT
+    float temp;
+    float roll, pitch, yaw;
+} recorder_imu_t;
+
+typedef struct {
+    recorder_record_t rec;
+    float distance_cm;
+    uint8_t valid;
+    uint8_t reserved[3];
+} recorder_sonar_t;
+
+#define REC_PWM_DUAL  0xFF  // Channel field of a "<ch0> <ch1>" command
+
+typedef struct {
+    recorder_record_t rec;
+    uint8_t channel;
+    uint8_t reserved;
+    uint16_t duration_s;
+    float duty[2];      // Percent; duty[1] only for REC_PWM_DUAL
+} recorder_pwm_t;
+
+// ---------------------------
+// Recorder
+// ---------------------------
+
+// Record into <prefix>-<date>-<n>.vtl files of segment_mb each (0 for the
+// default). Full files are closed and the next one is used.
+int recorder_start(const char *prefix, unsigned segment_mb);
+
+// Directory of the files "REC start <name>" creates; the command takes a
+// bare name, recorder_start() a path
+int recorder_set_dir(const char *dir);
+void recorder_stop(void);
+int recorder_rotate(void);
+int recorder_is_active(void);
+
+// Append one record from any thread: fills in the header and copies 'size'
+// bytes into the mapped file. The writer thread write-faults the next
+// RECORDER_PREFAULT_KB every RECORDER_SYNC_MS, so appends do not wait on
+// the filesystem unless records arrive faster than that or the kernel
+// writes a page back between two passes. A record that does not fit while
+// the next file is still being prepared is counted as dropped.
+// time_us 0 means now.
+void recorder_log(recorder_record_t *rec, recorder_type_t type, size_t size, uint64_t time_us);
+
+// ---------------------------
+// Reading recorded files (decoder, replay)
+// ---------------------------
+
+// Called for each data record in file order with its absolute time;
+// a nonzero return stops the walk and is returned by recorder_read_file()
+typedef int (*recorder_visit_fn)(const recorder_record_t *rec, uint64_t time_us, void *ctx);
+
+// 0, or -1 if the file is unreadable or not a recorder file
+int recorder_read_header(const char *path, recorder_file_header_t *header);
+
+// Walk the records of one file. Blocks that end before from_us are skipped
+// through their index records without being read.
+int recorder_read_file(const char *path, uint64_t from_us, recorder_visit_fn fn, void *ctx);
+
+// Command execution
+int execute_recorder_command(char *cmd_str, char *response, size_t response_size);
+
+// Registry descriptor (module.h), command-only
+extern const module_t recorder_module;
+
+#endif // RECORDER_H
@@ -0,0 +1,373 @@
+#include "replay.h"
+#include "recorder.h"
+#include "cmd_parse.h"
+#include "hal.h"
+#ifndef MODULE_NO_IMU
+#include "imu.h"
+#endif
+#ifndef MODULE_NO_SONAR
+#include "sonar.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/prctl.h>
+
+// Progress of the current (or last) replay
+typedef struct {
+    int file;                   // Index in files[]
+    uint64_t first_us;          // Time of the first record played
+    uint64_t position_us;       // Time of the last record played
+    unsigned long imu, sonar, pwm;
+    double max_lag_us;          // Worst delay behind the paced schedule
+    uint64_t end_ns;            // When the replay ended, 0 while running
+    int finished;
+    int failed;
+} replay_progress_t;
+
+// Static variables
+static pthread_mutex_t replay_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t replay_thread;
+static int thread_started = 0;
+static volatile int replay_running = 0;
+static char files[REPLAY_MAX_FILES][RECORDER_PATH_SIZE];
+static int file_count = 0;
+static float replay_speed = 1.0f;
+static replay_progress_t progress;
+static int boot_pending = 0;    // Set by replay_configure()
+
+// Pacing: record time first_us is played at start_ns, later ones at
+// start_ns + (t - first_us) / speed
+static uint64_t start_ns = 0;
+
+static uint64_t get_time_nanoseconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Sleep until 'due', waking every REPLAY_POLL_MS to notice a stop.
+// Returns 0 if stopped meanwhile.
+static int wait_until(uint64_t due) {
+    while (replay_running) {
+        uint64_t now = get_time_nanoseconds();
+        if (now >= due) {
+            return 1;
+        }
+        uint64_t wake = due - now > REPLAY_POLL_MS * 1000000ULL ?
+                        now + REPLAY_POLL_MS * 1000000ULL : due;
+        struct timespec ts = { (time_t)(wake / 1000000000ULL), (long)(wake % 1000000000ULL) };
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+    }
+    return 0;
+}
+
+// ---------------------------
+// Play one record at its time
+// ---------------------------
+static int play_record(const recorder_record_t *rec, uint64_t time_us, void *ctx) {
+    (void)ctx;
+
+    if (!replay_running) {
+        return 1;
+    }
+
+    pthread_mutex_lock(&replay_mutex);
+    if (progress.first_us == 0) {
+        progress.first_us = time_us;
+        start_ns = get_time_nanoseconds();
+    }
+    uint64_t first_us = progress.first_us;
+    pthread_mutex_unlock(&replay_mutex);
+
+    double lag_us = 0.0;
+    if (replay_speed > 0.0f) {
+        // Records of different sensors may be slightly out of order
+        double offset_ns = time_us > first_us ? (time_us - first_us) * 1000.0 / replay_speed : 0.0;
+        uint64_t due = start_ns + (uint64_t)offset_ns;
+        if (!wait_until(due)) {
+            return 1;
+        }
+        lag_us = (get_time_nanoseconds() - due) / 1000.0;
+    }
+
+    switch (rec->type) {
+    case REC_IMU: {
+        recorder_imu_t r;
+        memcpy(&r, rec, sizeof(r));
+#ifndef MODULE_NO_IMU
+        imu_data_t sample = {
+            .accel_x = r.accel[0], .accel_y = r.accel[1], .accel_z = r.accel[2],
+            .gyro_x = r.gyro[0], .gyro_y = r.gyro[1], .gyro_z = r.gyro[2],
+            .mag_x = r.mag[0], .mag_y = r.mag[1], .mag_z = r.mag[2],
+            .temp = r.temp,
+            .timestamp_us = time_us,
+        };
+        imu_replay_sample(&sample);
+#endif
+        break;
+    }
+    case REC_SONAR: {
+        recorder_sonar_t r;
+        memcpy(&r, rec, sizeof(r));
+#ifndef MODULE_NO_SONAR
+        sonar_replay_measurement(r.distance_cm, r.valid, time_us);
+#endif
+        break;
+    }
+    default:
+        break;  // PWM commands were outputs, not sensor data
+    }
+
+    pthread_mutex_lock(&replay_mutex);
+    progress.position_us = time_us;
+    if (rec->type == REC_IMU) progress.imu++;
+    else if (rec->type == REC_SONAR) progress.sonar++;
+    else if (rec->type == REC_PWM) progress.pwm++;
+    if (lag_us > progress.max_lag_us) progress.max_lag_us = lag_us;
+    pthread_mutex_unlock(&replay_mutex);
+    return 0;
+}
+
+// ---------------------------
+// Replay thread
+// ---------------------------
+static void *replay_thread_main(void *arg) {
+    (void)arg;
+
+    prctl(PR_SET_NAME, "replay");
+    printf("[REPLAY] Playing %d file(s) at %s\n", file_count,
+           replay_speed > 0.0f ? "recorded pace" : "full speed");
+#ifndef MODULE_NO_IMU
+    imu_replay_begin();
+#endif
+#ifndef MODULE_NO_SONAR
+    sonar_replay_begin();
+#endif
+
+    int result = 0;
+    for (int i = 0; i < file_count && result == 0; i++) {
+        pthread_mutex_lock(&replay_mutex);
+        progress.file = i;
+        pthread_mutex_unlock(&replay_mutex);
+
+        result = recorder_read_file(files[i], 0, play_record, NULL);
+        if (result < 0) {
+            fprintf(stderr, "[REPLAY] Error: Cannot read %s\n", files[i]);
+        }
+    }
+
+#ifndef MODULE_NO_SONAR
+    sonar_replay_end();
+#endif
+#ifndef MODULE_NO_IMU
+    imu_replay_end();
+#endif
+
+    pthread_mutex_lock(&replay_mutex);
+    progress.end_ns = get_time_nanoseconds();
+    progress.finished = result == 0;
+    progress.failed = result < 0;
+    printf("[REPLAY] %s: %lu IMU, %lu sonar records, max lag %.1f ms\n",
+           result == 0 ? "Finished" : result < 0 ? "Failed" : "Stopped",
+           progress.imu, progress.sonar, progress.max_lag_us / 1000.0);
+    pthread_mutex_unlock(&replay_mutex);
+
+    replay_running = 0;
+    return NULL;
+}
+
+// ---------------------------
+// Control
+// ---------------------------
+static int set_files(const char *const *paths, int count, float speed) {
+    if (count < 1 || count > REPLAY_MAX_FILES || speed < 0.0f) {
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        recorder_file_header_t header;
+        if (strlen(paths[i]) >= RECORDER_PATH_SIZE || recorder_read_header(paths[i], &header) < 0) {
+            fprintf(stderr, "[REPLAY] Error: %s is not a telemetry file\n", paths[i]);
+            return -1;
+        }
+        strcpy(files[i], paths[i]);
+    }
+    file_count = count;
+    replay_speed = speed;
+    return 0;
+}
+
+int replay_start(const char *const *paths, int count, float speed) {
+    // The heading controller acts on replayed attitude: never on real motors
+    if (!hal_is_emulated()) {
+        errno = EPERM;
+        return -1;
+    }
+    replay_stop();
+
+    if (set_files(paths, count, speed) < 0) {
+        return -1;
+    }
+    memset(&progress, 0, sizeof(progress));
+
+    replay_running = 1;
+    if (pthread_create(&replay_thread, NULL, replay_thread_main, NULL) != 0) {
+        perror("[REPLAY] Failed to create thread");
+        replay_running = 0;
+        return -1;
+    }
+    thread_started = 1;
+    return 0;
+}
+
+void replay_stop(void) {
+    replay_running = 0;
+    if (thread_started) {
+        pthread_join(replay_thread, NULL);
+        thread_started = 0;
+    }
+}
+
+int replay_is_active(void) {
+    return replay_running;
+}
+
+int replay_configure(const char *const *paths, int count, float speed) {
+    if (set_files(paths, count, speed) < 0) {
+        return -1;
+    }
+    boot_pending = 1;
+    return 0;
+}
+
+// ---------------------------
+// Registry hooks
+// ---------------------------
+static int replay_module_start(int use_sched) {
+    (void)use_sched;
+    if (!boot_pending) {
+        return 0;
+    }
+
+    const char *paths[REPLAY_MAX_FILES];
+    for (int i = 0; i < file_count; i++) {
+        paths[i] = files[i];
+    }
+    boot_pending = 0;
+    return replay_start(paths, file_count, replay_speed);
+}
+
+// Split "a.vtl,b.vtl" in place; returns the number of paths or -1
+static int split_paths(char *list, const char **paths) {
+    char *save = NULL;
+    int count = 0;
+    for (char *path = strtok_r(list, ",", &save); path; path = strtok_r(NULL, ",", &save)) {
+        if (count == REPLAY_MAX_FILES) return -1;
+        paths[count++] = path;
+    }
+    return count;
+}
+
+// ---------------------------
+// Execute replay command
+// Commands:
+//   "status" (or empty)                   - Progress of the current replay
+//   "start <file>[,<file>...] [<x>|max]"  - Play at x times real time
+//   "stop"                                - Back to the live sensors
+// ---------------------------
+int execute_replay_command(char *cmd_str, char *response, size_t response_size) {
+    static const char *const commands[] = { "status", "start", "stop" };
+    enum { CMD_STATUS, CMD_START, CMD_STOP };
+    cmd_parser_t p;
+    cmd_view_t tok;
+
+    if (cmd_str == NULL || response == NULL) {
+        return -1;
+    }
+
+    cmd_init(&p, cmd_str);
+    int cmd = cmd_done(&p) ? CMD_STATUS : cmd_keyword(&p, "REPLAY command", commands, 3);
+    if (cmd < 0) {
+        return cmd_error(&p, response, response_size);
+    }
+
+    if (cmd == CMD_START) {
+        char list[REPLAY_MAX_FILES * 64];
+        if (!hal_is_emulated()) {
+            snprintf(response, response_size, "ERROR: Replay requires --emulate\n");
+            return -1;
+        }
+        const char *paths[REPLAY_MAX_FILES];
+        float speed = 1.0f;
+
+        if (!cmd_next(&p, &tok)) {
+            cmd_fail(&p, "Missing file");
+            return cmd_error(&p, response, response_size);
+        }
+        if (tok.len >= sizeof(list)) {
+            cmd_fail(&p, "File list too long");
+            return cmd_error(&p, response, response_size);
+        }
+        memcpy(list, tok.ptr, tok.len);
+        list[tok.len] = '\0';
+
+        if (cmd_match(&p, "max")) {
+            speed = 0.0f;
+        } else if (!cmd_done(&p) && cmd_float(&p, "speed", 0.01f, 10000.0f, &speed) < 0) {
+            return cmd_error(&p, response, response_size);
+        }
+        if (cmd_end(&p) < 0) {
+            return cmd_error(&p, response, response_size);
+        }
+
+        int count = split_paths(list, paths);
+        if (count <= 0 || replay_start(paths, count, speed) < 0) {
+            snprintf(response, response_size, "ERROR: Cannot replay %s\n", tok.len ? list : "");
+            return -1;
+        }
+        snprintf(response, response_size, "OK\n");
+        return 0;
+    }
+
+    if (cmd_end(&p) < 0) {
+        return cmd_error(&p, response, response_size);
+    }
+
+    if (cmd == CMD_STOP) {
+        replay_stop();
+        snprintf(response, response_size, "OK\n");
+        return 0;
+    }
+
+    pthread_mutex_lock(&replay_mutex);
+    // Wall time spent, e.g. to time processing at full speed
+    uint64_t end_ns = progress.end_ns ? progress.end_ns : get_time_nanoseconds();
+    double elapsed_s = progress.first_us ? (end_ns - start_ns) / 1e9 : 0.0;
+    snprintf(response, response_size,
+             "{\"active\":%s,\"file\":\"%s\",\"speed\":%.2f,\"position_s\":%.3f,\"elapsed_s\":%.3f,"
+             "\"records\":{\"imu\":%lu,\"sonar\":%lu,\"pwm\":%lu},\"max_lag_ms\":%.2f,"
+             "\"finished\":%s,\"failed\":%s}\n",
+             replay_running ? "true" : "false", file_count ? files[progress.file] : "",
+             replay_speed,
+             progress.first_us ? (progress.position_us - progress.first_us) / 1e6 : 0.0, elapsed_s,
+             progress.imu, progress.sonar, progress.pwm, progress.max_lag_us / 1000.0,
+             progress.finished ? "true" : "false", progress.failed ? "true" : "false");
+    pthread_mutex_unlock(&replay_mutex);
+    return 0;
+}
+
+// Samples reset the IMU's attitude filter, so wait for the IMU to be up
+const module_t replay_module = {
+    .name = "replay",
+    .prefix = "REPLAY",
+    .usage = "REPLAY [status] | start <file>[,<file>...] [<speed>|max] | stop",
+#ifndef MODULE_NO_IMU
+    .depends = "imu",
+#endif
+    .start = replay_module_start,
+    .stop = replay_stop,
+    .command = execute_replay_command,
+};
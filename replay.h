@@ -0,0 +1,28 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "module.h"
+
+// Configuration
+#define REPLAY_MAX_FILES    16
+#define REPLAY_POLL_MS      100     // Longest sleep before a stop is noticed
+
+// Play recorded telemetry (recorder.h) back through imu.c and sonar.c in
+// place of the devices, with the recorded timestamps. Files are played
+// back to back, e.g. the rotated files of one run in order. speed: 1 for
+// real time, N for N times faster, 0 for as fast as possible. Emulated
+// hardware only (hal_is_emulated()): -1 with errno EPERM otherwise.
+int replay_start(const char *const *paths, int count, float speed);
+void replay_stop(void);
+int replay_is_active(void);
+
+// Replay to start once the sensor modules are up (--replay)
+int replay_configure(const char *const *paths, int count, float speed);
+
+// Command execution
+int execute_replay_command(char *cmd_str, char *response, size_t response_size);
+
+// Registry descriptor (module.h)
+extern const module_t replay_module;
+
+#endif // REPLAY_H
@@ -0,0 +1,213 @@
+#define _GNU_SOURCE     // pthread_setaffinity_np
+#include "rt.h"
+#include "cmd_parse.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+typedef struct {
+    const char *name;
+    int priority;
+    int cpu;
+} rt_config_t;
+
+// What a thread ended up with
+typedef struct {
+    int started;
+    int tid;
+    int policy;
+    int priority;
+    int cpu;                // -1 if not pinned
+    char error[64];         // Settings that could not be applied
+} rt_status_t;
+
+static const rt_config_t configs[RT_NUM_ROLES] = {
+    [RT_ROLE_SONAR] = { "sonar", RT_PRIO_SONAR, RT_CPU_SONAR },
+    [RT_ROLE_IMU]   = { "imu",   RT_PRIO_IMU,   RT_CPU_IMU },
+    [RT_ROLE_SCHED] = { "sched", RT_PRIO_SCHED, RT_CPU_SCHED },
+};
+
+// Static variables
+static pthread_mutex_t rt_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int rt_enabled = 0;
+static int mlock_errno = -1;    // -1 = not tried
+static int mlock_future = 0;    // New mappings (thread stacks) locked too
+static rt_status_t status[RT_NUM_ROLES];
+
+// CAP_IPC_LOCK in the effective set (bit 14 of CapEff)
+static int has_ipc_lock(void) {
+    char line[128];
+    unsigned long long caps = 0;
+    FILE *f = fopen("/proc/self/status", "r");
+    if (f == NULL) {
+        return 0;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "CapEff: %llx", &caps) == 1) break;
+    }
+    fclose(f);
+    return (caps >> 14) & 1;
+}
+
+// ---------------------------
+// Process-wide part: lock memory so no page fault stalls a sampler.
+// MCL_ONFAULT keeps untouched stack and heap reservations from being
+// committed; the sampler stacks are prefaulted instead. Without
+// CAP_IPC_LOCK, MCL_FUTURE would make every later thread stack count
+// against RLIMIT_MEMLOCK and pthread_create() fail, so only the current
+// pages are locked then.
+// ---------------------------
+int rt_enable(void) {
+    int flags = MCL_CURRENT;
+    int future = has_ipc_lock();
+    if (future) {
+        flags |= MCL_FUTURE;
+#ifdef MCL_ONFAULT
+        flags |= MCL_ONFAULT;
+#endif
+    }
+
+    pthread_mutex_lock(&rt_mutex);
+    rt_enabled = 1;
+    mlock_errno = mlockall(flags) == 0 ? 0 : errno;
+    mlock_future = future && mlock_errno == 0;
+    pthread_mutex_unlock(&rt_mutex);
+
+    if (mlock_errno) {
+        fprintf(stderr, "[RT] Warning: mlockall failed (%s), memory not locked\n",
+                strerror(mlock_errno));
+        return -1;
+    }
+    if (!future) {
+        fprintf(stderr, "[RT] Warning: No CAP_IPC_LOCK, only current memory locked\n");
+        return -1;
+    }
+    printf("[RT] Memory locked\n");
+    return 0;
+}
+
+// Touch the next 'size' bytes of stack so they are resident (and locked)
+static void prefault_stack(size_t size) {
+    volatile char buffer[RT_STACK_PREFAULT];
+    for (size_t i = 0; i < size; i += 4096) {
+        buffer[i] = 0;
+    }
+    (void)buffer;
+}
+
+// ---------------------------
+// Per-thread part (runs on the thread itself)
+// ---------------------------
+void rt_thread_setup(rt_role_t role) {
+    const rt_config_t *cfg = &configs[role];
+    rt_status_t st;
+    int err;
+
+    memset(&st, 0, sizeof(st));
+    st.started = 1;
+    st.tid = (int)syscall(SYS_gettid);
+    st.cpu = -1;
+
+    pthread_mutex_lock(&rt_mutex);
+    int enabled = rt_enabled;
+    pthread_mutex_unlock(&rt_mutex);
+
+    if (enabled && cfg->cpu >= 0) {
+        if (cfg->cpu >= sysconf(_SC_NPROCESSORS_ONLN)) {
+            snprintf(st.error, sizeof(st.error), "no CPU %d", cfg->cpu);
+        } else {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cfg->cpu, &set);
+            if ((err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) == 0) {
+                st.cpu = cfg->cpu;
+            } else {
+                snprintf(st.error, sizeof(st.error), "affinity: %s", strerror(err));
+            }
+        }
+    }
+
+    if (enabled && cfg->priority > 0) {
+        struct sched_param param = { .sched_priority = cfg->priority };
+        if ((err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param)) != 0) {
+            size_t len = strlen(st.error);
+            snprintf(st.error + len, sizeof(st.error) - len, "%sSCHED_FIFO: %s",
+                     len ? ", " : "", strerror(err));
+        }
+    }
+
+    if (enabled) {
+        prefault_stack(RT_STACK_PREFAULT);
+    }
+
+    // Report what the kernel actually has
+    struct sched_param param;
+    if (pthread_getschedparam(pthread_self(), &st.policy, &param) == 0) {
+        st.priority = param.sched_priority;
+    }
+
+    if (enabled) {
+        char cpu[12] = "any";
+        if (st.cpu >= 0) snprintf(cpu, sizeof(cpu), "%d", st.cpu);
+        printf("[RT] %s: %s %d, CPU %s%s%s\n", cfg->name,
+               st.policy == SCHED_FIFO ? "SCHED_FIFO" : "SCHED_OTHER", st.priority, cpu,
+               st.error[0] ? " - not applied: " : "", st.error);
+    }
+
+    pthread_mutex_lock(&rt_mutex);
+    status[role] = st;
+    pthread_mutex_unlock(&rt_mutex);
+}
+
+// ---------------------------
+// Execute RT command
+// Commands:
+//   "" - Profile state and the settings each sampler thread got
+// ---------------------------
+int execute_rt_command(char *cmd_str, char *response, size_t response_size) {
+    cmd_parser_t p;
+
+    if (cmd_str == NULL || response == NULL) {
+        return -1;
+    }
+    cmd_init(&p, cmd_str);
+    if (cmd_end(&p) < 0) {
+        return cmd_error(&p, response, response_size);
+    }
+
+    pthread_mutex_lock(&rt_mutex);
+    size_t pos = snprintf(response, response_size, "{\"enabled\":%s,\"mlockall\":\"%s\",\"threads\":[",
+                          rt_enabled ? "true" : "false",
+                          mlock_errno < 0 ? "off" : mlock_errno ? strerror(mlock_errno) :
+                          mlock_future ? "ok" : "current only");
+    const char *sep = "";
+    for (int r = 0; r < RT_NUM_ROLES && pos < response_size; r++) {
+        const rt_status_t *st = &status[r];
+        if (!st->started) continue;
+        pos += snprintf(response + pos, response_size - pos,
+                        "%s{\"role\":\"%s\",\"tid\":%d,\"policy\":\"%s\",\"priority\":%d,"
+                        "\"cpu\":%d,\"error\":\"%s\"}",
+                        sep, configs[r].name, st->tid,
+                        st->policy == SCHED_FIFO ? "SCHED_FIFO" : "SCHED_OTHER",
+                        st->priority, st->cpu, st->error);
+        sep = ",";
+    }
+    pthread_mutex_unlock(&rt_mutex);
+    if (pos < response_size) {
+        snprintf(response + pos, response_size - pos, "]}\n");
+    }
+    return 0;
+}
+
+const module_t rt_module = {
+    .name = "rt",
+    .prefix = "RT",
+    .usage = "RT (real-time settings of the sampler threads, see --rt)",
+    .command = execute_rt_command,
+};
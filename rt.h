@@ -0,0 +1,41 @@
+#ifndef RT_H
+#define RT_H
+
+#include "module.h"
+
+// Configuration: priorities (SCHED_FIFO 1..99, 0 = leave SCHED_OTHER) and
+// CPUs (-1 = any) per thread role. The Pi Zero 2W has 4 cores; booting
+// with isolcpus=3 leaves core 3 to the sonar's echo timing.
+#define RT_PRIO_SONAR       80
+#define RT_PRIO_IMU         70
+#define RT_PRIO_SCHED       70      // Runs the IMU and sonar tasks with --sched
+#define RT_CPU_SONAR        3
+#define RT_CPU_IMU          2
+#define RT_CPU_SCHED        2
+#define RT_STACK_PREFAULT   (64 * 1024)   // Stack touched at thread start
+
+typedef enum {
+    RT_ROLE_SONAR,
+    RT_ROLE_IMU,
+    RT_ROLE_SCHED,
+    RT_NUM_ROLES
+} rt_role_t;
+
+// Turn the real-time profile on (--rt), before the sampler threads start:
+// locks current and future memory. Failures (no CAP_SYS_NICE or
+// CAP_IPC_LOCK, too few CPUs) are reported and the process carries on
+// with whatever could be applied.
+int rt_enable(void);
+
+// Called first thing by each sampler thread: applies the role's policy,
+// priority and CPU when the profile is on, prefaults its stack and
+// records what was actually applied for "RT"
+void rt_thread_setup(rt_role_t role);
+
+// Command execution
+int execute_rt_command(char *cmd_str, char *response, size_t response_size);
+
+// Registry descriptor (module.h), command-only
+extern const module_t rt_module;
+
+#endif // RT_H
@@ -0,0 +1,483 @@
+#include "scheduler.h"
+#include "cmd_parse.h"
+#include "rt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/prctl.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+
+typedef struct {
+    int active;
+    int fd;                 // timerfd
+    unsigned int generation;
+    char name[SCHED_NAME_LEN];
+    uint32_t period_us;     // 0 = one-shot
+    int priority;
+    sched_task_fn fn;
+    void *arg;
+    uint64_t release_us;    // Expected time of the next expiration
+
+    unsigned long runs;
+    unsigned long deadline_misses;
+    unsigned long overruns;
+    double latency_sum_us;
+    float latency_max_us;
+    double runtime_sum_us;
+    float runtime_max_us;
+} task_t;
+
+typedef struct {
+    int index;
+    unsigned int generation;
+    int priority;
+    uint64_t expirations;
+} ready_t;
+
+// Static variables
+static task_t tasks[SCHED_MAX_TASKS];
+static pthread_mutex_t sched_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t sched_thread;
+static volatile int thread_running = 0;
+static pthread_cond_t task_done = PTHREAD_COND_INITIALIZER;
+static int current_task = -1;       // Task being run by the scheduler thread
+static int epoll_fd = -1;
+static int wake_fd = -1;
+static uint64_t epoch_us = 0;       // Periodic releases are aligned to this
+
+#define WAKE_TAG UINT64_MAX
+
+// Task ids carry the slot's generation so a stale id (task finished or
+// cancelled, slot reused) matches nothing
+#define ID_SLOT_BITS  8           // SCHED_MAX_TASKS fits
+#define ID_GEN_MASK   0x3FFFFFu   // Ids stay well below INT_MAX
+
+static int make_id(int slot, unsigned int generation) {
+    return (int)((generation & ID_GEN_MASK) << ID_SLOT_BITS) | slot;
+}
+
+// Slot of a live task, or -1; call with sched_mutex held
+static int find_task(int id) {
+    if (id < 0) {
+        return -1;
+    }
+    int slot = id & ((1 << ID_SLOT_BITS) - 1);
+    if (slot >= SCHED_MAX_TASKS || !tasks[slot].active ||
+        make_id(slot, tasks[slot].generation) != id) {
+        return -1;
+    }
+    return slot;
+}
+
+static uint64_t get_time_microseconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void us_to_timespec(uint64_t us, struct timespec *ts) {
+    ts->tv_sec = us / 1000000ULL;
+    ts->tv_nsec = (us % 1000000ULL) * 1000;
+}
+
+// ---------------------------
+// Arm a task's timer. One-shot tasks fire once after 'delay_us'. Periodic
+// tasks fire on multiples of their period from a common epoch, at most one
+// period from now, so tasks with harmonic rates expire together and share
+// one wakeup.
+// ---------------------------
+static int arm_timer(task_t *t, uint64_t delay_us) {
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+
+    uint64_t now = get_time_microseconds();
+    if (t->period_us) {
+        t->release_us = epoch_us + ((now - epoch_us) / t->period_us + 1) * t->period_us;
+    } else {
+        t->release_us = now + delay_us;
+    }
+    us_to_timespec(t->release_us, &its.it_value);
+    us_to_timespec(t->period_us, &its.it_interval);
+
+    return timerfd_settime(t->fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+static void release_task(task_t *t) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, t->fd, NULL);
+    close(t->fd);
+    t->fd = -1;
+    t->active = 0;
+    t->generation++;
+}
+
+// ---------------------------
+// Run one expired task outside the lock and account for its timing
+// ---------------------------
+static void run_task(const ready_t *r) {
+    pthread_mutex_lock(&sched_mutex);
+    task_t *t = &tasks[r->index];
+    if (!t->active || t->generation != r->generation) {
+        pthread_mutex_unlock(&sched_mutex);
+        return;  // Cancelled while waiting behind higher-priority tasks
+    }
+    sched_task_fn fn = t->fn;
+    void *arg = t->arg;
+    uint32_t period = t->period_us;
+
+    // With several expirations pending, only the latest one is run
+    uint64_t release = t->release_us + (r->expirations - 1) * period;
+    current_task = r->index;
+    pthread_mutex_unlock(&sched_mutex);
+
+    uint64_t start = get_time_microseconds();
+    fn(arg);
+    uint64_t end = get_time_microseconds();
+
+    pthread_mutex_lock(&sched_mutex);
+    current_task = -1;
+    pthread_cond_broadcast(&task_done);
+    if (t->active && t->generation == r->generation) {
+        float latency = start > release ? (float)(start - release) : 0.0f;
+        float runtime = (float)(end - start);
+
+        t->runs++;
+        t->overruns += r->expirations - 1;
+        if (r->expirations > 1 || (period && start >= release + period)) {
+            t->deadline_misses++;
+        }
+        t->latency_sum_us += latency;
+        if (latency > t->latency_max_us) t->latency_max_us = latency;
+        t->runtime_sum_us += runtime;
+        if (runtime > t->runtime_max_us) t->runtime_max_us = runtime;
+
+        if (period) {
+            if (t->period_us == period) {  // Not re-armed by sched_set_period meanwhile
+                t->release_us = release + period;
+            }
+        } else {
+            release_task(t);
+        }
+    }
+    pthread_mutex_unlock(&sched_mutex);
+}
+
+// ---------------------------
+// Scheduler thread: wait for timers, run ready tasks by priority
+// ---------------------------
+static void* sched_loop_thread(void* arg) {
+    (void)arg;
+    prctl(PR_SET_NAME, "sched");
+    rt_thread_setup(RT_ROLE_SCHED);
+    struct epoll_event events[SCHED_MAX_TASKS + 1];
+    ready_t ready[SCHED_MAX_TASKS];
+
+    while (thread_running) {
+        int n = epoll_wait(epoll_fd, events, SCHED_MAX_TASKS + 1, -1);
+        int count = 0;
+
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.u64 == WAKE_TAG) {
+                continue;
+            }
+
+            int index = (int)(events[i].data.u64 & 0xFFFFFFFF);
+            unsigned int generation = (unsigned int)(events[i].data.u64 >> 32);
+            uint64_t expirations = 0;
+
+            pthread_mutex_lock(&sched_mutex);
+            task_t *t = &tasks[index];
+            if (t->active && t->generation == generation &&
+                read(t->fd, &expirations, sizeof(expirations)) == sizeof(expirations) &&
+                expirations > 0) {
+                // Insertion sort by priority, highest first
+                int j = count++;
+                while (j > 0 && ready[j - 1].priority < t->priority) {
+                    ready[j] = ready[j - 1];
+                    j--;
+                }
+                ready[j].index = index;
+                ready[j].generation = generation;
+                ready[j].priority = t->priority;
+                ready[j].expirations = expirations;
+            }
+            pthread_mutex_unlock(&sched_mutex);
+        }
+
+        for (int i = 0; i < count && thread_running; i++) {
+            run_task(&ready[i]);
+        }
+    }
+
+    return NULL;
+}
+
+// ---------------------------
+// Register a task (periodic if period_us > 0)
+// ---------------------------
+static int add_task(const char *name, uint32_t period_us, uint32_t delay_us,
+                    int priority, sched_task_fn fn, void *arg) {
+    if (epoll_fd < 0 || fn == NULL) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&sched_mutex);
+
+    int id;
+    for (id = 0; id < SCHED_MAX_TASKS && tasks[id].active; id++);
+    if (id == SCHED_MAX_TASKS) {
+        pthread_mutex_unlock(&sched_mutex);
+        fprintf(stderr, "[SCHED] No free task slot for '%s'\n", name);
+        return -1;
+    }
+
+    task_t *t = &tasks[id];
+    unsigned int generation = t->generation;
+    memset(t, 0, sizeof(task_t));
+    t->generation = generation;
+    t->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (t->fd < 0) {
+        pthread_mutex_unlock(&sched_mutex);
+        perror("[SCHED] timerfd_create");
+        return -1;
+    }
+
+    snprintf(t->name, sizeof(t->name), "%s", name);
+    t->period_us = period_us;
+    t->priority = priority;
+    t->fn = fn;
+    t->arg = arg;
+    t->active = 1;
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = ((uint64_t)t->generation << 32) | (uint32_t)id;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, t->fd, &ev) < 0 ||
+        arm_timer(t, delay_us) < 0) {
+        perror("[SCHED] Failed to arm task");
+        release_task(t);
+        pthread_mutex_unlock(&sched_mutex);
+        return -1;
+    }
+
+    id = make_id(id, t->generation);
+    pthread_mutex_unlock(&sched_mutex);
+    return id;
+}
+
+int sched_add_periodic(const char *name, uint32_t period_us, int priority,
+                       sched_task_fn fn, void *arg) {
+    if (period_us == 0) {
+        return -1;
+    }
+    return add_task(name, period_us, 0, priority, fn, arg);
+}
+
+int sched_add_oneshot(const char *name, uint32_t delay_us, int priority,
+                      sched_task_fn fn, void *arg) {
+    // A zero it_value would disarm the timer
+    return add_task(name, 0, delay_us ? delay_us : 1, priority, fn, arg);
+}
+
+// ---------------------------
+// Change a periodic task's period; releases realign to the new period
+// ---------------------------
+int sched_set_period(int id, uint32_t period_us) {
+    int ret = -1;
+
+    if (period_us == 0) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&sched_mutex);
+    int slot = find_task(id);
+    if (slot >= 0 && tasks[slot].period_us) {
+        tasks[slot].period_us = period_us;
+        ret = arm_timer(&tasks[slot], 0);
+    }
+    pthread_mutex_unlock(&sched_mutex);
+    return ret;
+}
+
+// ---------------------------
+// Cancel a task; if it is running, wait for it to return first so the
+// caller can safely release what the task uses. Ids of tasks that already
+// ended (one-shots after their run) are ignored.
+// ---------------------------
+void sched_cancel(int id) {
+    pthread_mutex_lock(&sched_mutex);
+    int slot = find_task(id);
+    if (slot >= 0 && (!thread_running || !pthread_equal(pthread_self(), sched_thread))) {
+        while (current_task == slot) {
+            pthread_cond_wait(&task_done, &sched_mutex);
+        }
+        slot = find_task(id);  // A one-shot is released after its run
+    }
+    if (slot >= 0) {
+        release_task(&tasks[slot]);
+    }
+    pthread_mutex_unlock(&sched_mutex);
+}
+
+// ---------------------------
+// Initialize epoll set (tasks can be added before sched_start)
+// ---------------------------
+int sched_init(void) {
+    if (epoll_fd >= 0) {
+        return 0;
+    }
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd < 0 || wake_fd < 0) {
+        perror("[SCHED] Failed to create epoll/eventfd");
+        if (epoll_fd >= 0) close(epoll_fd);
+        if (wake_fd >= 0) close(wake_fd);
+        epoll_fd = wake_fd = -1;
+        return -1;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = WAKE_TAG;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev);
+
+    for (int i = 0; i < SCHED_MAX_TASKS; i++) {
+        tasks[i].fd = -1;
+    }
+    epoch_us = get_time_microseconds();
+    return 0;
+}
+
+// ---------------------------
+// Start the scheduler thread
+// ---------------------------
+int sched_start(void) {
+    if (thread_running) {
+        fprintf(stderr, "[SCHED] Thread already running\n");
+        return -1;
+    }
+    if (epoll_fd < 0 && sched_init() < 0) {
+        return -1;
+    }
+
+    thread_running = 1;
+    if (pthread_create(&sched_thread, NULL, sched_loop_thread, NULL) != 0) {
+        perror("[SCHED] Failed to create thread");
+        thread_running = 0;
+        return -1;
+    }
+    return 0;
+}
+
+// ---------------------------
+// Stop the thread and release every task
+// ---------------------------
+void sched_stop(void) {
+    if (thread_running) {
+        uint64_t one = 1;
+        thread_running = 0;
+        if (write(wake_fd, &one, sizeof(one)) != sizeof(one)) {
+            perror("[SCHED] Failed to wake scheduler");
+        }
+        pthread_join(sched_thread, NULL);
+    }
+
+    pthread_mutex_lock(&sched_mutex);
+    for (int i = 0; i < SCHED_MAX_TASKS; i++) {
+        if (tasks[i].active) {
+            release_task(&tasks[i]);
+        }
+    }
+    pthread_mutex_unlock(&sched_mutex);
+
+    if (epoll_fd >= 0) {
+        close(epoll_fd);
+        close(wake_fd);
+        epoll_fd = wake_fd = -1;
+    }
+}
+
+int sched_is_running(void) {
+    return thread_running;
+}
+
+// ---------------------------
+// Copy statistics of active tasks; returns the number copied
+// ---------------------------
+int sched_get_stats(sched_task_stats_t *stats, int max_tasks) {
+    int count = 0;
+
+    pthread_mutex_lock(&sched_mutex);
+    for (int i = 0; i < SCHED_MAX_TASKS && count < max_tasks; i++) {
+        const task_t *t = &tasks[i];
+        if (!t->active) continue;
+
+        sched_task_stats_t *s = &stats[count++];
+        memcpy(s->name, t->name, SCHED_NAME_LEN);
+        s->period_us = t->period_us;
+        s->priority = t->priority;
+        s->runs = t->runs;
+        s->deadline_misses = t->deadline_misses;
+        s->overruns = t->overruns;
+        s->latency_avg_us = t->runs ? (float)(t->latency_sum_us / t->runs) : 0.0f;
+        s->latency_max_us = t->latency_max_us;
+        s->runtime_avg_us = t->runs ? (float)(t->runtime_sum_us / t->runs) : 0.0f;
+        s->runtime_max_us = t->runtime_max_us;
+    }
+    pthread_mutex_unlock(&sched_mutex);
+
+    return count;
+}
+
+// ---------------------------
+// Execute scheduler command
+// Commands:
+//   "stats" (or empty) - Per-task runs, deadline misses, latency and runtime
+// ---------------------------
+int execute_sched_command(char *cmd_str, char *response, size_t response_size) {
+    sched_task_stats_t stats[SCHED_MAX_TASKS];
+    cmd_parser_t p;
+
+    if (cmd_str == NULL || response == NULL) {
+        return -1;
+    }
+
+    cmd_init(&p, cmd_str);
+    cmd_match(&p, "stats");
+    if (cmd_end(&p) < 0) {
+        return cmd_error(&p, response, response_size);
+    }
+
+    int count = sched_get_stats(stats, SCHED_MAX_TASKS);
+    size_t pos = snprintf(response, response_size, "{\"running\":%s,\"tasks\":[",
+                          thread_running ? "true" : "false");
+
+    for (int i = 0; i < count && pos < response_size; i++) {
+        const sched_task_stats_t *s = &stats[i];
+        pos += snprintf(response + pos, response_size - pos,
+            "%s{\"name\":\"%s\",\"period_us\":%u,\"priority\":%d,\"runs\":%lu,"
+            "\"deadline_misses\":%lu,\"overruns\":%lu,"
+            "\"latency_us\":{\"avg\":%.1f,\"max\":%.1f},"
+            "\"runtime_us\":{\"avg\":%.1f,\"max\":%.1f}}",
+            i ? "," : "", s->name, s->period_us, s->priority, s->runs,
+            s->deadline_misses, s->overruns,
+            s->latency_avg_us, s->latency_max_us,
+            s->runtime_avg_us, s->runtime_max_us);
+    }
+    if (pos < response_size) {
+        snprintf(response + pos, response_size - pos, "]}\n");
+    }
+    return 0;
+}
+
+const module_t sched_module = {
+    .name = "sched",
+    .prefix = "SCHED",
+    .usage = "SCHED stats",
+    .command = execute_sched_command,
+};
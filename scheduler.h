@@ -0,0 +1,54 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "module.h"
+
+// Configuration
+#define SCHED_MAX_TASKS  16
+#define SCHED_NAME_LEN   16
+
+// Task priorities: when several timers expire together, higher runs first
+#define SCHED_PRIO_LOW     0
+#define SCHED_PRIO_NORMAL  10
+#define SCHED_PRIO_HIGH    20
+
+typedef void (*sched_task_fn)(void *arg);
+
+// Per-task statistics (microseconds)
+typedef struct {
+    char name[SCHED_NAME_LEN];
+    uint32_t period_us;     // 0 for one-shot tasks
+    int priority;
+    unsigned long runs;
+    unsigned long deadline_misses;  // Started after the next release time
+    unsigned long overruns;         // Timer expirations that were never run
+    float latency_avg_us, latency_max_us;   // Release to start
+    float runtime_avg_us, runtime_max_us;
+} sched_task_stats_t;
+
+// Single-thread timerfd/epoll scheduler
+int sched_init(void);
+int sched_start(void);
+void sched_stop(void);
+int sched_is_running(void);
+
+// Returns a task id >= 0, or -1 on error. Once a task is cancelled or a
+// one-shot has run, its id refers to nothing, even after the slot is reused.
+int sched_add_periodic(const char *name, uint32_t period_us, int priority,
+                       sched_task_fn fn, void *arg);
+int sched_add_oneshot(const char *name, uint32_t delay_us, int priority,
+                      sched_task_fn fn, void *arg);
+int sched_set_period(int id, uint32_t period_us);
+void sched_cancel(int id);
+
+int sched_get_stats(sched_task_stats_t *stats, int max_tasks);
+
+// Command execution
+int execute_sched_command(char *cmd_str, char *response, size_t response_size);
+
+// Registry descriptor (module.h), command-only
+extern const module_t sched_module;
+
+#endif // SCHEDULER_H
@@ -0,0 +1,149 @@
+#include "snapshot.h"
+#include "cmd_parse.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+
+// Static variables
+static snapshot_t state;
+static unsigned seq = 0;        // Odd while a write is in progress
+static pthread_mutex_t writer_mutex = PTHREAD_MUTEX_INITIALIZER;   // Writers only
+
+static uint64_t get_time_microseconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+// ---------------------------
+// Sequence lock: writers serialize among themselves and make seq odd
+// around their update; readers never block them
+// ---------------------------
+static void write_begin(void) {
+    pthread_mutex_lock(&writer_mutex);
+    __atomic_store_n(&seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void write_end(void) {
+    __atomic_store_n(&seq, seq + 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&writer_mutex);
+}
+
+void snapshot_publish_imu(const imu_data_t *sample) {
+    write_begin();
+    state.imu = *sample;
+    write_end();
+}
+
+void snapshot_publish_sonar(float distance_cm, int valid, uint64_t time_us) {
+    if (time_us == 0) {
+        time_us = get_time_microseconds();
+    }
+    write_begin();
+    state.distance_cm = distance_cm;
+    state.sonar_valid = valid;
+    state.sonar_us = time_us;
+    write_end();
+}
+
+void snapshot_publish_pwm(int channel, float duty) {
+    if (channel < 0 || channel >= PWM_NUM_CHANNELS) {
+        return;
+    }
+    uint64_t now = get_time_microseconds();
+    write_begin();
+    state.duty[channel] = duty;
+    state.pwm_us[channel] = now;
+    write_end();
+}
+
+void snapshot_get(snapshot_t *out) {
+    unsigned begin;
+
+    do {
+        while ((begin = __atomic_load_n(&seq, __ATOMIC_ACQUIRE)) & 1) {
+            sched_yield();  // A writer is mid-update (it may share our CPU)
+        }
+        memcpy(out, &state, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (__atomic_load_n(&seq, __ATOMIC_RELAXED) != begin);
+
+    out->time_us = get_time_microseconds();
+}
+
+// ---------------------------
+// Execute snapshot command
+// Commands:
+//   "" - IMU, sonar and PWM state with their own timestamps (t_us,
+//        CLOCK_MONOTONIC); parts never published are null or left out
+// ---------------------------
+int execute_snapshot_command(char *cmd_str, char *response, size_t response_size) {
+    cmd_parser_t p;
+    snapshot_t s;
+
+    if (cmd_str == NULL || response == NULL) {
+        return -1;
+    }
+    cmd_init(&p, cmd_str);
+    if (cmd_end(&p) < 0) {
+        return cmd_error(&p, response, response_size);
+    }
+
+    snapshot_get(&s);
+
+    size_t pos = snprintf(response, response_size, "{\"t_us\":%llu,\"imu\":",
+                          (unsigned long long)s.time_us);
+    if (s.imu.timestamp_us && pos < response_size) {
+        pos += snprintf(response + pos, response_size - pos,
+            "{\"t_us\":%llu,\"accel\":[%.3f,%.3f,%.3f],\"gyro\":[%.3f,%.3f,%.3f],"
+            "\"mag\":[%.3f,%.3f,%.3f],\"temp\":%.1f,\"roll\":%.1f,\"pitch\":%.1f,\"yaw\":%.1f}",
+            (unsigned long long)s.imu.timestamp_us,
+            s.imu.accel_x, s.imu.accel_y, s.imu.accel_z,
+            s.imu.gyro_x, s.imu.gyro_y, s.imu.gyro_z,
+            s.imu.mag_x, s.imu.mag_y, s.imu.mag_z,
+            s.imu.temp, s.imu.roll, s.imu.pitch, s.imu.yaw);
+    } else if (pos < response_size) {
+        pos += snprintf(response + pos, response_size - pos, "null");
+    }
+
+    if (pos < response_size) {
+        pos += snprintf(response + pos, response_size - pos, ",\"sonar\":");
+    }
+    if (s.sonar_us && s.sonar_valid && pos < response_size) {
+        pos += snprintf(response + pos, response_size - pos,
+                        "{\"t_us\":%llu,\"distance\":%.2f,\"valid\":true}",
+                        (unsigned long long)s.sonar_us, s.distance_cm);
+    } else if (s.sonar_us && pos < response_size) {
+        pos += snprintf(response + pos, response_size - pos,
+                        "{\"t_us\":%llu,\"distance\":null,\"valid\":false}",
+                        (unsigned long long)s.sonar_us);
+    } else if (pos < response_size) {
+        pos += snprintf(response + pos, response_size - pos, "null");
+    }
+
+    if (pos < response_size) {
+        pos += snprintf(response + pos, response_size - pos, ",\"pwm\":[");
+    }
+    const char *sep = "";
+    for (int ch = 0; ch < PWM_NUM_CHANNELS && pos < response_size; ch++) {
+        if (s.pwm_us[ch] == 0) continue;
+        pos += snprintf(response + pos, response_size - pos,
+                        "%s{\"channel\":%d,\"duty\":%.2f,\"t_us\":%llu}",
+                        sep, ch, s.duty[ch], (unsigned long long)s.pwm_us[ch]);
+        sep = ",";
+    }
+    if (pos < response_size) {
+        snprintf(response + pos, response_size - pos, "]}\n");
+    }
+    return 0;
+}
+
+const module_t snapshot_module = {
+    .name = "snapshot",
+    .prefix = "SNAPSHOT",
+    .usage = "SNAPSHOT (IMU, sonar and PWM state in one response)",
+    .command = execute_snapshot_command,
+};
@@ -0,0 +1,40 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "module.h"
+#include "imu.h"
+#include "pwm.h"
+
+// Latest IMU sample, sonar measurement and PWM duty cycles, kept together
+// under one sequence lock. Publishers (the sensor threads, set_pwm())
+// write their part; readers copy the whole state without taking any
+// module lock and retry if a write overlapped, so every snapshot is one
+// consistent point in time.
+typedef struct {
+    uint64_t time_us;               // When the snapshot was taken
+    imu_data_t imu;                 // imu.timestamp_us 0: no sample yet
+    float distance_cm;
+    int sonar_valid;
+    uint64_t sonar_us;              // 0: no measurement yet
+    float duty[PWM_NUM_CHANNELS];   // Percent
+    uint64_t pwm_us[PWM_NUM_CHANNELS];  // Last change, 0: never set
+} snapshot_t;
+
+// Publishers (CLOCK_MONOTONIC microseconds; PWM is stamped now, sonar
+// too unless a replay passes the recorded time)
+void snapshot_publish_imu(const imu_data_t *sample);
+void snapshot_publish_sonar(float distance_cm, int valid, uint64_t time_us);
+void snapshot_publish_pwm(int channel, float duty);
+
+// Lock-free for readers
+void snapshot_get(snapshot_t *out);
+
+// Command execution
+int execute_snapshot_command(char *cmd_str, char *response, size_t response_size);
+
+// Registry descriptor (module.h), command-only
+extern const module_t snapshot_module;
+
+#endif // SNAPSHOT_H
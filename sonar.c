@@ -1,59 +1,49 @@
 #include "sonar.h"
+#include "cmd_parse.h"
+#include "trace.h"
+#include "hal.h"
+#include "recorder.h"
+#include "rt.h"
+#include "snapshot.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
-#include <fcntl.h>
-#include <sys/mman.h>
 #include <sys/time.h>
 #include <pthread.h>
-
-// Raspberry Pi memory addresses
-#define BCM2835_PERI_BASE      0x3F000000  // Pi Zero 2W uses Pi 2/3 base
-#define GPIO_BASE_OFFSET       0x200000
-#define BLOCK_SIZE             (4*1024)
-
-// GPIO registers
-#define GPFSEL0    0
-#define GPFSEL1    1
-#define GPFSEL2    2
-#define GPSET0     7
-#define GPCLR0     10
-#define GPLEV0     13
+#include <sys/prctl.h>
 
 // Static variables
-static volatile unsigned int *gpio_map = NULL;
+static volatile int gpio_ready = 0;
 static pthread_mutex_t sonar_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_t sonar_thread;
 static volatile int thread_running = 0;
 static sonar_data_t current_data = {0};
+static long long stable_after_us = 0;
+static volatile int replaying = 0;    // Measurements come from replay.c
+static sonar_counters_t counters = {0};   // Protected by sonar_mutex
 
 // ---------------------------
-// GPIO Direct Access Functions
+// GPIO access (hal.h: /dev/mem registers or the emulated bank)
 // ---------------------------
 static void gpio_set_input(int pin) {
-    int reg = pin / 10;
-    int shift = (pin % 10) * 3;
-    *(gpio_map + reg) &= ~(7 << shift);
+    hal_gpio_set_output(pin, 0);
 }
 
 static void gpio_set_output(int pin) {
-    int reg = pin / 10;
-    int shift = (pin % 10) * 3;
-    *(gpio_map + reg) &= ~(7 << shift);
-    *(gpio_map + reg) |= (1 << shift);
+    hal_gpio_set_output(pin, 1);
 }
 
 static void gpio_write_high(int pin) {
-    *(gpio_map + GPSET0) = (1 << pin);
+    hal_gpio_write(pin, 1);
 }
 
 static void gpio_write_low(int pin) {
-    *(gpio_map + GPCLR0) = (1 << pin);
+    hal_gpio_write(pin, 0);
 }
 
 static int gpio_read(int pin) {
-    return (*(gpio_map + GPLEV0) & (1 << pin)) ? 1 : 0;
+    return hal_gpio_read(pin);
 }
 
 static long long get_time_microseconds() {
@@ -146,31 +136,76 @@ static void update_status(sonar_data_t *data) {
     }
 }
 
+// ---------------------------
+// Publish one measurement (cm, <= 0 if none): status, LEDs, recorder.
+// time_us 0 stamps it now; replayed ones keep their recorded time.
+// ---------------------------
+static void publish_measurement(float distance, uint64_t time_us) {
+    pthread_mutex_lock(&sonar_mutex);
+    
+    if (distance > 0 && distance < SONAR_MAX_DISTANCE) {
+        current_data.distance_cm = distance;
+        current_data.valid = 1;
+    } else {
+        current_data.valid = 0;
+        counters.invalid++;
+    }
+    counters.measurements++;
+    
+    update_status(&current_data);
+    if (gpio_ready) {
+        control_leds(&current_data);  // Update LEDs based on distance
+    }
+    
+    recorder_sonar_t rec = { .distance_cm = distance, .valid = (uint8_t)current_data.valid };
+    
+    pthread_mutex_unlock(&sonar_mutex);
+    
+    snapshot_publish_sonar(distance, rec.valid, time_us);
+    recorder_log(&rec.rec, REC_SONAR, sizeof(rec), time_us);
+}
+
+// ---------------------------
+// Take one measurement and update status and LEDs
+// ---------------------------
+static void sonar_poll_once(void) {
+    if (!sonar_is_stable() || replaying) {
+        return;
+    }
+    
+    uint64_t t0 = trace_begin();
+    float distance = measure_distance();
+    trace_end("measure_distance", t0);
+    publish_measurement(distance, 0);
+}
+
+// ---------------------------
+// Replay source (replay.c): recorded measurements replace the sensor's
+// ---------------------------
+void sonar_replay_begin(void) {
+    replaying = 1;
+}
+
+void sonar_replay_measurement(float distance_cm, int valid, uint64_t time_us) {
+    publish_measurement(valid ? distance_cm : -1.0f, time_us);
+}
+
+void sonar_replay_end(void) {
+    replaying = 0;
+}
+
 // ---------------------------
 // Thread to continuously read sonar
 // ---------------------------
 static void* sonar_read_thread(void* arg) {
     (void)arg;
     
+    prctl(PR_SET_NAME, "sonar");
+    rt_thread_setup(RT_ROLE_SONAR);
     printf("[SONAR] Read thread started\n");
     
     while (thread_running) {
-        float distance = measure_distance();
-        
-        pthread_mutex_lock(&sonar_mutex);
-        
-        if (distance > 0 && distance < SONAR_MAX_DISTANCE) {
-            current_data.distance_cm = distance;
-            current_data.valid = 1;
-        } else {
-            current_data.valid = 0;
-        }
-        
-        update_status(&current_data);
-        control_leds(&current_data);  // Update LEDs based on distance
-        
-        pthread_mutex_unlock(&sonar_mutex);
-        
+        sonar_poll_once();
         usleep(1000000 / SONAR_UPDATE_RATE_HZ);
     }
     
@@ -182,36 +217,13 @@ static void* sonar_read_thread(void* arg) {
 // Initialize sonar sensor
 // ---------------------------
 int init_sonar_controller(void) {
-    int mem_fd;
-    void *gpio_mem;
-    
     printf("[SONAR] Initializing HC-SR05...\n");
     
-    // Open /dev/mem
-    mem_fd = open("/dev/mem", O_RDWR | O_SYNC);
-    if (mem_fd < 0) {
-        fprintf(stderr, "[SONAR] Error: Cannot open /dev/mem (need root)\n");
+    if (hal_gpio_open() < 0) {
+        fprintf(stderr, "[SONAR] Error: Cannot access GPIO\n");
         return -1;
     }
-    
-    // Map GPIO registers
-    gpio_mem = mmap(
-        NULL,
-        BLOCK_SIZE,
-        PROT_READ | PROT_WRITE,
-        MAP_SHARED,
-        mem_fd,
-        BCM2835_PERI_BASE + GPIO_BASE_OFFSET
-    );
-    
-    close(mem_fd);
-    
-    if (gpio_mem == MAP_FAILED) {
-        fprintf(stderr, "[SONAR] Error: mmap failed\n");
-        return -1;
-    }
-    
-    gpio_map = (volatile unsigned int *)gpio_mem;
+    gpio_ready = 1;
     
     // Configure GPIO pins
     gpio_set_output(SONAR_TRIG_PIN);
@@ -228,9 +240,10 @@ int init_sonar_controller(void) {
     gpio_write_low(LED_YELLOW);
     gpio_write_low(LED_RED);
     
-    // Stabilization
+    // Stabilization runs in the background: measurements and commands
+    // are held off until the deadline instead of blocking here
     printf("[SONAR] Stabilizing sensor...\n");
-    sleep(1);
+    stable_after_us = get_time_microseconds() + SONAR_STABILIZE_US;
     
     printf("[SONAR] HC-SR05 initialized (TRIG=GPIO%d, ECHO=GPIO%d)\n", 
            SONAR_TRIG_PIN, SONAR_ECHO_PIN);
@@ -245,15 +258,15 @@ int init_sonar_controller(void) {
 void close_sonar_controller(void) {
     stop_sonar_thread();
     
-    if (gpio_map) {
+    if (gpio_ready) {
         gpio_write_low(SONAR_TRIG_PIN);
         // Turn off all LEDs
         gpio_write_low(LED_GREEN);
         gpio_write_low(LED_YELLOW);
         gpio_write_low(LED_RED);
         
-        munmap((void*)gpio_map, BLOCK_SIZE);
-        gpio_map = NULL;
+        gpio_ready = 0;
+        hal_gpio_close();
     }
     
     printf("[SONAR] Controller closed\n");
@@ -308,6 +321,19 @@ float get_distance(void) {
     return distance;
 }
 
+void sonar_get_counters(sonar_counters_t *out) {
+    pthread_mutex_lock(&sonar_mutex);
+    *out = counters;
+    pthread_mutex_unlock(&sonar_mutex);
+}
+
+// ---------------------------
+// True once the post-init stabilization delay has elapsed
+// ---------------------------
+int sonar_is_stable(void) {
+    return gpio_ready && get_time_microseconds() >= stable_after_us;
+}
+
 // ---------------------------
 // Execute sonar command and format response
 // Commands:
@@ -316,21 +342,29 @@ float get_distance(void) {
 //   "status" - Get status only
 // ---------------------------
 int execute_sonar_command(char *cmd_str, char *response, size_t response_size) {
+    static const char *const commands[] = { "read", "get", "distance", "status" };
+    enum { CMD_READ, CMD_GET, CMD_DISTANCE, CMD_STATUS };
+    cmd_parser_t p;
+
     if (cmd_str == NULL || response == NULL) {
         return -1;
     }
     
-    // Remove trailing whitespace
-    char *end = cmd_str + strlen(cmd_str) - 1;
-    while (end > cmd_str && (*end == ' ' || *end == '\t' || *end == '\n')) {
-        *end = '\0';
-        end--;
+    cmd_init(&p, cmd_str);
+    int cmd = cmd_done(&p) ? CMD_READ : cmd_keyword(&p, "SONAR command", commands, 4);
+    if (cmd < 0 || cmd_end(&p) < 0) {
+        return cmd_error(&p, response, response_size);
+    }
+    
+    if (!sonar_is_stable()) {
+        snprintf(response, response_size, "ERROR: SONAR initializing\n");
+        return -1;
     }
     
     sonar_data_t data;
     get_sonar_data(&data);
     
-    if (strcmp(cmd_str, "read") == 0 || strcmp(cmd_str, "get") == 0 || strcmp(cmd_str, "") == 0) {
+    if (cmd == CMD_READ || cmd == CMD_GET) {
         // Full response with status
         if (data.valid) {
             snprintf(response, response_size,
@@ -341,7 +375,7 @@ int execute_sonar_command(char *cmd_str, char *response, size_t response_size) {
                 "{\"distance\":null,\"status\":\"ERROR\",\"valid\":false}\n");
         }
     }
-    else if (strcmp(cmd_str, "distance") == 0) {
+    else if (cmd == CMD_DISTANCE) {
         // Distance only
         if (data.valid) {
             snprintf(response, response_size, "%.2f cm\n", data.distance_cm);
@@ -349,14 +383,31 @@ int execute_sonar_command(char *cmd_str, char *response, size_t response_size) {
             snprintf(response, response_size, "ERROR\n");
         }
     }
-    else if (strcmp(cmd_str, "status") == 0) {
+    else {
         // Status only
         snprintf(response, response_size, "%s\n", data.status);
     }
-    else {
-        snprintf(response, response_size, "ERROR: Unknown SONAR command '%s'\n", cmd_str);
-        return -1;
-    }
     
     return 0;
 }
+
+// ---------------------------
+// Registry hooks
+// ---------------------------
+// Own thread even with --sched: a measurement polls the echo pin until it
+// ends or times out (tens of ms), which would stall every task of the
+// scheduler thread, and at 58 us/cm it cannot be split into timer releases
+static int sonar_module_start(int use_sched) {
+    (void)use_sched;
+    return start_sonar_thread();
+}
+
+const module_t sonar_module = {
+    .name = "sonar",
+    .prefix = "SONAR",
+    .usage = "SONAR read | SONAR distance | SONAR status",
+    .init = init_sonar_controller,
+    .start = sonar_module_start,
+    .stop = close_sonar_controller,
+    .command = execute_sonar_command,
+};
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <pthread.h>
+#include "module.h"
 
 // Configuration
 #define SONAR_TRIG_PIN 27
@@ -10,6 +11,7 @@
 #define SONAR_UPDATE_RATE_HZ 10
 #define SONAR_MAX_DISTANCE 400.0f  // cm
 #define SONAR_MIN_DISTANCE 2.0f    // cm
+#define SONAR_STABILIZE_US 1000000  // Settling time after power-up
 
 // LED pins
 #define LED_GREEN  25  // GPIO25 - Far (>60cm)
@@ -36,9 +38,27 @@ void stop_sonar_thread(void);
 // Data access (thread-safe)
 void get_sonar_data(sonar_data_t *data);
 float get_distance(void);
+int sonar_is_stable(void);
+
+// Counters since start (metrics.c)
+typedef struct {
+    unsigned long measurements;     // Published, replayed ones included
+    unsigned long invalid;          // Timeouts and out-of-range echoes
+} sonar_counters_t;
+void sonar_get_counters(sonar_counters_t *counters);
+
+// Replay source (replay.c): while active, measurements come from
+// sonar_replay_measurement() instead of the sensor, stamped with their
+// recorded time (CLOCK_MONOTONIC microseconds)
+void sonar_replay_begin(void);
+void sonar_replay_measurement(float distance_cm, int valid, uint64_t time_us);
+void sonar_replay_end(void);
 
 // Command execution
 int execute_sonar_command(char *cmd_str, char *response, size_t response_size);
 
+// Registry descriptor (module.h)
+extern const module_t sonar_module;
+
 #endif // SONAR_H
 
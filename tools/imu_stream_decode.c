@@ -0,0 +1,89 @@
+#include "../imu_stream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+// Decoder for packed IMU history (imu_stream.h): reads an "IMU history ...
+// packed" response, its base64 data alone, or a binary stream, and prints
+// every sample as one CSV row in SI units (temperature stays raw).
+
+static int print_sample(const imu_stream_sample_t *s, void *ctx) {
+    const float *k = s->scale;
+    (void)ctx;
+    printf("%llu,%.3f,%.3f,%.3f,%.4f,%.4f,%.4f,%.2f,%.2f,%.2f,%d\n",
+           (unsigned long long)s->t_us,
+           s->raw[0] * k[0], s->raw[1] * k[0], s->raw[2] * k[0],
+           s->raw[3] * k[1], s->raw[4] * k[1], s->raw[5] * k[1],
+           s->raw[6] * k[2], s->raw[7] * k[2], s->raw[8] * k[2], s->raw[9]);
+    return 0;
+}
+
+static uint8_t *read_all(FILE *f, size_t *len) {
+    size_t size = 65536, n = 0;
+    uint8_t *buffer = malloc(size + 1);
+
+    while (buffer) {
+        n += fread(buffer + n, 1, size - n, f);
+        if (n < size) break;
+        uint8_t *bigger = realloc(buffer, size * 2 + 1);
+        if (bigger == NULL) {
+            free(buffer);
+            return NULL;
+        }
+        buffer = bigger;
+        size *= 2;
+    }
+    if (buffer) {
+        buffer[n] = '\0';
+        *len = n;
+    }
+    return buffer;
+}
+
+int main(int argc, char *argv[]) {
+    FILE *f = stdin;
+    size_t len = 0;
+
+    if (argc > 2 || (argc == 2 && argv[1][0] == '-' && argv[1][1] != '\0')) {
+        fprintf(stderr, "Usage: %s [<file>]\n"
+                        "Reads a packed IMU history response, its base64 data or a binary\n"
+                        "stream from the file or stdin.\n", argv[0]);
+        return 1;
+    }
+    if (argc == 2 && strcmp(argv[1], "-") != 0 && (f = fopen(argv[1], "rb")) == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    uint8_t *input = read_all(f, &len);
+    if (f != stdin) fclose(f);
+    if (input == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    uint8_t *stream = input;
+    imu_stream_header_t header;
+    if (imu_stream_read_header(input, len, &header) < 0) {
+        // Text: the "data" field of a response, or base64 alone
+        const char *text = strstr((const char *)input, "\"data\":\"");
+        text = text ? text + 8 : (const char *)input;
+        while (*text == ' ' || *text == '\n' || *text == '\r') text++;
+
+        stream = malloc(len / 4 * 3 + 3);
+        long n = stream ? imu_stream_base64_decode(text, stream, len / 4 * 3 + 3) : -1;
+        len = n > 0 ? (size_t)n : 0;
+    }
+
+    imu_stream_decode_stats_t stats;
+    printf("t_us,ax,ay,az,gx,gy,gz,mx,my,mz,temp_raw\n");
+    long samples = stream ? imu_stream_decode(stream, len, print_sample, NULL, &stats) : -1;
+    if (samples < 0) {
+        fprintf(stderr, "Not a version %d IMU stream\n", IMU_STREAM_VERSION);
+        return 1;
+    }
+
+    fprintf(stderr, "%ld samples in %lu blocks, %lu damaged, %zu bytes skipped\n",
+            samples, stats.blocks, stats.bad_blocks, stats.skipped_bytes);
+    return stats.bad_blocks ? 2 : 0;
+}
@@ -0,0 +1,418 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+// Load generator for the vehicle command server (main.c): N workers each
+// send one command per connection, like the real clients, and record the
+// latency of every request.
+//
+// Closed loop: each worker sends its next command as soon as the previous
+// reply arrives. Open loop: requests are due on a fixed schedule at the
+// target rate, and latency is counted from when a request was due, so a
+// stalled server shows up as latency instead of as a lower send rate.
+//
+// With a bulk telemetry command as the IMU class (e.g. --imu-cmd "IMU
+// history last 5000"), the PWM class measures control latency under
+// telemetry load; "make qostest" runs that with and without traffic classes.
+
+#define MAX_WORKERS     256
+#define RESPONSE_SIZE   4096
+
+typedef enum { CLASS_IMU, CLASS_SONAR, CLASS_PWM, NUM_CLASSES } class_id_t;
+
+typedef struct {
+    const char *name;
+    const char *command;
+    int weight;
+} class_t;
+
+// PWM at 0% keeps the motors stopped if this runs against the vehicle
+static class_t classes[NUM_CLASSES] = {
+    { "imu",   "IMU read",   60 },
+    { "sonar", "SONAR read", 30 },
+    { "pwm",   "PWM 0 0",    10 },
+};
+
+typedef struct {
+    uint32_t *latency_us;   // One entry per completed request
+    size_t count, capacity;
+    unsigned long errors;   // "ERROR: ..." replies
+    unsigned long limited;  // Of which "ERROR: Rate limited ..."
+} class_stats_t;
+
+typedef struct {
+    int id;
+    unsigned int seed;
+    class_stats_t stats[NUM_CLASSES];
+    unsigned long connect_errors;
+    unsigned long io_errors;        // Send/receive failures and timeouts
+    unsigned long late;             // Open loop: sent after the next one was due
+} worker_t;
+
+// Settings
+static const char *host = "127.0.0.1";
+static int port = 5000;
+static int num_workers = 4;
+static double duration_s = 10.0;
+static double rate = 0.0;           // Requests/s over all workers, 0 = closed loop
+static int timeout_ms = 1000;
+static const char *setup_cmd = NULL;  // Sent once before the run
+static int expect_limited = -1;     // Class that must see a rate limited reply
+
+static struct sockaddr_in server_addr;
+static uint64_t start_ns, end_ns;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void sleep_until_ns(uint64_t t) {
+    struct timespec ts = { (time_t)(t / 1000000000ULL), (long)(t % 1000000000ULL) };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+// ---------------------------
+// One request: connect, send the line, read until the server closes
+// ---------------------------
+typedef enum {
+    REQ_OK, REQ_ERROR_REPLY, REQ_RATE_LIMITED, REQ_CONNECT_FAILED, REQ_IO_FAILED
+} req_result_t;
+
+static req_result_t send_request(const char *command) {
+    char line[256], response[RESPONSE_SIZE];
+    struct timeval tv = { timeout_ms / 1000, (timeout_ms % 1000) * 1000 };
+    size_t total = 0;
+    ssize_t n;
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return REQ_CONNECT_FAILED;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    if (connect(fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
+        close(fd);
+        return REQ_CONNECT_FAILED;
+    }
+
+    int len = snprintf(line, sizeof(line), "%s\n", command);
+    if (write(fd, line, len) != len) {
+        close(fd);
+        return REQ_IO_FAILED;
+    }
+    while (total < sizeof(response) - 1 &&
+           (n = read(fd, response + total, sizeof(response) - 1 - total)) > 0) {
+        total += n;
+    }
+    // Bulk replies: the rest is read and dropped, as a client would consume it
+    char rest[RESPONSE_SIZE];
+    while (total == sizeof(response) - 1 && read(fd, rest, sizeof(rest)) > 0);
+    close(fd);
+
+    if (total == 0) return REQ_IO_FAILED;
+    response[total] = '\0';
+    if (strncmp(response, "ERROR: Rate limited", 19) == 0) return REQ_RATE_LIMITED;
+    return strncmp(response, "ERROR", 5) == 0 ? REQ_ERROR_REPLY : REQ_OK;
+}
+
+// ---------------------------
+// Workers
+// ---------------------------
+static class_id_t pick_class(worker_t *w) {
+    int total = 0;
+    for (int c = 0; c < NUM_CLASSES; c++) total += classes[c].weight;
+
+    int r = rand_r(&w->seed) % total;
+    for (int c = 0; c < NUM_CLASSES; c++) {
+        if (r < classes[c].weight) return (class_id_t)c;
+        r -= classes[c].weight;
+    }
+    return CLASS_IMU;
+}
+
+static void record(worker_t *w, class_id_t c, req_result_t result, uint64_t latency_ns) {
+    class_stats_t *s = &w->stats[c];
+
+    switch (result) {
+    case REQ_CONNECT_FAILED: w->connect_errors++; return;
+    case REQ_IO_FAILED:      w->io_errors++; return;
+    case REQ_RATE_LIMITED:   s->limited++; s->errors++; break;
+    case REQ_ERROR_REPLY:    s->errors++; break;
+    case REQ_OK:             break;
+    }
+
+    if (s->count == s->capacity) {
+        size_t capacity = s->capacity ? s->capacity * 2 : 4096;
+        uint32_t *grown = realloc(s->latency_us, capacity * sizeof(uint32_t));
+        if (grown == NULL) return;
+        s->latency_us = grown;
+        s->capacity = capacity;
+    }
+    uint64_t us = latency_ns / 1000;
+    s->latency_us[s->count++] = us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+}
+
+static void *worker_main(void *arg) {
+    worker_t *w = arg;
+    // Workers are staggered so open-loop requests do not all fire together
+    uint64_t interval = rate > 0.0 ? (uint64_t)(1e9 * num_workers / rate) : 0;
+    uint64_t due = start_ns + interval * w->id / num_workers;
+
+    while (1) {
+        if (interval) {
+            if (due >= end_ns) break;
+            sleep_until_ns(due);
+        } else {
+            due = now_ns();
+            if (due >= end_ns) break;
+        }
+
+        class_id_t c = pick_class(w);
+        req_result_t result = send_request(classes[c].command);
+        uint64_t done = now_ns();
+        record(w, c, result, done - due);
+
+        if (interval) {
+            due += interval;
+            if (done > due) w->late++;
+        }
+    }
+    return NULL;
+}
+
+// ---------------------------
+// Report
+// ---------------------------
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static uint32_t percentile(const uint32_t *sorted, size_t count, double p) {
+    if (count == 0) return 0;
+    size_t index = (size_t)(p / 100.0 * (count - 1) + 0.5);
+    return sorted[index];
+}
+
+static void print_latency(const uint32_t *sorted, size_t count) {
+    printf("\"latency_us\":{\"p50\":%u,\"p90\":%u,\"p99\":%u,\"p999\":%u,\"max\":%u}",
+           percentile(sorted, count, 50.0), percentile(sorted, count, 90.0),
+           percentile(sorted, count, 99.0), percentile(sorted, count, 99.9),
+           count ? sorted[count - 1] : 0);
+}
+
+static void report(worker_t *workers, double elapsed_s) {
+    unsigned long connect_errors = 0, io_errors = 0, reply_errors = 0, late = 0;
+    size_t total = 0;
+
+    for (int i = 0; i < num_workers; i++) {
+        connect_errors += workers[i].connect_errors;
+        io_errors += workers[i].io_errors;
+        late += workers[i].late;
+        for (int c = 0; c < NUM_CLASSES; c++) total += workers[i].stats[c].count;
+    }
+
+    uint32_t *all = malloc((total ? total : 1) * sizeof(uint32_t));
+    if (all == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return;
+    }
+    size_t offset = 0;
+
+    // Per class first, gathering all samples on the way
+    for (int c = 0; c < NUM_CLASSES; c++) {
+        size_t first = offset;
+        unsigned long errors = 0, limited = 0;
+        for (int i = 0; i < num_workers; i++) {
+            class_stats_t *s = &workers[i].stats[c];
+            if (s->count) memcpy(all + offset, s->latency_us, s->count * sizeof(uint32_t));
+            offset += s->count;
+            errors += s->errors;
+            limited += s->limited;
+        }
+        reply_errors += errors;
+        if (classes[c].weight == 0) continue;
+
+        qsort(all + first, offset - first, sizeof(uint32_t), compare_u32);
+        printf("{\"class\":\"%s\",\"command\":\"%s\",\"requests\":%zu,\"error_replies\":%lu,"
+               "\"rate_limited\":%lu,", classes[c].name, classes[c].command, offset - first,
+               errors, limited);
+        print_latency(all + first, offset - first);
+        printf("}\n");
+    }
+
+    qsort(all, total, sizeof(uint32_t), compare_u32);
+    printf("{\"loadgen\":\"%s\",\"connections\":%d,\"target_rps\":%.1f,\"seconds\":%.2f,"
+           "\"requests\":%zu,\"throughput_rps\":%.1f,"
+           "\"errors\":{\"connect\":%lu,\"io\":%lu,\"reply\":%lu},\"late\":%lu,",
+           rate > 0.0 ? "open" : "closed", num_workers, rate, elapsed_s,
+           total, total / elapsed_s, connect_errors, io_errors, reply_errors, late);
+    print_latency(all, total);
+    printf("}\n");
+    free(all);
+}
+
+// ---------------------------
+// Command line
+// ---------------------------
+static int find_class(const char *name) {
+    for (int c = 0; c < NUM_CLASSES; c++) {
+        if (strcmp(name, classes[c].name) == 0) return c;
+    }
+    return -1;
+}
+
+static int parse_mix(char *mix) {
+    for (int c = 0; c < NUM_CLASSES; c++) classes[c].weight = 0;
+
+    for (char *item = strtok(mix, ","); item; item = strtok(NULL, ",")) {
+        char *sep = strchr(item, ':');
+        int c;
+        if (sep == NULL) return -1;
+        *sep = '\0';
+        if ((c = find_class(item)) < 0 || atoi(sep + 1) < 0) return -1;
+        classes[c].weight = atoi(sep + 1);
+    }
+
+    int total = 0;
+    for (int c = 0; c < NUM_CLASSES; c++) total += classes[c].weight;
+    return total > 0 ? 0 : -1;
+}
+
+static int resolve(const char *name) {
+    struct addrinfo hints, *result;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(name, NULL, &hints, &result) != 0) return -1;
+
+    server_addr = *(struct sockaddr_in *)result->ai_addr;
+    server_addr.sin_port = htons(port);
+    freeaddrinfo(result);
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [--host <addr>] [--port <n>] [--conns <n>] [--duration <s>]\n"
+            "          [--rate <req/s>] [--mix imu:<w>,sonar:<w>,pwm:<w>] [--timeout <ms>]\n"
+            "          [--imu-cmd <line>] [--sonar-cmd <line>] [--pwm-cmd <line>]\n"
+            "          [--setup <line>] [--expect-limited imu|sonar|pwm]\n"
+            "Without --rate each connection sends its next request when the reply\n"
+            "arrives (closed loop); with it, requests are sent on schedule (open loop).\n"
+            "--expect-limited fails the run unless that class got a rate limited reply.\n",
+            prog);
+}
+
+int main(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        int ok = value != NULL;
+
+        if (ok && strcmp(argv[i], "--host") == 0) {
+            host = value;
+        } else if (ok && strcmp(argv[i], "--port") == 0) {
+            port = atoi(value);
+            ok = port > 0 && port < 65536;
+        } else if (ok && strcmp(argv[i], "--conns") == 0) {
+            num_workers = atoi(value);
+            ok = num_workers > 0 && num_workers <= MAX_WORKERS;
+        } else if (ok && strcmp(argv[i], "--duration") == 0) {
+            duration_s = atof(value);
+            ok = duration_s > 0.0;
+        } else if (ok && strcmp(argv[i], "--rate") == 0) {
+            rate = atof(value);
+            ok = rate >= 0.0;
+        } else if (ok && strcmp(argv[i], "--mix") == 0) {
+            ok = parse_mix(argv[i + 1]) == 0;
+        } else if (ok && strcmp(argv[i], "--timeout") == 0) {
+            timeout_ms = atoi(value);
+            ok = timeout_ms > 0;
+        } else if (ok && strcmp(argv[i], "--imu-cmd") == 0) {
+            classes[CLASS_IMU].command = value;
+        } else if (ok && strcmp(argv[i], "--sonar-cmd") == 0) {
+            classes[CLASS_SONAR].command = value;
+        } else if (ok && strcmp(argv[i], "--pwm-cmd") == 0) {
+            classes[CLASS_PWM].command = value;
+        } else if (ok && strcmp(argv[i], "--setup") == 0) {
+            setup_cmd = value;
+        } else if (ok && strcmp(argv[i], "--expect-limited") == 0) {
+            ok = (expect_limited = find_class(value)) >= 0;
+        } else {
+            ok = 0;
+        }
+        if (!ok) {
+            usage(argv[0]);
+            return 1;
+        }
+        i++;
+    }
+
+    if (resolve(host) < 0) {
+        fprintf(stderr, "Cannot resolve %s\n", host);
+        return 1;
+    }
+
+    if (setup_cmd && send_request(setup_cmd) != REQ_OK) {
+        fprintf(stderr, "Setup command '%s' failed\n", setup_cmd);
+        return 1;
+    }
+
+    worker_t *workers = calloc(num_workers, sizeof(worker_t));
+    pthread_t *threads = calloc(num_workers, sizeof(pthread_t));
+    if (workers == NULL || threads == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    printf("# %s:%d, %d connections, %s, %.1f s, mix imu:%d sonar:%d pwm:%d\n",
+           host, port, num_workers,
+           rate > 0.0 ? "open loop" : "closed loop", duration_s,
+           classes[CLASS_IMU].weight, classes[CLASS_SONAR].weight, classes[CLASS_PWM].weight);
+    fflush(stdout);
+
+    start_ns = now_ns();
+    end_ns = start_ns + (uint64_t)(duration_s * 1e9);
+    for (int i = 0; i < num_workers; i++) {
+        workers[i].id = i;
+        workers[i].seed = 0x9E3779B9u * (i + 1);
+        if (pthread_create(&threads[i], NULL, worker_main, &workers[i]) != 0) {
+            fprintf(stderr, "Failed to start worker %d\n", i);
+            return 1;
+        }
+    }
+    for (int i = 0; i < num_workers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    double elapsed_s = (now_ns() - start_ns) / 1e9;
+
+    report(workers, elapsed_s);
+
+    // Failed requests are results, but none at all means no server
+    size_t completed = 0;
+    unsigned long limited = 0;
+    for (int i = 0; i < num_workers; i++) {
+        for (int c = 0; c < NUM_CLASSES; c++) {
+            completed += workers[i].stats[c].count;
+            if (c == expect_limited) limited += workers[i].stats[c].limited;
+            free(workers[i].stats[c].latency_us);
+        }
+    }
+    free(workers);
+    free(threads);
+    if (completed && expect_limited >= 0 && limited == 0) {
+        fprintf(stderr, "No rate limited reply for class %s\n", classes[expect_limited].name);
+        return 3;
+    }
+    return completed ? 0 : 2;
+}
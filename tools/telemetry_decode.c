@@ -0,0 +1,122 @@
+#include "../recorder.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+// Offline decoder for the recorder's .vtl files (recorder.h): prints every
+// record as one CSV row. Rotated files are given in order and share the
+// time base of the first one; --from skips whole blocks by their index.
+
+static int type_filter = 0;            // 0 = all record types
+static double from_s = 0.0, to_s = -1.0;
+static uint64_t origin_mono_us = 0;    // created_mono_us of the first file
+static uint64_t origin_real_us = 0;
+static unsigned long counts[REC_PWM + 1];
+
+static double seconds_since_origin(uint64_t time_us) {
+    return ((double)time_us - (double)origin_mono_us) / 1e6;
+}
+
+static int print_record(const recorder_record_t *record, uint64_t time_us, void *ctx) {
+    const uint8_t *data = (const uint8_t *)record;
+    recorder_record_t rec;
+    (void)ctx;
+    memcpy(&rec, data, sizeof(rec));
+
+    double t = seconds_since_origin(time_us);
+    if (to_s >= 0.0 && t > to_s) return 1;   // Past the window: stop reading
+    if (t < from_s || (type_filter && rec.type != type_filter)) return 0;
+
+    uint64_t real_us = origin_real_us + (time_us - origin_mono_us);
+    printf("%llu,%llu.%06llu,%.6f,",
+           (unsigned long long)time_us, (unsigned long long)(real_us / 1000000),
+           (unsigned long long)(real_us % 1000000), t);
+
+    if (rec.type == REC_IMU && rec.size >= sizeof(recorder_imu_t)) {
+        recorder_imu_t r;
+        memcpy(&r, data, sizeof(r));
+        printf("imu,%.5f,%.5f,%.5f,%.5f,%.5f,%.5f,%.3f,%.3f,%.3f,%.2f,%.3f,%.3f,%.3f,,,,,,\n",
+               r.accel[0], r.accel[1], r.accel[2], r.gyro[0], r.gyro[1], r.gyro[2],
+               r.mag[0], r.mag[1], r.mag[2], r.temp, r.roll, r.pitch, r.yaw);
+    } else if (rec.type == REC_SONAR && rec.size >= sizeof(recorder_sonar_t)) {
+        recorder_sonar_t r;
+        memcpy(&r, data, sizeof(r));
+        printf("sonar,,,,,,,,,,,,,,%.2f,%d,,,,\n", r.distance_cm, r.valid);
+    } else if (rec.type == REC_PWM && rec.size >= sizeof(recorder_pwm_t)) {
+        recorder_pwm_t r;
+        memcpy(&r, data, sizeof(r));
+        if (r.channel == REC_PWM_DUAL) {
+            printf("pwm,,,,,,,,,,,,,,,,dual,%.2f,%.2f,%u\n", r.duty[0], r.duty[1], r.duration_s);
+        } else {
+            printf("pwm,,,,,,,,,,,,,,,,%u,%.2f,,%u\n", r.channel, r.duty[0], r.duration_s);
+        }
+    } else {
+        printf("unknown,,,,,,,,,,,,,,,,,,,\n");
+        return 0;
+    }
+    counts[rec.type]++;
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [--type imu|sonar|pwm] [--from <s>] [--to <s>] <file.vtl>...\n"
+                    "Times are seconds since the first file was created.\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    int i;
+
+    for (i = 1; i < argc && strncmp(argv[i], "--", 2) == 0; i += 2) {
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        if (strcmp(argv[i], "--type") == 0) {
+            if (strcmp(argv[i + 1], "imu") == 0) type_filter = REC_IMU;
+            else if (strcmp(argv[i + 1], "sonar") == 0) type_filter = REC_SONAR;
+            else if (strcmp(argv[i + 1], "pwm") == 0) type_filter = REC_PWM;
+            else {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--from") == 0) {
+            from_s = atof(argv[i + 1]);
+        } else if (strcmp(argv[i], "--to") == 0) {
+            to_s = atof(argv[i + 1]);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (i >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    recorder_file_header_t header;
+    if (recorder_read_header(argv[i], &header) < 0) {
+        fprintf(stderr, "%s: not a version %d telemetry file\n", argv[i], RECORDER_VERSION);
+        return 1;
+    }
+    origin_mono_us = header.created_mono_us;
+    origin_real_us = header.created_real_us;
+    uint64_t from_us = origin_mono_us + (uint64_t)(from_s * 1e6);
+
+    printf("t_us,unix_time,time_s,type,ax,ay,az,gx,gy,gz,mx,my,mz,temp,roll,pitch,yaw,"
+           "distance_cm,valid,channel,duty0,duty1,duration_s\n");
+    int failed = 0;
+    for (; i < argc; i++) {
+        int result = recorder_read_file(argv[i], from_us, print_record, NULL);
+        if (result < 0) {
+            fprintf(stderr, "%s: not a version %d telemetry file\n", argv[i], RECORDER_VERSION);
+            failed = 1;
+        } else if (result > 0) {
+            break;
+        }
+    }
+
+    fprintf(stderr, "%lu IMU, %lu sonar, %lu PWM records\n",
+            counts[REC_IMU], counts[REC_SONAR], counts[REC_PWM]);
+    return failed;
+}
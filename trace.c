@@ -0,0 +1,304 @@
+#define _GNU_SOURCE     // pthread_getname_np
+#include "trace.h"
+#include "cmd_parse.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+
+#define TRACE_MASK  (TRACE_RING_EVENTS - 1)
+
+typedef struct {
+    const char *name;
+    uint64_t start_ns;
+    uint32_t dur_ns;
+} trace_event_t;
+
+// Written only by its owner thread; readers check 'head' around their copy.
+// One cache line each, so a thread bumping its head on every span does not
+// invalidate its neighbours' (false sharing across the Pi's 4 cores).
+typedef struct {
+    int in_use;             // Owned by a live thread (atomic)
+    int used;               // Has ever been owned: dumped
+    int tid;
+    char thread_name[16];
+    unsigned head;          // Spans ever written (atomic, wraps)
+    trace_event_t *events;
+} __attribute__((aligned(64))) trace_ring_t;
+
+// Static variables
+static trace_ring_t rings[TRACE_MAX_THREADS];
+static volatile int trace_enabled = 1;
+static pthread_key_t ring_key;
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static __thread trace_ring_t *my_ring = NULL;
+static __thread int no_ring = 0;        // Every ring taken when this thread asked
+
+static uint64_t get_time_nanoseconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Thread exit: the ring keeps its spans for dumps until another thread
+// takes it over
+static void release_ring(void *arg) {
+    trace_ring_t *r = arg;
+    __atomic_store_n(&r->in_use, 0, __ATOMIC_RELEASE);
+}
+
+static void create_key(void) {
+    pthread_key_create(&ring_key, release_ring);
+}
+
+// ---------------------------
+// First span of a thread: take a free ring (slow path, once per thread)
+// ---------------------------
+static trace_ring_t *claim_ring(void) {
+    pthread_once(&key_once, create_key);
+
+    for (int i = 0; i < TRACE_MAX_THREADS; i++) {
+        trace_ring_t *r = &rings[i];
+        int expected = 0;
+        if (!__atomic_compare_exchange_n(&r->in_use, &expected, 1, 0,
+                                         __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            continue;
+        }
+        if (r->events == NULL) {
+            r->events = calloc(TRACE_RING_EVENTS, sizeof(trace_event_t));
+            if (r->events == NULL) {
+                __atomic_store_n(&r->in_use, 0, __ATOMIC_RELEASE);
+                break;
+            }
+        }
+        r->tid = (int)syscall(SYS_gettid);
+        if (pthread_getname_np(pthread_self(), r->thread_name, sizeof(r->thread_name)) != 0) {
+            r->thread_name[0] = '\0';
+        }
+        __atomic_store_n(&r->head, 0, __ATOMIC_RELEASE);
+        __atomic_store_n(&r->used, 1, __ATOMIC_RELEASE);
+        pthread_setspecific(ring_key, r);
+        return r;
+    }
+
+    no_ring = 1;
+    return NULL;
+}
+
+// ---------------------------
+// Recording (any thread)
+// ---------------------------
+uint64_t trace_begin(void) {
+    return trace_enabled ? get_time_nanoseconds() : 0;
+}
+
+void trace_end(const char *name, uint64_t start_ns) {
+    if (start_ns == 0) {
+        return;
+    }
+
+    trace_ring_t *r = my_ring;
+    if (r == NULL) {
+        if (no_ring || (r = my_ring = claim_ring()) == NULL) {
+            return;
+        }
+    }
+
+    uint64_t dur = get_time_nanoseconds() - start_ns;
+    unsigned head = r->head;
+    trace_event_t *e = &r->events[head & TRACE_MASK];
+    e->name = name;
+    e->start_ns = start_ns;
+    e->dur_ns = dur > UINT32_MAX ? UINT32_MAX : (uint32_t)dur;
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+}
+
+void trace_set_enabled(int enabled) {
+    trace_enabled = enabled;
+}
+
+// ---------------------------
+// Copy the spans of one ring that were not overwritten during the copy.
+// Returns the number copied into 'out' (oldest first). A full ring's
+// oldest slot is the one its owner fills next, possibly right now, so at
+// most TRACE_RING_EVENTS - 1 spans are taken.
+// ---------------------------
+static unsigned snapshot_ring(trace_ring_t *r, trace_event_t *out) {
+    unsigned head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    unsigned count = head < TRACE_RING_EVENTS - 1 ? head : TRACE_RING_EVENTS - 1;
+    unsigned first = head - count;
+
+    for (unsigned i = 0; i < count; i++) {
+        out[i] = r->events[(first + i) & TRACE_MASK];
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    // The owner may have lapped the oldest slots meanwhile (or the ring
+    // changed hands and restarted)
+    unsigned after = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    if (after - first > 0x80000000u) {
+        return 0;
+    }
+    unsigned lapped = after - head;
+    if (lapped >= count) {
+        return 0;
+    }
+    memmove(out, out + lapped, (count - lapped) * sizeof(trace_event_t));
+    return count - lapped;
+}
+
+// ---------------------------
+// Write the rings as Chrome trace JSON ("X" complete events, microseconds)
+// ---------------------------
+static int write_trace(FILE *f) {
+    trace_event_t *events = malloc(TRACE_RING_EVENTS * sizeof(trace_event_t));
+    if (events == NULL) {
+        fclose(f);
+        return -1;
+    }
+
+    int pid = (int)getpid();
+    int total = 0;
+    const char *sep = "";
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    for (int i = 0; i < TRACE_MAX_THREADS; i++) {
+        trace_ring_t *r = &rings[i];
+        if (!__atomic_load_n(&r->used, __ATOMIC_ACQUIRE)) {
+            continue;
+        }
+
+        fprintf(f, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+                   "\"args\":{\"name\":\"%s %d\"}}",
+                sep, pid, r->tid, r->thread_name, r->tid);
+        sep = ",";
+
+        unsigned n = snapshot_ring(r, events);
+        for (unsigned k = 0; k < n; k++) {
+            fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+                       "\"ts\":%.3f,\"dur\":%.3f}",
+                    events[k].name, pid, r->tid,
+                    events[k].start_ns / 1000.0, events[k].dur_ns / 1000.0);
+        }
+        total += n;
+    }
+
+    fprintf(f, "\n]}\n");
+    free(events);
+    if (fclose(f) != 0) {
+        return -1;
+    }
+    return total;
+}
+
+int trace_dump(const char *path) {
+    FILE *f = fopen(path, "w");
+    return f ? write_trace(f) : -1;
+}
+
+// Never follows a link or replaces a file: the name comes off the network
+int trace_dump_file(const char *name) {
+    char path[300];
+    FILE *f;
+
+    if (mkdir(TRACE_DIR, 0755) < 0 && errno != EEXIST) {
+        return -1;
+    }
+    snprintf(path, sizeof(path), TRACE_DIR "/%s", name);
+    int fd = open(path, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    if ((f = fdopen(fd, "w")) == NULL) {
+        close(fd);
+        unlink(path);
+        return -1;
+    }
+    return write_trace(f);
+}
+
+// ---------------------------
+// Execute trace command
+// Commands:
+//   "status" (or empty)   - State and spans held per thread
+//   "on" / "off"          - Start or pause recording
+//   "dump [<file>]"       - Write trace JSON to traces/<file>, a new file
+//                           (default trace-<date>-<time>.json)
+// ---------------------------
+int execute_trace_command(char *cmd_str, char *response, size_t response_size) {
+    static const char *const commands[] = { "status", "on", "off", "dump" };
+    enum { CMD_STATUS, CMD_ON, CMD_OFF, CMD_DUMP };
+    cmd_parser_t p;
+
+    if (cmd_str == NULL || response == NULL) {
+        return -1;
+    }
+
+    cmd_init(&p, cmd_str);
+    int cmd = cmd_done(&p) ? CMD_STATUS : cmd_keyword(&p, "TRACE command", commands, 4);
+    if (cmd < 0) {
+        return cmd_error(&p, response, response_size);
+    }
+
+    if (cmd == CMD_DUMP) {
+        char name[256];
+        if (cmd_done(&p)) {
+            time_t now = time(NULL);
+            struct tm tm;
+            strftime(name, sizeof(name), "trace-%Y%m%d-%H%M%S.json", localtime_r(&now, &tm));
+        } else if (cmd_filename(&p, "file name", name, sizeof(name)) < 0 || cmd_end(&p) < 0) {
+            return cmd_error(&p, response, response_size);
+        }
+        int spans = trace_dump_file(name);
+        if (spans < 0) {
+            snprintf(response, response_size, "ERROR: Cannot write " TRACE_DIR "/%s: %s\n",
+                     name, errno == EEXIST ? "file exists" : strerror(errno));
+            return -1;
+        }
+        snprintf(response, response_size, "{\"file\":\"" TRACE_DIR "/%s\",\"spans\":%d}\n",
+                 name, spans);
+        return 0;
+    }
+
+    if (cmd_end(&p) < 0) {
+        return cmd_error(&p, response, response_size);
+    }
+
+    if (cmd == CMD_ON || cmd == CMD_OFF) {
+        trace_set_enabled(cmd == CMD_ON);
+        snprintf(response, response_size, "OK\n");
+        return 0;
+    }
+
+    size_t pos = snprintf(response, response_size, "{\"enabled\":%s,\"threads\":[",
+                          trace_enabled ? "true" : "false");
+    const char *sep = "";
+    for (int i = 0; i < TRACE_MAX_THREADS && pos < response_size; i++) {
+        trace_ring_t *r = &rings[i];
+        if (!__atomic_load_n(&r->used, __ATOMIC_ACQUIRE)) {
+            continue;
+        }
+        unsigned head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        pos += snprintf(response + pos, response_size - pos,
+                        "%s{\"tid\":%d,\"live\":%s,\"spans\":%u}", sep, r->tid,
+                        __atomic_load_n(&r->in_use, __ATOMIC_ACQUIRE) ? "true" : "false", head);
+        sep = ",";
+    }
+    if (pos < response_size) {
+        snprintf(response + pos, response_size - pos, "]}\n");
+    }
+    return 0;
+}
+
+const module_t trace_module = {
+    .name = "trace",
+    .prefix = "TRACE",
+    .usage = "TRACE [status] | on | off | dump [<file>]",
+    .command = execute_trace_command,
+};
@@ -0,0 +1,42 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "module.h"
+
+// Configuration
+#define TRACE_MAX_THREADS   32
+#define TRACE_RING_EVENTS   8192    // Spans kept per thread (power of two), ~200 KB
+#define TRACE_DIR           "traces"   // Where "TRACE dump" writes
+
+// Timed spans kept in one ring per thread, overwritten oldest first, and
+// written out as Chrome/Perfetto trace JSON by "TRACE dump". Recording is
+// two clock reads and a store into the caller's own ring, no lock:
+//
+//     uint64_t t0 = trace_begin();
+//     ...
+//     trace_end("set_pwm", t0);
+//
+// 'name' must be a string literal (or otherwise outlive the trace).
+// trace_begin() returns 0 while tracing is off and trace_end() ignores it.
+uint64_t trace_begin(void);
+void trace_end(const char *name, uint64_t start_ns);
+
+void trace_set_enabled(int enabled);
+
+// Write every ring as trace JSON; returns the number of spans or -1.
+// 'path' is used as given, for in-process callers only.
+int trace_dump(const char *path);
+
+// Same, into a new file TRACE_DIR/<name> ('name' a bare file name, see
+// cmd_filename()); -1 with errno EEXIST if it is already there
+int trace_dump_file(const char *name);
+
+// Command execution
+int execute_trace_command(char *cmd_str, char *response, size_t response_size);
+
+// Registry descriptor (module.h), command-only
+extern const module_t trace_module;
+
+#endif // TRACE_H